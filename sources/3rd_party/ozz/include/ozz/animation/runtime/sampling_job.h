@@ -60,6 +60,7 @@ struct OZZ_ANIMATION_DLL SamplingJob {
   // Validates job parameters. Returns true for a valid job, or false otherwise:
   // -if any input pointer is nullptr
   // -if output range is invalid.
+  // -if soa_track_mask is not empty but smaller than (num_soa_tracks + 7) / 8.
   bool Validate() const;
 
   // Runs job's sampling task.
@@ -91,6 +92,14 @@ struct OZZ_ANIMATION_DLL SamplingJob {
   // If there are more joints in the animation, then the last joints are not
   // sampled.
   span<ozz::math::SoaTransform> output;
+
+  // Optional mask of soa tracks to sample, one bit per soa track, 8 tracks per
+  // byte, in the same order as output. Keyframes of tracks with a cleared bit
+  // are not decompressed nor interpolated and their output is left unchanged,
+  // context keeps them outdated so they're decompressed once they're sampled
+  // again. Empty mask samples all tracks.
+  // (animations project addition, used for partial body layers)
+  span<const uint8_t> soa_track_mask;
 };
 
 namespace internal {
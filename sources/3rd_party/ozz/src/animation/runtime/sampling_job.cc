@@ -70,6 +70,10 @@ bool SamplingJob::Validate() const {
   // Tests context size.
   valid &= context->max_soa_tracks() >= num_soa_tracks;
 
+  // Tests mask size.
+  valid &= soa_track_mask.empty() ||
+           soa_track_mask.size() >= static_cast<size_t>((num_soa_tracks + 7) / 8);
+
   return valid;
 }
 
@@ -144,11 +148,14 @@ void UpdateInterpKeyframes(int _num_soa_tracks,
                            const ozz::span<const _Key>& _keys,
                            const int* _interp, uint8_t* _outdated,
                            _InterpKey* _interp_keys,
-                           const _Decompress& _decompress) {
+                           const _Decompress& _decompress,
+                           const ozz::span<const uint8_t>& _mask) {
   const int num_outdated_flags = (_num_soa_tracks + 7) / 8;
   for (int j = 0; j < num_outdated_flags; ++j) {
-    uint8_t outdated = _outdated[j];
-    _outdated[j] = 0;  // Reset outdated entries as all will be processed.
+    const uint8_t mask = _mask.empty() ? 0xff : _mask[j];
+    uint8_t outdated = _outdated[j] & mask;
+    // Reset outdated entries that will be processed, masked ones stay outdated.
+    _outdated[j] &= ~mask;
     for (int i = j * 8; outdated; ++i, outdated >>= 1) {
       if (!(outdated & 1)) {
         continue;
@@ -265,9 +272,13 @@ void Interpolates(float _anim_ratio, int _num_soa_tracks,
                   const internal::InterpSoaFloat3* _translations,
                   const internal::InterpSoaQuaternion* _rotations,
                   const internal::InterpSoaFloat3* _scales,
+                  const ozz::span<const uint8_t>& _mask,
                   math::SoaTransform* _output) {
   const math::SimdFloat4 anim_ratio = math::simd_float4::Load1(_anim_ratio);
   for (int i = 0; i < _num_soa_tracks; ++i) {
+    if (!_mask.empty() && !(_mask[i / 8] & (1 << (i & 7)))) {
+      continue;
+    }
     // Prepares interpolation coefficients.
     const math::SimdFloat4 interp_t_ratio =
         (anim_ratio - _translations[i].ratio[0]) *
@@ -319,28 +330,32 @@ bool SamplingJob::Run() const {
   UpdateInterpKeyframes(num_soa_tracks, animation->translations(),
                         context->translation_keys_,
                         context->outdated_translations_,
-                        context->soa_translations_, &DecompressFloat3);
+                        context->soa_translations_, &DecompressFloat3,
+                        soa_track_mask);
 
   UpdateCacheCursor(anim_ratio, num_soa_tracks, animation->rotations(),
                     &context->rotation_cursor_, context->rotation_keys_,
                     context->outdated_rotations_);
   UpdateInterpKeyframes(num_soa_tracks, animation->rotations(),
                         context->rotation_keys_, context->outdated_rotations_,
-                        context->soa_rotations_, &DecompressQuaternion);
+                        context->soa_rotations_, &DecompressQuaternion,
+                        soa_track_mask);
 
   UpdateCacheCursor(anim_ratio, num_soa_tracks, animation->scales(),
                     &context->scale_cursor_, context->scale_keys_,
                     context->outdated_scales_);
   UpdateInterpKeyframes(num_soa_tracks, animation->scales(),
                         context->scale_keys_, context->outdated_scales_,
-                        context->soa_scales_, &DecompressFloat3);
+                        context->soa_scales_, &DecompressFloat3,
+                        soa_track_mask);
 
   // only interp as much as we have output for.
   const int num_soa_interp_tracks = math::Min(static_cast< int >(output.size()), num_soa_tracks);
 
   // Interpolates soa hot data.
   Interpolates(anim_ratio, num_soa_interp_tracks, context->soa_translations_,
-               context->soa_rotations_, context->soa_scales_, output.begin());
+               context->soa_rotations_, context->soa_scales_, soa_track_mask,
+               output.begin());
 
   return true;
 }
@@ -171,6 +171,38 @@ TEST(JobValidity, SamplingJob) {
     EXPECT_TRUE(job.Validate());
     EXPECT_TRUE(job.Run());
   }
+
+  {  // Soa track mask, one bit per soa track.
+    RawAnimation masked_raw_animation;
+    masked_raw_animation.duration = 1.f;
+    masked_raw_animation.tracks.resize(36);  // 9 soa tracks, 2 mask bytes.
+    ozz::unique_ptr<Animation> masked_animation(builder(masked_raw_animation));
+    ASSERT_TRUE(masked_animation);
+
+    SamplingJob::Context masked_context(36);
+    ozz::math::SoaTransform output[9];
+    const uint8_t mask[2] = {0xff, 0x01};
+
+    SamplingJob job;
+    job.animation = masked_animation.get();
+    job.context = &masked_context;
+    job.output = output;
+
+    // Undersized mask.
+    job.soa_track_mask = ozz::span<const uint8_t>(mask, 1);
+    EXPECT_FALSE(job.Validate());
+    EXPECT_FALSE(job.Run());
+
+    // Big enough mask.
+    job.soa_track_mask = mask;
+    EXPECT_TRUE(job.Validate());
+    EXPECT_TRUE(job.Run());
+
+    // Empty mask samples all tracks.
+    job.soa_track_mask = ozz::span<const uint8_t>();
+    EXPECT_TRUE(job.Validate());
+    EXPECT_TRUE(job.Run());
+  }
 }
 
 TEST(Sampling, SamplingJob) {
@@ -655,3 +687,153 @@ TEST(CacheResize, SamplingJob) {
   context.Resize(1);
   EXPECT_FALSE(job.Validate());
 }
+
+namespace {
+// 8 tracks (2 soa tracks) with non linear translations, so sampling with
+// outdated keys can't give the right values by chance.
+ozz::unique_ptr<Animation> BuildMaskAnimation() {
+  RawAnimation raw_animation;
+  raw_animation.duration = 1.f;
+  raw_animation.tracks.resize(8);
+  for (size_t i = 0; i < raw_animation.tracks.size(); ++i) {
+    for (int k = 0; k <= 8; ++k) {
+      const float t = k / 8.f;
+      const RawAnimation::TranslationKey key = {
+          t, ozz::math::Float3(i + 10.f * t * t, -t * t * t, 1.f * i)};
+      raw_animation.tracks[i].translations.push_back(key);
+    }
+  }
+  AnimationBuilder builder;
+  return builder(raw_animation);
+}
+
+// Samples all tracks with a fresh context.
+void SampleReference(const Animation& _animation, float _ratio,
+                     ozz::math::SoaTransform* _output) {
+  SamplingJob::Context context(_animation.num_tracks());
+  SamplingJob job;
+  job.animation = &_animation;
+  job.context = &context;
+  job.ratio = _ratio;
+  job.output = ozz::span<ozz::math::SoaTransform>(_output, 2);
+  ASSERT_TRUE(job.Run());
+}
+
+void ExpectSoaEq(const ozz::math::SoaTransform& _a,
+                 const ozz::math::SoaTransform& _b) {
+  EXPECT_SOAFLOAT3_EQ_EST(
+      _a.translation, ozz::math::GetX(_b.translation.x),
+      ozz::math::GetY(_b.translation.x), ozz::math::GetZ(_b.translation.x),
+      ozz::math::GetW(_b.translation.x), ozz::math::GetX(_b.translation.y),
+      ozz::math::GetY(_b.translation.y), ozz::math::GetZ(_b.translation.y),
+      ozz::math::GetW(_b.translation.y), ozz::math::GetX(_b.translation.z),
+      ozz::math::GetY(_b.translation.z), ozz::math::GetZ(_b.translation.z),
+      ozz::math::GetW(_b.translation.z));
+}
+}  // namespace
+
+TEST(SoaTrackMask, SamplingJob) {
+  ozz::unique_ptr<Animation> animation = BuildMaskAnimation();
+  ASSERT_TRUE(animation);
+
+  SamplingJob::Context context(8);
+  ozz::math::SoaTransform output[2];
+  ozz::math::SoaTransform expected[2];
+  memset(output, 0xde, sizeof(output));
+  ozz::math::SoaTransform untouched;
+  memset(&untouched, 0xde, sizeof(untouched));
+
+  // Only the first soa track is sampled.
+  const uint8_t mask[1] = {0x01};
+  SamplingJob job;
+  job.animation = animation.get();
+  job.context = &context;
+  job.output = output;
+  job.soa_track_mask = mask;
+  job.ratio = .3f;
+  EXPECT_TRUE(job.Validate());
+  EXPECT_TRUE(job.Run());
+
+  SampleReference(*animation, .3f, expected);
+  ExpectSoaEq(output[0], expected[0]);
+  // Masked soa track is left untouched.
+  EXPECT_EQ(memcmp(&output[1], &untouched, sizeof(untouched)), 0);
+
+  // Only the second soa track is sampled, first one keeps previous values.
+  const uint8_t second_mask[1] = {0x02};
+  job.soa_track_mask = second_mask;
+  job.ratio = .6f;
+  EXPECT_TRUE(job.Run());
+  ExpectSoaEq(output[0], expected[0]);
+  SampleReference(*animation, .6f, expected);
+  ExpectSoaEq(output[1], expected[1]);
+}
+
+TEST(SoaTrackMaskReenable, SamplingJob) {
+  ozz::unique_ptr<Animation> animation = BuildMaskAnimation();
+  ASSERT_TRUE(animation);
+
+  SamplingJob::Context context(8);
+  ozz::math::SoaTransform output[2];
+  ozz::math::SoaTransform expected[2];
+
+  SamplingJob job;
+  job.animation = animation.get();
+  job.context = &context;
+  job.output = output;
+
+  // All tracks are sampled once, so the context is warm.
+  job.ratio = .1f;
+  EXPECT_TRUE(job.Run());
+  SampleReference(*animation, .1f, expected);
+  ExpectSoaEq(output[0], expected[0]);
+  ExpectSoaEq(output[1], expected[1]);
+
+  // Second soa track is masked while time moves forward, its keys go
+  // outdated.
+  const uint8_t mask[1] = {0x01};
+  job.soa_track_mask = mask;
+  for (float ratio : {.3f, .55f, .8f}) {
+    job.ratio = ratio;
+    EXPECT_TRUE(job.Run());
+    SampleReference(*animation, ratio, expected);
+    ExpectSoaEq(output[0], expected[0]);
+  }
+
+  // Re-enabled track is correct right away, even though the cursor doesn't
+  // move to new keys (same key interval as the last masked sample).
+  job.soa_track_mask = ozz::span<const uint8_t>();
+  job.ratio = .82f;
+  EXPECT_TRUE(job.Run());
+  SampleReference(*animation, .82f, expected);
+  ExpectSoaEq(output[0], expected[0]);
+  ExpectSoaEq(output[1], expected[1]);
+
+  // Time jumps backward while masked, the cache is invalidated and rebuilt.
+  job.soa_track_mask = mask;
+  job.ratio = .05f;
+  EXPECT_TRUE(job.Run());
+  SampleReference(*animation, .05f, expected);
+  ExpectSoaEq(output[0], expected[0]);
+
+  job.soa_track_mask = ozz::span<const uint8_t>();
+  job.ratio = .08f;
+  EXPECT_TRUE(job.Run());
+  SampleReference(*animation, .08f, expected);
+  ExpectSoaEq(output[0], expected[0]);
+  ExpectSoaEq(output[1], expected[1]);
+
+  // Explicit invalidation while masked.
+  job.soa_track_mask = mask;
+  job.ratio = .7f;
+  EXPECT_TRUE(job.Run());
+  context.Invalidate();
+  job.ratio = .2f;
+  EXPECT_TRUE(job.Run());
+  job.soa_track_mask = ozz::span<const uint8_t>();
+  job.ratio = .21f;
+  EXPECT_TRUE(job.Run());
+  SampleReference(*animation, .21f, expected);
+  ExpectSoaEq(output[0], expected[0]);
+  ExpectSoaEq(output[1], expected[1]);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "animation_controller.h"
+#include "engine/import/model.h"
+
+
+// Clip imported with AnimationImportSettings::additive, applied on top of the pose of other controllers.
+// Loops for breathing or leaning, one-shot ones (hit reactions) play once after set_progress(0) and then add nothing.
+struct AdditiveAnimation final : IAnimationController
+{
+  const AnimationPtr animation;
+  const JointMaskPtr mask;
+  float weight = 1.f; // scales the delta, 0 has no effect
+  bool looping = true;
+  float progress = 0.f;
+
+  AdditiveAnimation(const AnimationPtr &_animation, float _weight = 1.f, bool _looping = true, const JointMaskPtr &_mask = nullptr)
+    : animation{_animation}, mask{_mask}, weight{_weight}, looping{_looping} {}
+
+  void update(float dt) override
+  {
+    float duration = animation->duration();
+
+    progress += dt / duration;
+    if (progress > 1.f)
+      progress = looping ? progress - 1.f : 1.f;
+  }
+
+  void set_progress(float _progress) override
+  {
+    progress = _progress;
+  }
+
+  void collect_animations(FrameVector<WeightedAnimation> &out) override
+  {
+    if (weight <= 0.f || (!looping && progress >= 1.f))
+      return;
+    out.push_back({animation, weight, progress, mask, true});
+  }
+};
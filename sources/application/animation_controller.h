@@ -1,6 +1,8 @@
 #pragma once
 
+#include "engine/frame_arena.h"
 #include "engine/import/model.h"
+#include "joint_mask.h"
 
 
 struct WeightedAnimation
@@ -8,11 +10,26 @@ struct WeightedAnimation
   const AnimationPtr animation;
   float weight;
   float progress;
+  JointMaskPtr mask = nullptr; // partial body layer, null blends whole body
+  bool additive = false;       // clip imported as additive, applied on top of the blended pose
+  RootMotionPtr rootMotion = nullptr; // moves the character, see AnimationImportSettings::extractRootMotion
+  float previousProgress = 0.f;       // progress before the last update, root motion is applied between the two
+  AnimationTracksPtr tracks = nullptr; // curves and events of the clip
 };
 
+// Controllers move less than half a clip per update, so only a long backward step is a loop wrap.
+// Short backward steps come from sync leader switches re-aligning followers and are played as they are.
+inline bool progress_wrapped(float previousProgress, float progress)
+{
+  return previousProgress - progress > 0.5f;
+}
+
 struct IAnimationController
 {
   virtual ~IAnimationController() = default;
   virtual void update(float dt) = 0;
-  virtual void collect_animations(std::vector<WeightedAnimation> &out) = 0;
+  // jumps playback to normalized time, used to desync crowds and to sweep poses in tests
+  virtual void set_progress(float progress) = 0;
+  // out lives in frame arena of the calling thread
+  virtual void collect_animations(FrameVector<WeightedAnimation> &out) = 0;
 };
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "animation_events.h"
+#include "character.h"
+#include "ozz/animation/runtime/track_sampling_job.h"
+#include <algorithm>
+#include <cassert>
+
+void trigger_animation_events(
+  const AnimationTracksPtr &tracks,
+  float from,
+  float to,
+  float weight,
+  AnimationEventCursor &cursor,
+  std::vector<AnimationEvent> &out)
+{
+  const std::vector<AnimationEventKey> &events = tracks->events;
+  if (cursor.tracks != tracks || cursor.progress != from)
+  {
+    cursor.tracks = tracks;
+    cursor.next = std::upper_bound(events.begin(), events.end(), from,
+      [](float ratio, const AnimationEventKey &event) { return ratio < event.ratio; }) - events.begin();
+  }
+  cursor.progress = to;
+  if (from == to)
+    return;
+
+  // short step back re-aligns a synced clip, nothing is crossed, cursor just seeks
+  if (to < from && !progress_wrapped(from, to))
+  {
+    cursor.next = std::upper_bound(events.begin(), events.end(), to,
+      [](float ratio, const AnimationEventKey &event) { return ratio < event.ratio; }) - events.begin();
+    return;
+  }
+  if (to < from)
+  {
+    for (; cursor.next < events.size(); ++cursor.next)
+      out.push_back({tracks->eventNames[events[cursor.next].name], weight});
+    cursor.next = 0;
+  }
+  for (; cursor.next < events.size() && events[cursor.next].ratio <= to; ++cursor.next)
+    out.push_back({tracks->eventNames[events[cursor.next].name], weight});
+}
+
+static void sample_curves(const AnimationTracks &tracks, float progress, float weight, std::vector<AnimationCurveValue> &curves)
+{
+  for (const AnimationCurve &curve : tracks.curves)
+  {
+    float value;
+    ozz::animation::FloatTrackSamplingJob samplingJob;
+    samplingJob.track = curve.track.get();
+    samplingJob.ratio = progress;
+    samplingJob.result = &value;
+    const bool success = samplingJob.Run();
+    assert(success);
+
+    auto it = std::find_if(curves.begin(), curves.end(), [&](const AnimationCurveValue &c) { return c.name == curve.name; });
+    if (it == curves.end())
+      curves.push_back({curve.name, weight * value, weight});
+    else
+    {
+      it->value += weight * value;
+      it->weight += weight;
+    }
+  }
+}
+
+void evaluate_animation_tracks(Character &character, std::span<const WeightedAnimation> animations)
+{
+  character.animationEvents.clear();
+  character.animationCurves.clear();
+
+  int eventLayer = -1;
+  for (size_t i = 0; i < animations.size(); ++i)
+  {
+    const WeightedAnimation &wa = animations[i];
+    if (wa.tracks && !wa.mask && !wa.additive && (eventLayer < 0 || wa.weight > animations[eventLayer].weight))
+      eventLayer = i;
+  }
+
+  // layers follow collected animations one to one, see animate_character
+  std::span<AnimationLayer> layers = character.animationContext.active_layers();
+  assert(layers.size() == animations.size());
+  for (size_t i = 0; i < animations.size(); ++i)
+  {
+    const WeightedAnimation &wa = animations[i];
+    if (!wa.tracks || wa.weight <= 0.f)
+      continue;
+    if (!wa.tracks->events.empty() && (int(i) == eventLayer || wa.mask || wa.additive))
+      trigger_animation_events(wa.tracks, wa.previousProgress, wa.progress, wa.weight, layers[i].eventCursor, character.animationEvents);
+    sample_curves(*wa.tracks, wa.progress, wa.weight, character.animationCurves);
+  }
+
+  for (AnimationCurveValue &curve : character.animationCurves)
+    curve.value /= curve.weight;
+}
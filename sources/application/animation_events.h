@@ -0,0 +1,53 @@
+#pragma once
+#include <span>
+#include <string_view>
+#include <vector>
+#include "engine/import/model.h"
+
+struct Character;
+struct WeightedAnimation;
+
+// event of a clip crossed during the last update, name points into the clip's AnimationTracks
+struct AnimationEvent
+{
+  std::string_view name;
+  float weight;           // weight of the layer that played it
+  uint32_t character = 0; // index in Scene::characters, set when events of a frame are batched
+};
+
+// all events of a frame, application_update dispatches them at once, storage lives in the frame arena
+struct AnimationEventBatch
+{
+  std::span<const AnimationEvent> events;
+};
+
+// curve of the clips playing now, blended by layer weights
+struct AnimationCurveValue
+{
+  std::string_view name;
+  float value;
+  float weight; // total weight of layers that have the curve
+};
+
+// Position in the sorted events of a clip, kept by each layer between frames.
+// While playback goes on from where it stopped, only crossed events are visited, otherwise the cursor seeks again.
+struct AnimationEventCursor
+{
+  AnimationTracksPtr tracks;
+  size_t next = 0;         // first event after progress
+  float progress = -1.f;
+};
+
+// appends events with ratio in (from, to], a long step back means playback wrapped once (see progress_wrapped)
+void trigger_animation_events(
+  const AnimationTracksPtr &tracks,
+  float from,
+  float to,
+  float weight,
+  AnimationEventCursor &cursor,
+  std::vector<AnimationEvent> &out);
+
+// Fills character.animationEvents and character.animationCurves from the layers collected this frame.
+// Events come from the heaviest full body layer only, so blended walk clips don't play every footstep several times,
+// and from every partial body or additive layer, as those play actions of their own.
+void evaluate_animation_tracks(Character &character, std::span<const WeightedAnimation> animations);
@@ -1,28 +1,123 @@
 
 #include "scene.h"
+#include "render_snapshot.h"
+#include "crowd.h"
+#include "pose_regression.h"
+#include "engine/api.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
-void application_init(Scene &scene);
+void application_init(Scene &scene, const char *stateMachinePath, bool keepRawAnimations);
 void application_update(Scene &scene);
-void application_render(Scene &scene);
+void application_prepare_render(Scene &scene, RenderSnapshot &snapshot);
+void application_render(const RenderSnapshot &snapshot);
 void application_imgui_render(Scene &scene);
 
 static std::unique_ptr<Scene> scene;
 
+// Simulation owns renderSnapshots[simulationSnapshot] and render owns the other one.
+// Ownership changes only in game_swap_render_snapshots, when neither side uses them.
+static RenderSnapshot renderSnapshots[2];
+static int simulationSnapshot = 0;
+
+static CrowdSettings crowdSettings;
+static PoseRegressionSettings poseRegression;
+static const char *stateMachinePath = nullptr;
+static bool keepRawAnimations = false; // unoptimized copies of clips, doubles clip memory
+
 // entry points for engine/main.cpp
+// options the engine doesn't know, returns false for unknown ones, i points to the last consumed argument
+bool game_parse_launch_option(int argc, char **argv, int &i)
+{
+  const bool hasValue = i + 1 < argc;
+  const bool hasTwoValues = i + 2 < argc;
+  if (!strcmp(argv[i], "--crowd") && hasValue)
+  {
+    const int count = atoi(argv[++i]);
+    crowdSettings.count = std::clamp(count, 0, MAX_CROWD_SIZE);
+    if (count > MAX_CROWD_SIZE)
+      engine::error("Crowd size %d is clamped to %d", count, MAX_CROWD_SIZE);
+  }
+  else if (!strcmp(argv[i], "--crowd-seed") && hasValue)
+    crowdSettings.seed = uint32_t(strtoul(argv[++i], nullptr, 10));
+  else if (!strcmp(argv[i], "--state-machine") && hasValue)
+    stateMachinePath = argv[++i];
+  else if (!strcmp(argv[i], "--raw-animations"))
+    keepRawAnimations = true;
+  else if (!strcmp(argv[i], "--pose-check") && hasValue)
+  {
+    poseRegression.goldenPath = argv[++i];
+    poseRegression.writeGolden = false;
+  }
+  else if (!strcmp(argv[i], "--pose-golden") && hasValue)
+  {
+    poseRegression.goldenPath = argv[++i];
+    poseRegression.writeGolden = true;
+  }
+  else if (!strcmp(argv[i], "--pose-tolerance") && hasTwoValues)
+  {
+    poseRegression.position = float(atof(argv[++i]));
+    poseRegression.rotationDegrees = float(atof(argv[++i]));
+  }
+  else if (!strcmp(argv[i], "--pose-joint-tolerance") && i + 3 < argc)
+  {
+    const char *jointName = argv[++i];
+    const float position = float(atof(argv[++i]));
+    const float rotationDegrees = float(atof(argv[++i]));
+    poseRegression.jointTolerances.push_back({jointName, position, rotationDegrees});
+  }
+  else
+    return false;
+  return true;
+}
+
 void game_init()
 {
   scene = std::make_unique<Scene>();
-  application_init(*scene);
+  application_init(*scene, stateMachinePath, keepRawAnimations);
+  if (poseRegression.goldenPath && !engine::is_headless())
+    engine::error("--pose-check and --pose-golden run only with --headless");
+  // pose regression sweeps hand-made characters only
+  if (!poseRegression.goldenPath)
+    spawn_crowd(*scene, crowdSettings);
+}
+
+// runs a one-shot task instead of headless frames, returns false when none was requested
+bool game_run_headless_task(int &exitCode)
+{
+  if (!poseRegression.goldenPath)
+    return false;
+  exitCode = run_pose_regression(*scene, poseRegression);
+  return true;
 }
 
 void game_update()
 {
   application_update(*scene);
+  // headless simulation runs on the main thread and never hands frames to render
+  if (engine::is_headless())
+  {
+    dispatch_animation_events(*scene, scene->pendingAnimationEvents);
+    scene->pendingAnimationEvents.clear();
+  }
+}
+
+void game_prepare_render()
+{
+  application_prepare_render(*scene, renderSnapshots[simulationSnapshot]);
+}
+
+void game_swap_render_snapshots()
+{
+  simulationSnapshot ^= 1;
+  // simulation is idle here, the frame it just finished is the one render owns now
+  dispatch_animation_events(*scene, renderSnapshots[simulationSnapshot ^ 1].animationEvents);
 }
 
 void game_render()
 {
-  application_render(*scene);
+  application_render(renderSnapshots[simulationSnapshot ^ 1]);
 }
 
 void game_imgui_render()
@@ -32,5 +127,7 @@ void game_imgui_render()
 
 void game_terminate()
 {
+  for (RenderSnapshot &snapshot : renderSnapshots)
+    snapshot = RenderSnapshot{};
   scene.reset();
 }
\ No newline at end of file
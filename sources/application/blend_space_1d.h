@@ -2,54 +2,72 @@
 
 #include "animation_controller.h"
 #include "engine/import/model.h"
+#include "sync_markers.h"
+#include <algorithm>
+#include <span>
 
 
 struct AnimationNode1D
 {
   const AnimationPtr animation;
   float parameter = 0.f;
+  RootMotionPtr rootMotion = nullptr;
+  SyncTrackPtr sync = nullptr;
+  AnimationTracksPtr tracks = nullptr;
 };
 
+// linear blend between two neighbour nodes, node parameters go in ascending order
+template<typename NodeParameter>
+void blend_space_1d_weights(size_t count, NodeParameter &&node_parameter, float parameter, std::span<float> weights)
+{
+  std::fill(weights.begin(), weights.end(), 0.f);
+
+  if (count == 0)
+    return;
+
+  if (parameter < node_parameter(0))
+  {
+    weights[0] = 1.f;
+    return;
+  }
+  for (size_t i = 0; i < count - 1; ++i)
+  {
+    const float curParameter = node_parameter(i);
+    const float nextParameter = node_parameter(i + 1);
+    if (curParameter <= parameter && parameter < nextParameter)
+    {
+      float t = (parameter - curParameter) / (nextParameter - curParameter);
+      weights[i] = 1.f - t;
+      weights[i + 1] = t;
+    }
+  }
+  if (parameter >= node_parameter(count - 1))
+  {
+    weights[count - 1] = 1.f;
+    return;
+  }
+}
+
 struct BlendSpace1D final : IAnimationController
 {
   std::vector<AnimationNode1D> animations;
   std::vector<float> weights;
-  float progress = 0.f;
+  float progress = 0.f; // normalized time of the leading clip
+  int leader = -1;      // heaviest clip with sync markers, see sync_markers.h
+  std::vector<float> clipProgress;
+  std::vector<float> clipPreviousProgress;
 
   BlendSpace1D(const std::vector<AnimationNode1D> & _animations) : animations{_animations}
   {
     weights.resize(animations.size());
+    clipProgress.resize(animations.size());
     set_parameter(0.f);
+    set_progress(0.f);
   }
 
   void set_parameter(float parameter)
   {
-    weights.assign(animations.size(), 0.f);
-
-    if (animations.empty())
-      return;
-
-    if (parameter < animations[0].parameter)
-    {
-      weights[0] = 1.f;
-      return;
-    }
-    for (size_t i = 0; i < animations.size() - 1; ++i)
-    {
-      const AnimationNode1D &curNode = animations[i];
-      const AnimationNode1D &nextNode = animations[i + 1];
-      if (curNode.parameter <= parameter && parameter < nextNode.parameter)
-      {
-        float t = (parameter - curNode.parameter) / (nextNode.parameter - curNode.parameter);
-        weights[i] = 1.f - t;
-        weights[i + 1] = t;
-      }
-    }
-    if (parameter >= animations.back().parameter)
-    {
-      weights.back() = 1.f;
-      return;
-    }
+    blend_space_1d_weights(animations.size(), [this](size_t i) { return animations[i].parameter; }, parameter, weights);
   }
 
   void update(float dt) override
@@ -60,16 +78,34 @@ struct BlendSpace1D final : IAnimationController
       duration += weights[i] * animations[i].animation->duration();
     }
 
+    clipPreviousProgress = clipProgress;
+    // new leader goes on from its current ratio, so no clip jumps when weights change
+    const int newLeader = find_sync_leader(animations, weights);
+    if (newLeader >= 0 && newLeader != leader)
+      progress = clipProgress[newLeader];
+    leader = newLeader;
+
     progress += dt / duration;
     if (progress > 1.f)
       progress -= 1.f;
+    sync_clip_progress(animations, leader, progress, clipProgress);
+  }
+
+  void set_progress(float _progress) override
+  {
+    leader = find_sync_leader(animations, weights);
+    progress = _progress;
+    sync_clip_progress(animations, leader, progress, clipProgress);
+    clipPreviousProgress = clipProgress;
   }
 
-  void collect_animations(std::vector<WeightedAnimation> &out) override
+  void collect_animations(FrameVector<WeightedAnimation> &out) override
   {
     for (size_t i = 0; i < animations.size(); ++i)
     {
-      out.push_back({animations[i].animation, weights[i], progress});
+      out.push_back({.animation = animations[i].animation, .weight = weights[i], .progress = clipProgress[i],
+        .rootMotion = animations[i].rootMotion, .previousProgress = clipPreviousProgress[i],
+        .tracks = animations[i].tracks});
     }
   }
 };
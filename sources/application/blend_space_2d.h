@@ -2,16 +2,22 @@
 
 #include "animation_controller.h"
 #include "engine/import/model.h"
+#include "sync_markers.h"
 #include "glm/fwd.hpp"
 #include "glm/geometric.hpp"
 #include "glm/gtx/compatibility.hpp"
 #include "glm/matrix.hpp"
+#include <algorithm>
+#include <span>
 
 
 struct AnimationNode2D
 {
   const AnimationPtr animation;
   glm::float2 parameter = {0.f, 0.f};
+  RootMotionPtr rootMotion = nullptr;
+  SyncTrackPtr sync = nullptr;
+  AnimationTracksPtr tracks = nullptr;
 };
 
 struct AnimationTriangle
@@ -34,134 +40,151 @@ inline bool point_D_in_circle_ABC(glm::float2 A, glm::float2 B, glm::float2 C, g
   }) > 0.f;
 }
 
-struct BlendSpace2D final : IAnimationController
+// Delaunay triangulation (Bowyer-Watson) of blend space node parameters, triangles index nodePoints
+inline std::vector<AnimationTriangle> triangulate_blend_space(std::span<const glm::float2> nodePoints)
 {
-  std::vector<AnimationNode2D> animations;
+  const size_t count = nodePoints.size();
   std::vector<AnimationTriangle> triangulation;
-  std::vector<float> weights;
-  float progress = 0.f;
+  std::vector<glm::float2> points = {};
+  points.reserve(count + 3);
+  points.assign(nodePoints.begin(), nodePoints.end());
 
-  BlendSpace2D(const std::vector<AnimationNode2D> & _animations) : animations{_animations}
   {
+    glm::float2 minPoint = {0.f, 0.f};
+    glm::float2 maxPoint = {0.f, 0.f};
+    for (const glm::float2 point : nodePoints)
+    {
+      minPoint = {min(minPoint.x, point.x), min(minPoint.y, point.y)};
+      maxPoint = {max(maxPoint.x, point.x), max(maxPoint.y, point.y)};
+    }
+    minPoint -= glm::float2{1.f, 1.f};
+    maxPoint += glm::float2{1.f, 1.f};
+
+    float maxSide = max(maxPoint.x - minPoint.x, maxPoint.y - minPoint.y);
+    points.push_back(minPoint);
+    points.push_back({minPoint.x, minPoint.y + 2 * maxSide});
+    points.push_back({minPoint.x + 2 * maxSide, minPoint.y});
+  }
+
+  triangulation.push_back({
+      count,
+      count + 1,
+      count + 2
+  });
+
+
+  std::vector<size_t> trianglesIndiciesToDelete = {};
+  for (size_t i = 0; i < points.size(); ++i)
+  {
+    trianglesIndiciesToDelete.clear();
+
+    const glm::float2 curPoint = points[i];
+
+    for (size_t j = 0; j < triangulation.size(); ++j)
     {
-      std::vector<glm::float2> points = {};
-      points.reserve(animations.size() + 3);
-      for (const AnimationNode2D &node : animations)
-        points.push_back(node.parameter);
+      const AnimationTriangle curTriangle = triangulation[j];
 
+      if (point_D_in_circle_ABC(
+        points[curTriangle.idx1],
+        points[curTriangle.idx2],
+        points[curTriangle.idx3],
+        curPoint))
       {
-        glm::float2 minPoint = {0.f, 0.f};
-        glm::float2 maxPoint = {0.f, 0.f};
-        for (const AnimationNode2D &node : animations)
-        {
-          const glm::float2 point = node.parameter;
-
-          minPoint = {min(minPoint.x, point.x), min(minPoint.y, point.y)};
-          maxPoint = {max(maxPoint.x, point.x), max(maxPoint.y, point.y)};
-        }
-        minPoint -= glm::float2{1.f, 1.f};
-        maxPoint += glm::float2{1.f, 1.f};
-
-        float maxSide = max(maxPoint.x - minPoint.x, maxPoint.y - minPoint.y);
-        points.push_back(minPoint);
-        points.push_back({minPoint.x, minPoint.y + 2 * maxSide});
-        points.push_back({minPoint.x + 2 * maxSide, minPoint.y});
+        trianglesIndiciesToDelete.push_back(j);
       }
+    }
 
-      triangulation = {};
-      triangulation.push_back({
-          animations.size(),
-          animations.size() + 1,
-          animations.size() + 2
-      });
+    for (const size_t deletingTriangleIdx : trianglesIndiciesToDelete)
+    {
+      const AnimationTriangle curTriangle = triangulation[deletingTriangleIdx];
 
+      triangulation.push_back({i, curTriangle.idx2, curTriangle.idx3});
+      triangulation.push_back({curTriangle.idx1, i, curTriangle.idx3});
+      triangulation.push_back({curTriangle.idx1, curTriangle.idx2, i});
+    }
 
-      std::vector<size_t> trianglesIndiciesToDelete = {};
-      for (size_t i = 0; i < points.size(); ++i)
-      {
-        trianglesIndiciesToDelete.clear();
+    for (int j = 0; j < trianglesIndiciesToDelete.size(); ++j)
+      std::swap(triangulation[trianglesIndiciesToDelete[j]], *(triangulation.end() - 1 - j));
 
-        const glm::float2 curPoint = points[i];
+    triangulation.erase(triangulation.end() - trianglesIndiciesToDelete.size(), triangulation.end());
+  }
 
-        for (size_t j = 0; j < triangulation.size(); ++j)
-        {
-          const AnimationTriangle curTriangle = triangulation[j];
 
-          if (point_D_in_circle_ABC(
-            points[curTriangle.idx1],
-            points[curTriangle.idx2],
-            points[curTriangle.idx3],
-            curPoint))
-          {
-            trianglesIndiciesToDelete.push_back(j);
-          }
-        }
+  trianglesIndiciesToDelete.clear();
 
-        for (const size_t deletingTriangleIdx : trianglesIndiciesToDelete)
-        {
-          const AnimationTriangle curTriangle = triangulation[deletingTriangleIdx];
+  for (size_t i = 0; i < triangulation.size(); ++i)
+  {
+    const AnimationTriangle curTriangle = triangulation[i];
 
-          triangulation.push_back({i, curTriangle.idx2, curTriangle.idx3});
-          triangulation.push_back({curTriangle.idx1, i, curTriangle.idx3});
-          triangulation.push_back({curTriangle.idx1, curTriangle.idx2, i});
-        }
+    if (
+      curTriangle.idx1 >= count ||
+      curTriangle.idx2 >= count ||
+      curTriangle.idx3 >= count)
+    {
+      trianglesIndiciesToDelete.push_back(i);
+    }
+  }
 
-        for (int j = 0; j < trianglesIndiciesToDelete.size(); ++j)
-          std::swap(triangulation[trianglesIndiciesToDelete[j]], *(triangulation.end() - 1 - j));
+  for (int i = trianglesIndiciesToDelete.size() - 1; i >= 0; --i)
+    triangulation.erase(triangulation.begin() + trianglesIndiciesToDelete[i]);
 
-        triangulation.erase(triangulation.end() - trianglesIndiciesToDelete.size(), triangulation.end());
-      }
+  return triangulation;
+}
 
+// barycentric weights of the triangle that contains parameter, all zero when it's outside of the triangulation
+template<typename NodePoint>
+void blend_space_2d_weights(std::span<const AnimationTriangle> triangulation, NodePoint &&node_point, glm::float2 parameter, std::span<float> weights)
+{
+  std::fill(weights.begin(), weights.end(), 0.f);
 
-      trianglesIndiciesToDelete.clear();
+  for (const AnimationTriangle &triangle : triangulation)
+  {
+    const glm::float2 p1 = node_point(triangle.idx1);
+    const glm::float2 p2 = node_point(triangle.idx2);
+    const glm::float2 p3 = node_point(triangle.idx3);
 
-      for (size_t i = 0; i < triangulation.size(); ++i)
-      {
-        const AnimationTriangle curTriangle = triangulation[i];
-
-        if (
-          curTriangle.idx1 >= animations.size() ||
-          curTriangle.idx2 >= animations.size() ||
-          curTriangle.idx3 >= animations.size())
-        {
-          trianglesIndiciesToDelete.push_back(i);
-        }
-      }
+    float S = 0.5 * glm::length(glm::cross(glm::float3(p2 - p1, 0.0), glm::float3(p3 - p1, 0.0)));
+    float l1 = 0.5 * glm::length(glm::cross(glm::float3(p2 - parameter, 0.0), glm::float3(p3 - parameter, 0.0))) / S;
+    float l2 = 0.5 * glm::length(glm::cross(glm::float3(p1 - parameter, 0.0), glm::float3(p3 - parameter, 0.0))) / S;
+    float l3 = 0.5 * glm::length(glm::cross(glm::float3(p1 - parameter, 0.0), glm::float3(p2 - parameter, 0.0))) / S;
 
-      for (int i = trianglesIndiciesToDelete.size() - 1; i >= 0; --i)
-        triangulation.erase(triangulation.begin() + trianglesIndiciesToDelete[i]);
+    if (l1 + l2 + l3 <= 1.0f)
+    {
+      weights[triangle.idx1] = l1;
+      weights[triangle.idx2] = l2;
+      weights[triangle.idx3] = l3;
+      break;
     }
+  }
+}
+
+struct BlendSpace2D final : IAnimationController
+{
+  std::vector<AnimationNode2D> animations;
+  std::vector<AnimationTriangle> triangulation;
+  std::vector<float> weights;
+  float progress = 0.f; // normalized time of the leading clip
+  int leader = -1;      // heaviest clip with sync markers, see sync_markers.h
+  std::vector<float> clipProgress;
+  std::vector<float> clipPreviousProgress;
+
+  BlendSpace2D(const std::vector<AnimationNode2D> & _animations) : animations{_animations}
+  {
+    std::vector<glm::float2> nodePoints;
+    nodePoints.reserve(animations.size());
+    for (const AnimationNode2D &node : animations)
+      nodePoints.push_back(node.parameter);
+    triangulation = triangulate_blend_space(nodePoints);
 
     weights.resize(animations.size());
+    clipProgress.resize(animations.size());
     set_parameter({0.f, 0.f});
+    set_progress(0.f);
   }
 
   void set_parameter(glm::float2 parameter)
   {
-    weights.assign(animations.size(), 0.f);
-
-    if (animations.empty())
-      return;
-
-    for (const AnimationTriangle &triangle : triangulation)
-    {
-      const glm::float2 p1 = animations[triangle.idx1].parameter;
-      const glm::float2 p2 = animations[triangle.idx2].parameter;
-      const glm::float2 p3 = animations[triangle.idx3].parameter;
-
-      float S = 0.5 * glm::length(glm::cross(glm::float3(p2 - p1, 0.0), glm::float3(p3 - p1, 0.0)));
-      float l1 = 0.5 * glm::length(glm::cross(glm::float3(p2 - parameter, 0.0), glm::float3(p3 - parameter, 0.0))) / S;
-      float l2 = 0.5 * glm::length(glm::cross(glm::float3(p1 - parameter, 0.0), glm::float3(p3 - parameter, 0.0))) / S;
-      float l3 = 0.5 * glm::length(glm::cross(glm::float3(p1 - parameter, 0.0), glm::float3(p2 - parameter, 0.0))) / S;
-
-      if (l1 + l2 + l3 <= 1.0f)
-      {
-        weights[triangle.idx1] = l1;
-        weights[triangle.idx2] = l2;
-        weights[triangle.idx3] = l3;
-        break;
-      }
-    }
+    blend_space_2d_weights(triangulation, [this](size_t i) { return animations[i].parameter; }, parameter, weights);
   }
 
   void update(float dt) override
@@ -172,16 +195,35 @@ struct BlendSpace2D final : IAnimationController
       duration += weights[i] * animations[i].animation->duration();
     }
 
+    clipPreviousProgress = clipProgress;
+    // new leader goes on from its current ratio, so no clip jumps when weights change
+    const int newLeader = find_sync_leader(animations, weights);
+    if (newLeader >= 0 && newLeader != leader)
+      progress = clipProgress[newLeader];
+    leader = newLeader;
+
     progress += dt / duration;
     if (progress > 1.f)
       progress -= 1.f;
+    sync_clip_progress(animations, leader, progress, clipProgress);
+  }
+
+  void set_progress(float _progress) override
+  {
+    leader = find_sync_leader(animations, weights);
+    progress = _progress;
+    sync_clip_progress(animations, leader, progress, clipProgress);
+    clipPreviousProgress = clipProgress;
   }
 
-  void collect_animations(std::vector<WeightedAnimation> &out) override
+  void collect_animations(FrameVector<WeightedAnimation> &out) override
   {
     for (size_t i = 0; i < animations.size(); ++i)
     {
-      out.push_back({animations[i].animation, weights[i], progress});
+      // root deltas are taken over each clip's own synced time, so they match the blended pose
+      out.push_back({.animation = animations[i].animation, .weight = weights[i], .progress = clipProgress[i],
+        .rootMotion = animations[i].rootMotion, .previousProgress = clipPreviousProgress[i],
+        .tracks = animations[i].tracks});
     }
   }
 };
@@ -6,11 +6,15 @@
 #include "import/model.h"
 #include <map>
 #include <memory>
+#include <span>
 #include "ozz/animation/runtime/sampling_job.h"
 #include "ozz/animation/runtime/skeleton.h"
 #include "ozz/base/maths/simd_math.h"
 #include "ozz/base/maths/soa_transform.h"
 #include "animation_controller.h"
+#include "joint_mask.h"
+#include "character_ik.h"
+#include "animation_events.h"
 
 
 struct AnimationLayer
@@ -20,6 +24,9 @@ struct AnimationLayer
   std::unique_ptr<ozz::animation::SamplingJob::Context> samplingCache;
   float currentProgress = 0.f;
   float weight = 1.f;
+  JointMaskPtr mask; // null for whole body layers
+  bool additive = false;
+  AnimationEventCursor eventCursor;
 };
 
 struct AnimationContext
@@ -27,31 +34,66 @@ struct AnimationContext
   SkeletonPtr skeleton;
   std::vector<ozz::math::SoaTransform> localTransforms;
   std::vector<ozz::math::Float4x4> worldTransforms;
+  // layers are reused between frames with their buffers and sampling caches, first activeLayers are used
   std::vector<AnimationLayer> layers;
+  size_t activeLayers = 0;
+
+  // pose of the previous simulation step and pose interpolated for rendering
+  std::vector<ozz::math::SoaTransform> prevLocalTransforms;
+  std::vector<ozz::math::SoaTransform> renderLocalTransforms;
+  std::vector<ozz::math::Float4x4> renderTransforms;
 
   void setup(const SkeletonPtr &_skeleton)
   {
     skeleton = _skeleton;
     worldTransforms.resize(skeleton->num_joints());
-    localTransforms.resize(_skeleton->num_soa_joints());
+    renderTransforms.resize(skeleton->num_joints());
+    auto restPose = skeleton->joint_rest_poses();
+    localTransforms.assign(restPose.begin(), restPose.end());
+    prevLocalTransforms.assign(restPose.begin(), restPose.end());
+    renderLocalTransforms.resize(skeleton->num_soa_joints());
   }
 
-  void add_animation(const AnimationPtr &animation, float progress, float weight = 1.f)
+  void add_animation(const AnimationPtr &animation, float progress, float weight = 1.f, const JointMaskPtr &mask = nullptr, bool additive = false)
   {
-    AnimationLayer &layer = layers.emplace_back();
+    AnimationLayer &layer = activeLayers < layers.size() ? layers[activeLayers] : layers.emplace_back();
+    activeLayers++;
     layer.localLayerTransforms.resize(skeleton->num_soa_joints());
-    layer.curentAnimation = animation;
-    layer.currentProgress = progress;
-    layer.weight = weight;
     if (!layer.samplingCache)
       layer.samplingCache = std::make_unique<ozz::animation::SamplingJob::Context>(skeleton->num_joints());
-    else
+    else if (layer.samplingCache->max_tracks() < skeleton->num_joints())
       layer.samplingCache->Resize(skeleton->num_joints());
+    // layer keeps its animation alive, so a different pointer always means a different animation
+    else if (layer.curentAnimation != animation)
+      layer.samplingCache->Invalidate();
+    layer.curentAnimation = animation;
+    layer.currentProgress = progress;
+    layer.weight = weight;
+    layer.mask = mask;
+    layer.additive = additive;
   }
 
   void clear_animation_layers()
   {
-    layers.clear();
+    activeLayers = 0;
+  }
+
+  // unused layers shouldn't keep animations loaded
+  void release_inactive_layers()
+  {
+    for (size_t i = activeLayers; i < layers.size(); ++i)
+      if (layers[i].curentAnimation)
+      {
+        layers[i].curentAnimation = nullptr;
+        layers[i].mask = nullptr;
+        layers[i].samplingCache->Invalidate();
+        layers[i].eventCursor = {};
+      }
+  }
+
+  std::span<AnimationLayer> active_layers()
+  {
+    return {layers.data(), activeLayers};
   }
 };
 
@@ -59,12 +101,19 @@ struct Character
 {
   std::string name;
   glm::mat4 transform;
+  glm::mat4 prevTransform = glm::identity<glm::mat4>(); // transform of the previous simulation step
+  glm::mat4 renderTransform = glm::identity<glm::mat4>();
   std::vector<MeshPtr> meshes;
   MaterialPtr material;
-  SkeletonData skeleton;
+  std::shared_ptr<const SkeletonData> skeleton; // shared by all characters of the model
   AnimationContext animationContext;
 
   std::vector<std::shared_ptr<IAnimationController>> controllers;
+  CharacterIk ik;
+  // filled by animate_character, valid until the next update
+  std::vector<AnimationEvent> animationEvents;
+  std::vector<AnimationCurveValue> animationCurves;
+  std::string lastAnimationEvent; // shown in UI, set by dispatch_animation_events
 
   float linearVelocity = 0.f;
   glm::float2 velocity = {0.f, 0.f};
@@ -0,0 +1,255 @@
+#include "character_ik.h"
+#include "scene.h"
+#include "engine/frame_arena.h"
+#include "engine/api.h"
+#include "engine/profiler.h"
+#include "ozz/animation/runtime/ik_aim_job.h"
+#include "ozz/animation/runtime/ik_two_bone_job.h"
+#include "ozz/animation/runtime/local_to_model_job.h"
+#include "ozz/base/maths/simd_quaternion.h"
+#include "ozz/base/maths/soa_transform.h"
+#include "ozz/base/maths/vec_float.h"
+#include <cassert>
+#include <cstring>
+
+using ozz::math::Float4x4;
+using ozz::math::SimdFloat4;
+using ozz::math::SimdQuaternion;
+
+int find_joint_by_suffix(const ozz::animation::Skeleton &skeleton, const char *suffix)
+{
+  const size_t suffixLength = strlen(suffix);
+  const auto names = skeleton.joint_names();
+  for (int i = 0; i < skeleton.num_joints(); ++i)
+  {
+    const size_t length = strlen(names[i]);
+    if (length >= suffixLength && !strcmp(names[i] + length - suffixLength, suffix))
+      return i;
+  }
+  return -1;
+}
+
+// parents go before children in ozz joint order, so the deeper joint is always the bigger index
+static int common_ancestor(ozz::span<const int16_t> parents, int a, int b)
+{
+  while (a != b && a >= 0 && b >= 0)
+  {
+    if (a > b)
+      a = parents[a];
+    else
+      b = parents[b];
+  }
+  return a == b ? a : -1;
+}
+
+bool add_leg_ik(CharacterIk &ik, const ozz::animation::Skeleton &skeleton, const char *upLeg, const char *leg, const char *foot)
+{
+  TwoBoneIkChain chain;
+  chain.start = find_joint_by_suffix(skeleton, upLeg);
+  chain.mid = find_joint_by_suffix(skeleton, leg);
+  chain.end = find_joint_by_suffix(skeleton, foot);
+  if (chain.start < 0 || chain.mid < 0 || chain.end < 0)
+    return false;
+  // body is lowered from above the thigh, so one leg alone still moves the whole body
+  const ozz::span<const int16_t> parents = skeleton.joint_parents();
+  const int legRoot = parents[chain.start];
+  ik.pelvis = ik.legs.empty() ? legRoot : common_ancestor(parents, ik.pelvis, legRoot);
+  if (ik.pelvis < 0)
+    engine::error("leg \"%s\" has no common ancestor with other legs, pelvis won't be lowered", upLeg);
+  ik.legs.push_back(chain);
+  return true;
+}
+
+bool add_look_at_ik(CharacterIk &ik, const ozz::animation::Skeleton &skeleton, const std::vector<const char *> &jointsFromHead)
+{
+  AimIkChain chain;
+  for (const char *name : jointsFromHead)
+  {
+    const int joint = find_joint_by_suffix(skeleton, name);
+    if (joint < 0)
+      return false;
+    chain.joints.push_back(joint);
+  }
+  if (chain.joints.empty())
+    return false;
+  // disabled until gameplay gives it a target
+  chain.weight = 0.f;
+  ik.aims.push_back(std::move(chain));
+  return true;
+}
+
+static Float4x4 to_simd(const mat4 &matrix)
+{
+  Float4x4 result;
+  for (int column = 0; column < 4; ++column)
+    result.cols[column] = ozz::math::simd_float4::LoadPtrU(glm::value_ptr(matrix[column]));
+  return result;
+}
+
+// joint rotation in a soa transform is one lane of 4 joints, it's transposed out and back
+static void multiply_local_rotation(std::vector<ozz::math::SoaTransform> &locals, int joint, const SimdQuaternion &correction)
+{
+  ozz::math::SoaTransform &soa = locals[joint / 4];
+  SimdFloat4 quaternions[4];
+  ozz::math::Transpose4x4(&soa.rotation.x, quaternions);
+  quaternions[joint & 3] = (SimdQuaternion{quaternions[joint & 3]} * correction).xyzw;
+  ozz::math::Transpose4x4(quaternions, &soa.rotation.x);
+}
+
+static void add_local_translation(std::vector<ozz::math::SoaTransform> &locals, int joint, const SimdFloat4 &offset)
+{
+  ozz::math::SoaTransform &soa = locals[joint / 4];
+  float values[4];
+  ozz::math::StorePtrU(offset, values);
+  float lanes[3][4] = {};
+  for (int axis = 0; axis < 3; ++axis)
+    lanes[axis][joint & 3] = values[axis];
+  soa.translation.x = soa.translation.x + ozz::math::simd_float4::LoadPtrU(lanes[0]);
+  soa.translation.y = soa.translation.y + ozz::math::simd_float4::LoadPtrU(lanes[1]);
+  soa.translation.z = soa.translation.z + ozz::math::simd_float4::LoadPtrU(lanes[2]);
+}
+
+// joint and its descendants, contiguous in depth first joint order
+static int subtree_end(const ozz::animation::Skeleton &skeleton, int joint)
+{
+  const ozz::span<const int16_t> parents = skeleton.joint_parents();
+  int end = joint + 1;
+  while (end < skeleton.num_joints() && parents[end] >= joint)
+    ++end;
+  return end;
+}
+
+// converts joint and its descendants only, they're contiguous in depth first joint order
+static void update_subtree(const ozz::animation::Skeleton &skeleton, std::vector<ozz::math::SoaTransform> &locals,
+  std::vector<Float4x4> &models, int joint)
+{
+  ozz::animation::LocalToModelJob localToModelJob;
+  localToModelJob.skeleton = &skeleton;
+  localToModelJob.input = ozz::make_span(locals);
+  localToModelJob.output = ozz::make_span(models);
+  localToModelJob.from = joint;
+  assert(localToModelJob.Validate());
+  const bool success = localToModelJob.Run();
+  assert(success);
+}
+
+static void apply_leg_ik(const Scene &scene, Character &character, const Float4x4 &toWorld, const Float4x4 &toModel)
+{
+  PROFILE_ZONE("leg_ik");
+  AnimationContext &animationContext = character.animationContext;
+  std::vector<Float4x4> &models = animationContext.worldTransforms;
+  const CharacterIk &ik = character.ik;
+  const SimdFloat4 up = ozz::math::simd_float4::y_axis();
+
+  // ground height under every animated ankle relative to character's own ground level, in model space
+  const float characterGround = character.transform[3].y;
+  // simd types lose their alignment attribute as template arguments, targets are stored unaligned
+  FrameVector<ozz::math::Float4> targets(ik.legs.size());
+  const size_t legCount = ik.legs.size();
+  float lowestOffset = 0.f;
+  for (size_t i = 0; i < legCount; ++i)
+  {
+    const SimdFloat4 ankle = models[ik.legs[i].end].cols[3];
+    float world[4];
+    ozz::math::StorePtrU(ozz::math::TransformPoint(toWorld, ankle), world);
+    const float groundOffset = scene.groundHeight(world[0], world[2]) - characterGround;
+    lowestOffset = std::min(lowestOffset, groundOffset);
+    const SimdFloat4 targetWorld = ozz::math::TransformPoint(toWorld, ankle) + up * ozz::math::simd_float4::Load1(groundOffset);
+    ozz::math::StorePtrU(ozz::math::TransformPoint(toModel, targetWorld), &targets[i].x);
+  }
+
+  // legs only bend, so the body goes down to let a foot reach lower ground,
+  // pelvis local offset is taken in its parent space, model matrices of its subtree are moved instead of converted again
+  if (ik.lowerPelvis && ik.pelvis >= 0 && lowestOffset < 0.f)
+  {
+    const ozz::animation::Skeleton &skeleton = *animationContext.skeleton;
+    const SimdFloat4 offset = ozz::math::TransformVector(toModel, up * ozz::math::simd_float4::Load1(lowestOffset));
+    const int parent = skeleton.joint_parents()[ik.pelvis];
+    const SimdFloat4 localOffset = parent >= 0 ? ozz::math::TransformVector(ozz::math::Invert(models[parent]), offset) : offset;
+    add_local_translation(animationContext.localTransforms, ik.pelvis, localOffset);
+    const int end = subtree_end(skeleton, ik.pelvis);
+    for (int joint = ik.pelvis; joint < end; ++joint)
+      models[joint].cols[3] = models[joint].cols[3] + offset;
+  }
+
+  for (size_t i = 0; i < legCount; ++i)
+  {
+    const TwoBoneIkChain &leg = ik.legs[i];
+    if (leg.weight <= 0.f)
+      continue;
+    SimdQuaternion startCorrection, midCorrection;
+    ozz::animation::IKTwoBoneJob ikJob;
+    ikJob.target = ozz::math::simd_float4::LoadPtrU(&targets[i].x);
+    ikJob.pole_vector = models[leg.mid].cols[1];
+    ikJob.mid_axis = leg.midAxis;
+    ikJob.weight = leg.weight;
+    ikJob.soften = leg.soften;
+    ikJob.start_joint = &models[leg.start];
+    ikJob.mid_joint = &models[leg.mid];
+    ikJob.end_joint = &models[leg.end];
+    ikJob.start_joint_correction = &startCorrection;
+    ikJob.mid_joint_correction = &midCorrection;
+    assert(ikJob.Validate());
+    const bool success = ikJob.Run();
+    assert(success);
+
+    multiply_local_rotation(animationContext.localTransforms, leg.start, startCorrection);
+    multiply_local_rotation(animationContext.localTransforms, leg.mid, midCorrection);
+    update_subtree(*animationContext.skeleton, animationContext.localTransforms, models, leg.start);
+  }
+}
+
+static void apply_aim_ik(Character &character, const Float4x4 &toModel)
+{
+  PROFILE_ZONE("aim_ik");
+  AnimationContext &animationContext = character.animationContext;
+  std::vector<Float4x4> &models = animationContext.worldTransforms;
+  for (const AimIkChain &aim : character.ik.aims)
+  {
+    if (aim.weight <= 0.f)
+      continue;
+    const SimdFloat4 target = ozz::math::TransformPoint(toModel, ozz::math::simd_float4::Load3PtrU(glm::value_ptr(aim.target)));
+    // corrections of the whole chain are computed on the animated pose and converted once from the base joint,
+    // every joint gets forward and offset of the previous one with its correction applied, the base joint gets the rest of the rotation
+    SimdQuaternion correction = ozz::math::SimdQuaternion::identity();
+    SimdFloat4 forward = aim.forward;
+    SimdFloat4 offset = aim.offset;
+    for (size_t i = 0; i < aim.joints.size(); ++i)
+    {
+      const int joint = aim.joints[i];
+      if (i > 0)
+      {
+        const Float4x4 &previous = models[aim.joints[i - 1]];
+        const Float4x4 toJoint = ozz::math::Invert(models[joint]);
+        forward = ozz::math::TransformVector(toJoint, ozz::math::TransformVector(previous, ozz::math::TransformVector(correction, forward)));
+        offset = ozz::math::TransformPoint(toJoint, ozz::math::TransformPoint(previous, ozz::math::TransformVector(correction, offset)));
+      }
+      ozz::animation::IKAimJob ikJob;
+      ikJob.target = target;
+      ikJob.forward = forward;
+      ikJob.offset = offset;
+      ikJob.up = aim.up;
+      ikJob.pole_vector = ozz::math::simd_float4::y_axis();
+      ikJob.weight = i + 1 == aim.joints.size() ? aim.weight : aim.weight * aim.jointWeight;
+      ikJob.joint = &models[joint];
+      ikJob.joint_correction = &correction;
+      assert(ikJob.Validate());
+      const bool success = ikJob.Run();
+      assert(success);
+      multiply_local_rotation(animationContext.localTransforms, joint, correction);
+    }
+    update_subtree(*animationContext.skeleton, animationContext.localTransforms, models, aim.joints.back());
+  }
+}
+
+void apply_character_ik(const Scene &scene, Character &character)
+{
+  if (character.ik.legs.empty() && character.ik.aims.empty())
+    return;
+  PROFILE_ZONE("ik");
+  const Float4x4 toWorld = to_simd(character.transform);
+  const Float4x4 toModel = ozz::math::Invert(toWorld);
+  if (!character.ik.legs.empty())
+    apply_leg_ik(scene, character, toWorld, toModel);
+  apply_aim_ik(character, toModel);
+}
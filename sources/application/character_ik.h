@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include "engine/3dmath.h"
+#include "ozz/base/maths/simd_math.h"
+#include "ozz/animation/runtime/skeleton.h"
+
+struct Scene;
+struct Character;
+
+// Leg chain (thigh, knee, ankle), the ankle is moved by ground height under its animated position,
+// so clips authored on flat ground keep feet on uneven ground.
+struct TwoBoneIkChain
+{
+  int start = -1, mid = -1, end = -1;
+  ozz::math::SimdFloat4 midAxis = ozz::math::simd_float4::z_axis(); // knee bend axis in knee local space
+  float soften = 0.97f;
+  float weight = 1.f;
+};
+
+// Look-at chain, joints go from the end effector (head) down to the base (spine), as in ozz look-at sample.
+// Every joint but the base takes jointWeight of the remaining rotation, the base takes the rest.
+struct AimIkChain
+{
+  std::vector<int> joints;
+  ozz::math::SimdFloat4 forward = ozz::math::simd_float4::y_axis(); // end effector local space
+  ozz::math::SimdFloat4 up = ozz::math::simd_float4::x_axis();
+  ozz::math::SimdFloat4 offset = ozz::math::simd_float4::zero(); // eyes relative to end effector
+  float jointWeight = 0.5f;
+  float weight = 1.f;
+  vec3 target = vec3(0.f); // world space
+};
+
+// IK applied after local to model, only subtrees of corrected joints are converted to model space again.
+// Corrections are written to local transforms too, so interpolated render poses keep them.
+struct CharacterIk
+{
+  std::vector<TwoBoneIkChain> legs;
+  std::vector<AimIkChain> aims;
+  bool lowerPelvis = true; // lowers the whole body when a foot stands below the character's ground level
+  int pelvis = -1;         // common ancestor of all legs, the joint lowerPelvis moves, -1 when legs have none
+};
+
+// joint whose name ends with suffix, rigs prefix joint names with namespaces ("mixamorig:LeftFoot")
+int find_joint_by_suffix(const ozz::animation::Skeleton &skeleton, const char *suffix);
+
+// false when some joint isn't found, the chain is not added then
+bool add_leg_ik(CharacterIk &ik, const ozz::animation::Skeleton &skeleton, const char *upLeg, const char *leg, const char *foot);
+bool add_look_at_ik(CharacterIk &ik, const ozz::animation::Skeleton &skeleton, const std::vector<const char *> &jointsFromHead);
+
+void apply_character_ik(const Scene &scene, Character &character);
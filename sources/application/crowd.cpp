@@ -0,0 +1,83 @@
+#include "crowd.h"
+#include "scene.h"
+#include "blend_space_1d.h"
+#include "blend_space_2d.h"
+#include "single_animation.h"
+#include "additive_animation.h"
+#include "state_machine.h"
+#include "engine/api.h"
+#include "engine/profiler.h"
+#include <cmath>
+#include <random>
+
+// copy keeps triangulation and weights of the archetype, so the crowd doesn't triangulate again
+static std::shared_ptr<IAnimationController> clone_controller(const IAnimationController &controller)
+{
+  if (const BlendSpace2D *blendSpace = dynamic_cast<const BlendSpace2D *>(&controller))
+    return std::make_shared<BlendSpace2D>(*blendSpace);
+  if (const BlendSpace1D *blendSpace = dynamic_cast<const BlendSpace1D *>(&controller))
+    return std::make_shared<BlendSpace1D>(*blendSpace);
+  if (const SingleAnimation *single = dynamic_cast<const SingleAnimation *>(&controller))
+    return std::make_shared<SingleAnimation>(*single);
+  if (const AdditiveAnimation *additive = dynamic_cast<const AdditiveAnimation *>(&controller))
+    return std::make_shared<AdditiveAnimation>(*additive);
+  // description is shared, only playback state is copied
+  if (const StateMachine *stateMachine = dynamic_cast<const StateMachine *>(&controller))
+    return std::make_shared<StateMachine>(*stateMachine);
+  return nullptr;
+}
+
+void spawn_crowd(Scene &scene, const CrowdSettings &settings)
+{
+  PROFILE_ZONE("spawn_crowd");
+  const size_t archetypeCount = scene.characters.size();
+  if (settings.count <= 0 || archetypeCount == 0)
+    return;
+
+  std::mt19937 rng(settings.seed);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  std::uniform_real_distribution<float> signedUnit(-1.f, 1.f);
+
+  // square grid in front of the hand-made characters
+  const int side = int(std::ceil(std::sqrt(float(settings.count))));
+  const float halfExtent = 0.5f * (side - 1) * settings.spacing;
+  const vec3 origin(-halfExtent, 0.f, 2.f * settings.spacing);
+
+  scene.characters.reserve(archetypeCount + settings.count);
+  for (int i = 0; i < settings.count; ++i)
+  {
+    // archetypes are addressed by index, reserve above keeps them in place
+    const Character &archetype = scene.characters[i % archetypeCount];
+    Character &character = scene.characters.emplace_back();
+    character.name = archetype.name + "_" + std::to_string(i);
+
+    const vec3 position = origin + vec3((i % side) * settings.spacing, 0.f, (i / side) * settings.spacing);
+    const float yaw = PITWO * unit(rng);
+    character.transform = glm::rotate(glm::translate(mat4(1.f), position), yaw, vec3(0.f, 1.f, 0.f));
+    character.prevTransform = character.renderTransform = character.transform;
+    character.meshes = archetype.meshes;
+    character.material = archetype.material;
+    character.skeleton = archetype.skeleton;
+    character.animationContext.setup(archetype.animationContext.skeleton);
+    character.ik = archetype.ik;
+
+    // blend spaces read these every step, so every character walks its own direction
+    character.linearVelocity = 3.f * unit(rng);
+    character.velocity = {signedUnit(rng), signedUnit(rng)};
+
+    const float progress = unit(rng);
+    for (const auto &controller : archetype.controllers)
+      if (auto copy = clone_controller(*controller))
+      {
+        copy->set_progress(progress);
+        character.controllers.push_back(std::move(copy));
+      }
+  }
+
+  // camera zoom reaches the far side of the grid
+  ArcballCamera &cam = scene.userCamera.arcballCamera;
+  cam.maxdistance = std::max(cam.maxdistance, 2.f * halfExtent + 5.f);
+  cam.distance = cam.curZoom * cam.maxdistance;
+
+  engine::log("Crowd: %d characters on %dx%d grid, seed %u", settings.count, side, side, settings.seed);
+}
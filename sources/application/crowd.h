@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+
+struct Scene;
+
+// stress scene: copies of the scene characters on a grid, to measure how update and render scale with count
+struct CrowdSettings
+{
+  int count = 0; // 0 keeps the hand-made scene only
+  uint32_t seed = 1;
+  float spacing = 1.5f; // meters between grid cells
+};
+
+static constexpr int MAX_CROWD_SIZE = 100000;
+
+// archetypes are the characters already in the scene, meshes, materials, skeletons and clips are shared with them
+void spawn_crowd(Scene &scene, const CrowdSettings &settings);
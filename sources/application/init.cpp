@@ -7,6 +7,7 @@
 #include "blend_space_1d.h"
 #include "blend_space_2d.h"
 #include "single_animation.h"
+#include "state_machine.h"
 
 
 static glm::mat4 get_projective_matrix()
@@ -17,7 +18,19 @@ static glm::mat4 get_projective_matrix()
   return glm::perspective(fovY, engine::get_aspect_ratio(), zNear, zFar);
 }
 
-void application_init(Scene &scene)
+// feet planting and look-at for rigs with mixamo joint names, other rigs play without IK
+static void setup_character_ik(Character &character)
+{
+  const ozz::animation::Skeleton &skeleton = *character.animationContext.skeleton;
+  const bool legs = add_leg_ik(character.ik, skeleton, "LeftUpLeg", "LeftLeg", "LeftFoot") &&
+    add_leg_ik(character.ik, skeleton, "RightUpLeg", "RightLeg", "RightFoot");
+  const bool lookAt = add_look_at_ik(character.ik, skeleton, {"Head", "Neck", "Spine2", "Spine1"});
+  engine::log("%s IK: legs %s, look-at %s", character.name.c_str(), legs ? "on" : "not found", lookAt ? "available" : "not found");
+}
+
+// stateMachinePath is a description that replaces MotusMan blend space, nullptr keeps the blend space,
+// keepRawAnimations keeps unoptimized clips to compare with optimized ones in the UI
+void application_init(Scene &scene, const char *stateMachinePath, bool keepRawAnimations)
 {
   scene.light.lightDirection = glm::normalize(glm::vec3(-1, -1, 0));
   scene.light.lightColor = glm::vec3(1.f);
@@ -46,22 +59,35 @@ void application_init(Scene &scene)
   engine::onKeyboardEvent += [](const SDL_KeyboardEvent &e) { if (e.keysym.sym == SDLK_F5 && e.state == SDL_RELEASED) recompile_all_shaders(); };
 
 
-  ModelAsset motusManIdle = load_model("resources/Animations/IPC/MOB1_Stand_Relaxed_Idle_IPC.fbx");
+  AnimationImportSettings importSettings;
+  importSettings.keepRawAnimations = keepRawAnimations;
+
+  ModelAsset motusManIdle = load_model("resources/Animations/IPC/MOB1_Stand_Relaxed_Idle_IPC.fbx", importSettings);
 
-  ModelAsset motusManWalkF = load_model("resources/Animations/IPC/MOB1_Walk_F_Loop_IPC.fbx");
-  ModelAsset motusManWalkFL = load_model("resources/Animations/IPC/MOB1_Walk_FL_Loop_IPC.fbx");
-  ModelAsset motusManWalkL = load_model("resources/Animations/IPC/MOB1_Walk_L_Loop_IPC.fbx");
-  ModelAsset motusManWalkBL = load_model("resources/Animations/IPC/MOB1_Walk_BL_BkPd_Loop_IPC.fbx");
-  ModelAsset motusManWalkB = load_model("resources/Animations/IPC/MOB1_Walk_B_Loop_IPC.fbx");
-  ModelAsset motusManWalkBR = load_model("resources/Animations/IPC/MOB1_Walk_BR_BkPd_Loop_IPC.fbx");
-  ModelAsset motusManWalkR = load_model("resources/Animations/IPC/MOB1_Walk_R_Loop_IPC.fbx");
-  ModelAsset motusManWalkFR = load_model("resources/Animations/IPC/MOB1_Walk_FR_Loop_IPC.fbx");
+  // walk clips share MotusMan skeleton, their meshes and skeletons are never used
+  // they move the character by root motion, play in phase by foot contacts and have footstep events, idle stays in place
+  const SkeletonPtr &motusSkeleton = motusManIdle.skeleton.ozzSkeleton;
+  AnimationImportSettings locomotionSettings = importSettings;
+  locomotionSettings.extractRootMotion = true;
+  locomotionSettings.syncMarkerJoints = {"LeftFoot", "RightFoot"};
+  locomotionSettings.contactTracks = true;
+  ModelAsset motusManWalkF = load_animations("resources/Animations/IPC/MOB1_Walk_F_Loop_IPC.fbx", motusSkeleton, locomotionSettings);
+  ModelAsset motusManWalkFL = load_animations("resources/Animations/IPC/MOB1_Walk_FL_Loop_IPC.fbx", motusSkeleton, locomotionSettings);
+  ModelAsset motusManWalkL = load_animations("resources/Animations/IPC/MOB1_Walk_L_Loop_IPC.fbx", motusSkeleton, locomotionSettings);
+  ModelAsset motusManWalkBL = load_animations("resources/Animations/IPC/MOB1_Walk_BL_BkPd_Loop_IPC.fbx", motusSkeleton, locomotionSettings);
+  ModelAsset motusManWalkB = load_animations("resources/Animations/IPC/MOB1_Walk_B_Loop_IPC.fbx", motusSkeleton, locomotionSettings);
+  ModelAsset motusManWalkBR = load_animations("resources/Animations/IPC/MOB1_Walk_BR_BkPd_Loop_IPC.fbx", motusSkeleton, locomotionSettings);
+  ModelAsset motusManWalkR = load_animations("resources/Animations/IPC/MOB1_Walk_R_Loop_IPC.fbx", motusSkeleton, locomotionSettings);
+  ModelAsset motusManWalkFR = load_animations("resources/Animations/IPC/MOB1_Walk_FR_Loop_IPC.fbx", motusSkeleton, locomotionSettings);
 
-  ModelAsset ruby = load_model("resources/sketchfab/ruby.fbx");
+  ModelAsset ruby = load_model("resources/sketchfab/ruby.fbx", importSettings);
 
 
   auto material = make_material("character", "sources/shaders/character_vs.glsl", "sources/shaders/character_ps.glsl");
-  material->set_property("mainTex", create_texture2d("resources/MotusMan_v55/MCG_diff.jpg"));
+  const char *motusTexturePath = "resources/MotusMan_v55/MCG_diff.jpg";
+  Texture2DPtr motusTexture = create_texture2d(motusTexturePath);
+  engine::get_asset_registry().add(motusTexturePath, motusTexture);
+  material->set_property("mainTex", std::move(motusTexture));
 
   {
     AnimationContext motusContext;
@@ -72,22 +98,49 @@ void application_init(Scene &scene)
     motusCharacter.transform = glm::identity<glm::mat4>();
     motusCharacter.meshes = motusManIdle.meshes;
     motusCharacter.material = std::move(material);
-    motusCharacter.skeleton = motusManIdle.skeleton;
+    motusCharacter.skeleton = std::make_shared<SkeletonData>(motusManIdle.skeleton);
     motusCharacter.animationContext = std::move(motusContext);
 
+    auto walk_node = [](const ModelAsset &walk, glm::float2 parameter) {
+      return AnimationNode2D{walk.animations[0], parameter, walk.rootMotions[0], walk.syncTracks[0], walk.tracks[0]};
+    };
     std::vector<AnimationNode2D> nodes = {
       {motusManIdle.animations[0], {0.f, 0.f}},
 
-      {motusManWalkF .animations[0], {1.f, 0.f}},
-      {motusManWalkFL.animations[0], {1.f, 1.f}},
-      {motusManWalkL .animations[0], {0.f, 1.f}},
-      {motusManWalkBL.animations[0], {-1.f, 1.f}},
-      {motusManWalkB .animations[0], {-1.f, 0.f}},
-      {motusManWalkBR.animations[0], {-1.f, -1.f}},
-      {motusManWalkR .animations[0], {0.f, -1.f}},
-      {motusManWalkFR.animations[0], {1.f, -1.f}},
+      walk_node(motusManWalkF, {1.f, 0.f}),
+      walk_node(motusManWalkFL, {1.f, 1.f}),
+      walk_node(motusManWalkL, {0.f, 1.f}),
+      walk_node(motusManWalkBL, {-1.f, 1.f}),
+      walk_node(motusManWalkB, {-1.f, 0.f}),
+      walk_node(motusManWalkBR, {-1.f, -1.f}),
+      walk_node(motusManWalkR, {0.f, -1.f}),
+      walk_node(motusManWalkFR, {1.f, -1.f}),
     };
-    motusCharacter.controllers.push_back(std::make_shared<BlendSpace2D>(nodes));
+
+    // descriptions refer to the same clips by name, see sources/state_machines
+    StateMachineDescPtr stateMachine = nullptr;
+    if (stateMachinePath)
+    {
+      auto walk_clip = [](const ModelAsset &walk) {
+        return StateClip{walk.animations[0], walk.rootMotions[0], walk.syncTracks[0], walk.tracks[0]};
+      };
+      stateMachine = load_state_machine(stateMachinePath, {
+        {"idle", {motusManIdle.animations[0]}},
+        {"walk_f", walk_clip(motusManWalkF)},
+        {"walk_fl", walk_clip(motusManWalkFL)},
+        {"walk_l", walk_clip(motusManWalkL)},
+        {"walk_bl", walk_clip(motusManWalkBL)},
+        {"walk_b", walk_clip(motusManWalkB)},
+        {"walk_br", walk_clip(motusManWalkBR)},
+        {"walk_r", walk_clip(motusManWalkR)},
+        {"walk_fr", walk_clip(motusManWalkFR)},
+      });
+    }
+    if (stateMachine)
+      motusCharacter.controllers.push_back(std::make_shared<StateMachine>(stateMachine));
+    else
+      motusCharacter.controllers.push_back(std::make_shared<BlendSpace2D>(nodes));
+    setup_character_ik(motusCharacter);
   }
 
 
@@ -105,9 +158,10 @@ void application_init(Scene &scene)
     rubyCharacter.transform = glm::translate(glm::identity<glm::mat4>(), glm::vec3(2.f, 0.f, 0.f));
     rubyCharacter.meshes = ruby.meshes;
     rubyCharacter.material = std::move(whiteMaterial);
-    rubyCharacter.skeleton = ruby.skeleton;
+    rubyCharacter.skeleton = std::make_shared<SkeletonData>(ruby.skeleton);
     rubyCharacter.animationContext = std::move(rubyContext);
     rubyCharacter.controllers.push_back(std::make_shared<SingleAnimation>(ruby.animations[0]));
+    setup_character_ik(rubyCharacter);
   }
 
   scene.models.push_back(std::move(ruby));
@@ -123,6 +177,16 @@ void application_init(Scene &scene)
   scene.models.push_back(std::move(motusManWalkR ));
   scene.models.push_back(std::move(motusManWalkFR));
 
+  // clips held by controllers stay resident, the rest may be evicted and loaded again on demand,
+  // reloaded locomotion clips must play in place as well
+  for (ModelAsset &model : scene.models)
+    register_model_assets(model, model.rootMotions.empty() ? importSettings : locomotionSettings);
+
+  for (const ModelAsset &model : scene.models)
+    for (size_t i = 0; i < model.rawAnimations.size(); ++i)
+      scene.rawAnimations[model.animationHandles[i]] = model.rawAnimations[i];
+  engine::get_asset_registry().set_budget(size_t(256) << 20);
+
 
   auto greenMaterial = make_material("grass", "sources/shaders/floor_vs.glsl", "sources/shaders/floor_ps.glsl");
 
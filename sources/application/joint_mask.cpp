@@ -0,0 +1,83 @@
+#include "joint_mask.h"
+#include "engine/api.h"
+#include "ozz/animation/runtime/skeleton.h"
+#include <mutex>
+
+static JointMaskPtr build_joint_mask(const ozz::animation::Skeleton &skeleton, const std::vector<JointMaskSubtree> &subtrees)
+{
+  const int numJoints = skeleton.num_joints();
+  const auto parents = skeleton.joint_parents();
+  const auto names = skeleton.joint_names();
+
+  // joints are ordered parents first, so descendants inherit weights of their ancestors
+  std::vector<float> jointWeights(numJoints, 0.f);
+  for (const JointMaskSubtree &subtree : subtrees)
+  {
+    int root = -1;
+    for (int i = 0; i < numJoints && root < 0; ++i)
+      if (subtree.jointName == names[i])
+        root = i;
+    if (root < 0)
+    {
+      engine::error("Joint mask root \"%s\" not found in skeleton", subtree.jointName.c_str());
+      continue;
+    }
+    std::vector<bool> inSubtree(numJoints, false);
+    for (int i = root; i < numJoints; ++i)
+      if (i == root || (parents[i] >= root && inSubtree[parents[i]]))
+      {
+        inSubtree[i] = true;
+        jointWeights[i] = subtree.weight;
+      }
+  }
+
+  auto mask = std::make_shared<JointMask>();
+  const int numSoaJoints = skeleton.num_soa_joints();
+  mask->weights.resize(numSoaJoints);
+  mask->sampledSoaTracks.assign((numSoaJoints + 7) / 8, 0);
+  for (int soa = 0; soa < numSoaJoints; ++soa)
+  {
+    float lanes[4] = {0.f, 0.f, 0.f, 0.f};
+    for (int lane = 0; lane < 4 && soa * 4 + lane < numJoints; ++lane)
+    {
+      lanes[lane] = jointWeights[soa * 4 + lane];
+      if (lanes[lane] > 0.f)
+      {
+        mask->sampledSoaTracks[soa / 8] |= uint8_t(1 << (soa % 8));
+        mask->sampledJoints++;
+      }
+    }
+    mask->weights[soa] = ozz::math::simd_float4::LoadPtrU(lanes);
+  }
+  return mask;
+}
+
+struct CachedJointMask
+{
+  std::weak_ptr<const ozz::animation::Skeleton> skeleton;
+  std::string description;
+  std::weak_ptr<const JointMask> mask; // weights come from ozz allocator, the cache must not keep them past shutdown
+};
+
+// few masks per skeleton are expected, lookups happen on setup, not per frame
+static std::mutex masksMutex;
+static std::vector<CachedJointMask> masks;
+
+JointMaskPtr get_joint_mask(const SkeletonPtr &skeleton, const std::vector<JointMaskSubtree> &subtrees)
+{
+  std::string description;
+  for (const JointMaskSubtree &subtree : subtrees)
+    description += subtree.jointName + '=' + std::to_string(subtree.weight) + ';';
+
+  std::unique_lock lock(masksMutex);
+  // masks of unloaded skeletons or without users are dropped, pointer of a new skeleton may reuse address of an old one
+  std::erase_if(masks, [](const CachedJointMask &cached) { return cached.skeleton.expired() || cached.mask.expired(); });
+  for (const CachedJointMask &cached : masks)
+    if (cached.skeleton.lock() == skeleton && cached.description == description)
+      if (JointMaskPtr mask = cached.mask.lock())
+        return mask;
+
+  JointMaskPtr mask = build_joint_mask(*skeleton, subtrees);
+  masks.push_back({skeleton, std::move(description), mask});
+  return mask;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "engine/import/model.h"
+#include "ozz/base/containers/vector.h"
+#include "ozz/base/maths/simd_math.h"
+
+// weight of a joint and all of its descendants, later entries override earlier ones
+struct JointMaskSubtree
+{
+  std::string jointName;
+  float weight;
+};
+
+// Per-joint weights of a partial body layer, weights of joints outside of the mask are 0.
+// Layer is blended only on masked joints and samples only soa tracks that have a non-zero weight.
+struct JointMask
+{
+  ozz::vector<ozz::math::SimdFloat4> weights; // 4 joints per element, BlendingJob::Layer::joint_weights layout, 16 byte aligned
+  std::vector<uint8_t> sampledSoaTracks;      // bit per soa track with any non-zero weight, SamplingJob::soa_track_mask
+  int sampledJoints = 0;
+};
+
+using JointMaskPtr = std::shared_ptr<const JointMask>;
+
+// masks are built once per skeleton and description, characters of one model share them
+JointMaskPtr get_joint_mask(const SkeletonPtr &skeleton, const std::vector<JointMaskSubtree> &subtrees);
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "engine/import/content_registry.h"
+#include "ozz/base/maths/simd_math.h"
+
+constexpr uint64_t POSE_HASH_SEED = HASH_BYTES_SEED;
+
+// hash_bytes over exact bits of model space matrices, identical only for bit identical poses.
+// Pass result of the previous call as hash to combine poses of several characters.
+inline uint64_t hash_pose(const std::vector<ozz::math::Float4x4> &transforms, uint64_t hash = POSE_HASH_SEED)
+{
+  for (const ozz::math::Float4x4 &transform : transforms)
+  {
+    float values[16];
+    for (int column = 0; column < 4; ++column)
+      ozz::math::StorePtrU(transform.cols[column], values + column * 4);
+    hash = hash_bytes(values, sizeof(values), hash);
+  }
+  return hash;
+}
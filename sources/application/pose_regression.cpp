@@ -0,0 +1,273 @@
+#include "pose_regression.h"
+#include "scene.h"
+#include "blend_space_1d.h"
+#include "blend_space_2d.h"
+#include "state_machine.h"
+#include "pose_hash.h"
+#include "engine/api.h"
+#include "engine/frame_arena.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// file is a header followed by samples in sweep order, every sample is
+// uint32 name length, name, float linearVelocity, velocity.x, velocity.y, progress,
+// uint64 pose hash, uint32 joint count, joint count of PoseJoint
+static constexpr char POSE_GOLDEN_MAGIC[4] = {'P', 'O', 'S', 'E'};
+static constexpr uint32_t POSE_GOLDEN_VERSION = 1;
+
+struct PoseGoldenHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t sampleCount;
+};
+
+struct PoseJoint
+{
+  vec3 position;
+  quat rotation;
+};
+
+struct PoseSample
+{
+  std::string character;
+  float parameters[4]; // linearVelocity, velocity.x, velocity.y, progress
+  uint64_t hash;
+  std::vector<PoseJoint> joints;
+};
+
+// worst error of a joint over all samples of its character
+struct JointError
+{
+  float position = 0.f;
+  float rotationDegrees = 0.f;
+  size_t positionSample = 0;
+  size_t rotationSample = 0;
+};
+
+static PoseJoint to_pose_joint(const ozz::math::Float4x4 &transform)
+{
+  mat4 matrix;
+  for (int column = 0; column < 4; ++column)
+    ozz::math::StorePtrU(transform.cols[column], glm::value_ptr(matrix[column]));
+  // scale is removed, only orientation is compared
+  const mat3 rotation(normalize(vec3(matrix[0])), normalize(vec3(matrix[1])), normalize(vec3(matrix[2])));
+  return {vec3(matrix[3]), quat_cast(rotation)};
+}
+
+static bool has_blend_space(const Character &character)
+{
+  for (const auto &controller : character.controllers)
+    if (dynamic_cast<const BlendSpace2D *>(controller.get()) || dynamic_cast<const BlendSpace1D *>(controller.get()) ||
+        dynamic_cast<const StateMachine *>(controller.get()))
+      return true;
+  return false;
+}
+
+static std::vector<PoseSample> evaluate_poses(Scene &scene, const PoseRegressionSettings &settings)
+{
+  std::vector<PoseSample> samples;
+  for (Character &character : scene.characters)
+  {
+    const int parameterSteps = has_blend_space(character) ? std::max(settings.parameterSteps, 2) : 1;
+    for (int y = 0; y < parameterSteps; ++y)
+      for (int x = 0; x < parameterSteps; ++x)
+        for (int p = 0; p < settings.progressSteps; ++p)
+        {
+          // blend spaces cover [-1, 1] on both axes, 1D ones [0, 3] of linear velocity
+          const float u = parameterSteps > 1 ? float(x) / (parameterSteps - 1) : 0.f;
+          const float v = parameterSteps > 1 ? float(y) / (parameterSteps - 1) : 0.f;
+          const float progress = float(p) / settings.progressSteps;
+          character.linearVelocity = 3.f * u;
+          character.velocity = {2.f * u - 1.f, 2.f * v - 1.f};
+          // sync leader is picked from blend weights, so parameters go first and the sample doesn't depend on the previous one
+          set_controller_parameters(character);
+          for (auto &controller : character.controllers)
+            controller->set_progress(progress);
+          animate_character(scene, character, 0.f);
+          engine::frame_arena_reset();
+
+          const std::vector<ozz::math::Float4x4> &transforms = character.animationContext.worldTransforms;
+          PoseSample &sample = samples.emplace_back();
+          sample.character = character.name;
+          sample.parameters[0] = character.linearVelocity;
+          sample.parameters[1] = character.velocity.x;
+          sample.parameters[2] = character.velocity.y;
+          sample.parameters[3] = progress;
+          sample.hash = hash_pose(transforms);
+          sample.joints.reserve(transforms.size());
+          for (const ozz::math::Float4x4 &transform : transforms)
+            sample.joints.push_back(to_pose_joint(transform));
+        }
+  }
+  return samples;
+}
+
+static bool write_golden(const char *path, const std::vector<PoseSample> &samples)
+{
+  FILE *file = fopen(path, "wb");
+  if (!file)
+    return false;
+  PoseGoldenHeader header;
+  memcpy(header.magic, POSE_GOLDEN_MAGIC, sizeof(header.magic));
+  header.version = POSE_GOLDEN_VERSION;
+  header.sampleCount = uint32_t(samples.size());
+  fwrite(&header, sizeof(header), 1, file);
+  for (const PoseSample &sample : samples)
+  {
+    const uint32_t nameLength = uint32_t(sample.character.size());
+    const uint32_t jointCount = uint32_t(sample.joints.size());
+    fwrite(&nameLength, sizeof(nameLength), 1, file);
+    fwrite(sample.character.data(), 1, nameLength, file);
+    fwrite(sample.parameters, sizeof(sample.parameters), 1, file);
+    fwrite(&sample.hash, sizeof(sample.hash), 1, file);
+    fwrite(&jointCount, sizeof(jointCount), 1, file);
+    fwrite(sample.joints.data(), sizeof(PoseJoint), jointCount, file);
+  }
+  const bool success = !ferror(file);
+  fclose(file);
+  return success;
+}
+
+static bool read_golden(const char *path, std::vector<PoseSample> &samples)
+{
+  FILE *file = fopen(path, "rb");
+  if (!file)
+    return false;
+  PoseGoldenHeader header;
+  bool success = fread(&header, sizeof(header), 1, file) == 1 &&
+    !memcmp(header.magic, POSE_GOLDEN_MAGIC, sizeof(header.magic)) && header.version == POSE_GOLDEN_VERSION;
+  for (uint32_t i = 0; success && i < header.sampleCount; ++i)
+  {
+    PoseSample &sample = samples.emplace_back();
+    uint32_t nameLength = 0, jointCount = 0;
+    success = fread(&nameLength, sizeof(nameLength), 1, file) == 1;
+    sample.character.resize(success ? nameLength : 0);
+    success = success && fread(sample.character.data(), 1, nameLength, file) == nameLength &&
+      fread(sample.parameters, sizeof(sample.parameters), 1, file) == 1 &&
+      fread(&sample.hash, sizeof(sample.hash), 1, file) == 1 &&
+      fread(&jointCount, sizeof(jointCount), 1, file) == 1;
+    sample.joints.resize(success ? jointCount : 0);
+    success = success && fread(sample.joints.data(), sizeof(PoseJoint), jointCount, file) == jointCount;
+  }
+  fclose(file);
+  return success;
+}
+
+// joints are ordered parents first, so descendants inherit overrides of their ancestors
+static std::vector<PoseJointTolerance> joint_tolerances(const ozz::animation::Skeleton &skeleton, const PoseRegressionSettings &settings)
+{
+  std::vector<PoseJointTolerance> tolerances(skeleton.num_joints());
+  for (int i = 0; i < skeleton.num_joints(); ++i)
+  {
+    const int parent = skeleton.joint_parents()[i];
+    PoseJointTolerance &tolerance = tolerances[i];
+    tolerance = parent >= 0 ? tolerances[parent] : PoseJointTolerance{"", settings.position, settings.rotationDegrees};
+    tolerance.jointName = skeleton.joint_names()[i];
+    for (const PoseJointTolerance &jointTolerance : settings.jointTolerances)
+      if (jointTolerance.jointName == tolerance.jointName)
+      {
+        tolerance.position = jointTolerance.position;
+        tolerance.rotationDegrees = jointTolerance.rotationDegrees;
+      }
+  }
+  return tolerances;
+}
+
+static bool report_character(const Character &character, const std::vector<PoseSample> &samples,
+  const std::vector<JointError> &errors, const PoseRegressionSettings &settings)
+{
+  const std::vector<PoseJointTolerance> tolerances = joint_tolerances(*character.animationContext.skeleton, settings);
+  engine::log("%s: max error per joint", character.name.c_str());
+  bool passed = true;
+  for (size_t i = 0; i < errors.size(); ++i)
+  {
+    const JointError &error = errors[i];
+    const PoseJointTolerance &tolerance = tolerances[i];
+    const bool failed = error.position > tolerance.position || error.rotationDegrees > tolerance.rotationDegrees;
+    passed = passed && !failed;
+    const float *worst = samples[error.position / tolerance.position >= error.rotationDegrees / tolerance.rotationDegrees
+      ? error.positionSample : error.rotationSample].parameters;
+    char line[256];
+    snprintf(line, sizeof(line), "  %-40s pos %.6f m, rot %.4f deg, worst at velocity (%.2f, %.2f, %.2f) progress %.3f",
+      tolerance.jointName.c_str(), error.position, error.rotationDegrees, worst[0], worst[1], worst[2], worst[3]);
+    if (failed)
+      engine::error("%s FAIL", line);
+    else
+      engine::log("%s", line);
+  }
+  return passed;
+}
+
+static int compare_with_golden(Scene &scene, const std::vector<PoseSample> &samples, const PoseRegressionSettings &settings)
+{
+  std::vector<PoseSample> golden;
+  if (!read_golden(settings.goldenPath, golden))
+  {
+    engine::error("Can't read golden poses \"%s\"", settings.goldenPath);
+    return 1;
+  }
+  if (golden.size() != samples.size())
+  {
+    engine::error("Golden poses have %zu samples, sweep has %zu, write golden poses again", golden.size(), samples.size());
+    return 1;
+  }
+
+  bool passed = true;
+  size_t exactSamples = 0;
+  size_t sample = 0;
+  for (const Character &character : scene.characters)
+  {
+    JointError noError;
+    noError.positionSample = noError.rotationSample = sample;
+    std::vector<JointError> errors(character.animationContext.worldTransforms.size(), noError);
+    for (; sample < samples.size() && samples[sample].character == character.name; ++sample)
+    {
+      const PoseSample &current = samples[sample];
+      const PoseSample &expected = golden[sample];
+      if (expected.character != current.character || expected.joints.size() != current.joints.size() ||
+        memcmp(expected.parameters, current.parameters, sizeof(current.parameters)))
+      {
+        engine::error("Golden sample %zu is for %s with %zu joints, sweep has %s with %zu joints, write golden poses again",
+          sample, expected.character.c_str(), expected.joints.size(), current.character.c_str(), current.joints.size());
+        return 1;
+      }
+      if (expected.hash == current.hash)
+      {
+        exactSamples++;
+        continue;
+      }
+      for (size_t i = 0; i < errors.size(); ++i)
+      {
+        const float position = distance(expected.joints[i].position, current.joints[i].position);
+        const float cosHalfAngle = std::min(1.f, std::abs(dot(expected.joints[i].rotation, current.joints[i].rotation)));
+        const float rotationDegrees = 2.f * acosf(cosHalfAngle) * RadToDeg;
+        JointError &error = errors[i];
+        if (position > error.position)
+          error.position = position, error.positionSample = sample;
+        if (rotationDegrees > error.rotationDegrees)
+          error.rotationDegrees = rotationDegrees, error.rotationSample = sample;
+      }
+    }
+    passed = report_character(character, samples, errors, settings) && passed;
+  }
+
+  engine::log("Pose regression: %zu samples, %zu bit exact, %s", samples.size(), exactSamples, passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
+
+int run_pose_regression(Scene &scene, const PoseRegressionSettings &settings)
+{
+  const std::vector<PoseSample> samples = evaluate_poses(scene, settings);
+  if (!settings.writeGolden)
+    return compare_with_golden(scene, samples, settings);
+
+  if (!write_golden(settings.goldenPath, samples))
+  {
+    engine::error("Can't write golden poses \"%s\"", settings.goldenPath);
+    return 1;
+  }
+  engine::log("%zu golden poses written to \"%s\"", samples.size(), settings.goldenPath);
+  return 0;
+}
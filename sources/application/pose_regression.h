@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include <vector>
+
+struct Scene;
+
+// overrides default tolerances for a joint and all of its descendants
+struct PoseJointTolerance
+{
+  std::string jointName;
+  float position;        // meters
+  float rotationDegrees;
+};
+
+// Headless check that runtime changes keep poses: every scene character is evaluated at a sweep of
+// progress values and blend parameters, model space joints are compared with a golden file.
+struct PoseRegressionSettings
+{
+  const char *goldenPath = nullptr;
+  bool writeGolden = false; // stores current poses instead of comparing
+  float position = 1e-3f;
+  float rotationDegrees = 0.5f;
+  std::vector<PoseJointTolerance> jointTolerances;
+  int progressSteps = 16;
+  int parameterSteps = 5; // per blend space axis, characters without blend spaces use one sample
+};
+
+// returns process exit code, 0 when all joints are within tolerances or golden file is written
+int run_pose_regression(Scene &scene, const PoseRegressionSettings &settings);
@@ -5,90 +5,159 @@
 #include "render/material.h"
 #include "render/mesh.h"
 #include "scene.h"
+#include "render_snapshot.h"
+#include "skinning_palette.h"
+#include "engine/gpu_profiler.h"
+#include "ozz/animation/runtime/local_to_model_job.h"
+#include "ozz/base/maths/soa_transform.h"
+#include <cassert>
 #include <string>
 
-void render_character(const Character &character, const mat4 &cameraProjView, vec3 cameraPosition, const DirectionLight &light)
+static mat4 interpolate_transform(const mat4 &from, const mat4 &to, float alpha)
 {
-  const Material &material = *character.material;
-  const Shader &shader = material.get_shader();
+  if (from == to)
+    return to;
+  const vec3 scaleFrom(length(vec3(from[0])), length(vec3(from[1])), length(vec3(from[2])));
+  const vec3 scaleTo(length(vec3(to[0])), length(vec3(to[1])), length(vec3(to[2])));
+  const quat rotationFrom = quat_cast(mat3(vec3(from[0]) / scaleFrom.x, vec3(from[1]) / scaleFrom.y, vec3(from[2]) / scaleFrom.z));
+  const quat rotationTo = quat_cast(mat3(vec3(to[0]) / scaleTo.x, vec3(to[1]) / scaleTo.y, vec3(to[2]) / scaleTo.z));
+
+  return glm::translate(mat4(1.f), mix(vec3(from[3]), vec3(to[3]), alpha)) *
+    mat4_cast(slerp(rotationFrom, rotationTo, alpha)) *
+    glm::scale(mat4(1.f), mix(scaleFrom, scaleTo, alpha));
+}
 
-  shader.use();
-  material.bind_uniforms_to_shader();
-  shader.set_mat4x4("ViewProjection", cameraProjView);
-  shader.set_vec3("CameraPosition", cameraPosition);
-  shader.set_vec3("LightDirection", glm::normalize(light.lightDirection));
-  shader.set_vec3("AmbientLight", light.ambient);
-  shader.set_vec3("SunLight", light.lightColor);
+// fixed step simulation is up to one step ahead of rendered time, blends two last simulated poses
+static void interpolate_character(Character &character, float alpha)
+{
+  PROFILE_ZONE("interpolate_pose");
+  AnimationContext &animationContext = character.animationContext;
+  character.renderTransform = interpolate_transform(character.prevTransform, character.transform, alpha);
+  if (alpha >= 1.f)
+  {
+    animationContext.renderTransforms.assign(animationContext.worldTransforms.begin(), animationContext.worldTransforms.end());
+    return;
+  }
 
+  const ozz::math::SimdFloat4 factor = ozz::math::simd_float4::Load1(alpha);
+  for (size_t i = 0; i < animationContext.localTransforms.size(); ++i)
+  {
+    const ozz::math::SoaTransform &from = animationContext.prevLocalTransforms[i];
+    const ozz::math::SoaTransform &to = animationContext.localTransforms[i];
+    // rotations from opposite hemispheres would interpolate the long way around
+    const ozz::math::SimdInt4 sign = ozz::math::Sign(ozz::math::Dot(from.rotation, to.rotation));
+    const ozz::math::SoaQuaternion rotation = {
+      ozz::math::Xor(to.rotation.x, sign), ozz::math::Xor(to.rotation.y, sign),
+      ozz::math::Xor(to.rotation.z, sign), ozz::math::Xor(to.rotation.w, sign)};
+
+    ozz::math::SoaTransform &out = animationContext.renderLocalTransforms[i];
+    out.translation = ozz::math::Lerp(from.translation, to.translation, factor);
+    out.rotation = ozz::math::NLerp(from.rotation, rotation, factor);
+    out.scale = ozz::math::Lerp(from.scale, to.scale, factor);
+  }
 
+  ozz::animation::LocalToModelJob localToModelJob;
+  localToModelJob.skeleton = animationContext.skeleton.get();
+  localToModelJob.input = ozz::make_span(animationContext.renderLocalTransforms);
+  localToModelJob.output = ozz::make_span(animationContext.renderTransforms);
+
+  assert(localToModelJob.Validate());
+  const bool success = localToModelJob.Run();
+  assert(success);
+}
+
+static void build_skinned_draws(const Character &character, RenderSnapshot &snapshot)
+{
+  PROFILE_ZONE("skinning_palette");
   std::span<const mat4x4> bindPose = {
-    (const glm::mat4x4 *)character.animationContext.worldTransforms.data(),
-    character.animationContext.worldTransforms.size()
+    (const glm::mat4x4 *)character.animationContext.renderTransforms.data(),
+    character.animationContext.renderTransforms.size()
   };
-  std::vector<mat4> skinningMatrices;
 
   for (const MeshPtr &mesh : character.meshes)
   {
-    skinningMatrices.resize(mesh->inversedBindPose.size());
+    RenderSnapshot::Draw &draw = snapshot.skinnedDraws.emplace_back();
+    draw.material = character.material;
+    draw.mesh = mesh;
+    draw.paletteOffset = snapshot.palettes.size();
+    draw.paletteSize = mesh->inversedBindPose.size();
+    snapshot.palettes.resize(draw.paletteOffset + draw.paletteSize);
+    build_skinning_palette(*mesh, *character.skeleton, bindPose, character.renderTransform, snapshot.palettes.data() + draw.paletteOffset);
+  }
+}
 
-    for(size_t i = 0; i < mesh->inversedBindPose.size(); ++i)
-    {
-      const std::string &name = mesh->boneNames[i];
-      auto it = character.skeleton.nodesMap.find(name);
-      if (it == character.skeleton.nodesMap.end())
-      {
-        engine::error("Bone \"%s\" from mesh \"%s\" not found in skeleton", name.c_str(), mesh->name.c_str());
-        skinningMatrices[i] = mat4(1.f);
-      }
-      else
-      {
-        skinningMatrices[i] = bindPose[it->second] * mesh->inversedBindPose[i];
-      }
-    }
+void application_prepare_render(Scene &scene, RenderSnapshot &snapshot)
+{
+  PROFILE_ZONE("application_prepare_render");
+  snapshot.clear();
 
-    for(auto &matrix : skinningMatrices)
-    {
-      matrix = character.transform * matrix;
-    }
-    shader.set_mat4x4("SkinningMatrices", skinningMatrices.data(), skinningMatrices.size());
-    render(mesh);
+  const mat4 &projection = scene.userCamera.projection;
+  const glm::mat4 &transform = scene.userCamera.transform;
+  snapshot.projView = projection * inverse(transform);
+  snapshot.cameraPosition = glm::vec3(transform[3]);
+  snapshot.light = scene.light;
+  // events go with the frame, so they fire on the main thread when it's handed over
+  snapshot.animationEvents.swap(scene.pendingAnimationEvents);
+
+  const float alpha = engine::get_interpolation_alpha();
+  for (Character &character : scene.characters)
+  {
+    interpolate_character(character, alpha);
+    build_skinned_draws(character, snapshot);
   }
+
+  for (const StaticModelAsset &model : scene.staticModels)
+    for (const MeshPtr &mesh : model.meshes)
+      snapshot.staticDraws.push_back({model.material, mesh});
 }
 
-void render_static_model(const StaticModelAsset &model, const mat4 &cameraProjView, vec3 cameraPosition, const DirectionLight &light)
+static void bind_material(const Material &material, const RenderSnapshot &snapshot)
 {
-  const Material &material = *model.material;
   const Shader &shader = material.get_shader();
 
   shader.use();
   material.bind_uniforms_to_shader();
-  shader.set_mat4x4("ViewProjection", cameraProjView);
-  shader.set_vec3("CameraPosition", cameraPosition);
-  shader.set_vec3("LightDirection", glm::normalize(light.lightDirection));
-  shader.set_vec3("AmbientLight", light.ambient);
-  shader.set_vec3("SunLight", light.lightColor);
-
+  shader.set_mat4x4("ViewProjection", snapshot.projView);
+  shader.set_vec3("CameraPosition", snapshot.cameraPosition);
+  shader.set_vec3("LightDirection", glm::normalize(snapshot.light.lightDirection));
+  shader.set_vec3("AmbientLight", snapshot.light.ambient);
+  shader.set_vec3("SunLight", snapshot.light.lightColor);
+}
 
-  for (const MeshPtr &mesh : model.meshes)
-    render(mesh);
+static void render_draws(const std::vector<RenderSnapshot::Draw> &draws, const RenderSnapshot &snapshot)
+{
+  // draws of one character share material, it is bound once
+  const Material *boundMaterial = nullptr;
+  for (const RenderSnapshot::Draw &draw : draws)
+  {
+    if (draw.material.get() != boundMaterial)
+    {
+      boundMaterial = draw.material.get();
+      bind_material(*boundMaterial, snapshot);
+    }
+    if (draw.paletteSize > 0)
+      boundMaterial->get_shader().set_mat4x4("SkinningMatrices", snapshot.palettes.data() + draw.paletteOffset, draw.paletteSize);
+    render(draw.mesh);
+  }
 }
 
-void application_render(Scene &scene)
+void application_render(const RenderSnapshot &snapshot)
 {
+  PROFILE_ZONE("application_render");
   glEnable(GL_DEPTH_TEST);
   glDisable(GL_BLEND);
   const float grayColor = 0.3f;
   glClearColor(grayColor, grayColor, grayColor, 1.f);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-
-  const mat4 &projection = scene.userCamera.projection;
-  const glm::mat4 &transform = scene.userCamera.transform;
-  mat4 projView = projection * inverse(transform);
-
-  for (const Character &character : scene.characters)
-    render_character(character, projView, glm::vec3(transform[3]), scene.light);
-
-  for (const StaticModelAsset &model : scene.staticModels)
-    render_static_model(model, projView, glm::vec3(transform[3]), scene.light);
+  {
+    PROFILE_ZONE("render_characters");
+    GPU_PROFILE_ZONE("characters");
+    render_draws(snapshot.skinnedDraws, snapshot);
+  }
+  {
+    PROFILE_ZONE("render_static_models");
+    GPU_PROFILE_ZONE("static_models");
+    render_draws(snapshot.staticDraws, snapshot);
+  }
 }
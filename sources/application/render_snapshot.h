@@ -0,0 +1,37 @@
+#pragma once
+#include "engine/3dmath.h"
+#include "engine/render/direction_light.h"
+#include "engine/render/material.h"
+#include "engine/render/mesh.h"
+#include "animation_events.h"
+#include <vector>
+
+// Everything rendering needs for one frame. Simulation fills it and never touches it after handing it over.
+// Draws hold strong references, so assets simulation drops meanwhile stay valid for the frame being drawn.
+struct RenderSnapshot
+{
+  struct Draw
+  {
+    MaterialPtr material;
+    MeshPtr mesh;
+    uint32_t paletteOffset = 0; // first skinning matrix in palettes
+    uint32_t paletteSize = 0;   // 0 for static meshes
+  };
+
+  mat4 projView = mat4(1.f);
+  vec3 cameraPosition = vec3(0.f);
+  DirectionLight light;
+  std::vector<Draw> skinnedDraws;
+  std::vector<Draw> staticDraws;
+  std::vector<mat4> palettes; // skinning matrices of all skinned draws, character transform included
+  std::vector<AnimationEvent> animationEvents; // crossed by the simulation steps of the frame, fired on the main thread
+
+  // snapshots are reused every frame, capacity is kept
+  void clear()
+  {
+    skinnedDraws.clear();
+    staticDraws.clear();
+    palettes.clear();
+    animationEvents.clear();
+  }
+};
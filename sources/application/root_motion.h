@@ -0,0 +1,28 @@
+#pragma once
+#include <cassert>
+#include "engine/3dmath.h"
+#include "engine/import/model.h"
+#include "animation_controller.h"
+#include "ozz/animation/runtime/track_sampling_job.h"
+
+// displacement stored in the root motion track at normalized time
+inline vec3 sample_root_motion(const ozz::animation::Float3Track &track, float ratio)
+{
+  ozz::math::Float3 value;
+  ozz::animation::Float3TrackSamplingJob samplingJob;
+  samplingJob.track = &track;
+  samplingJob.ratio = ratio;
+  samplingJob.result = &value;
+  const bool success = samplingJob.Run();
+  assert(success);
+  return vec3(value.x, value.y, value.z);
+}
+
+// character space displacement between two progress values of a looping clip,
+// on a wrap (see progress_wrapped) track starts at zero so the tail and the head just add up
+inline vec3 root_motion_delta(const ozz::animation::Float3Track &track, float from, float to)
+{
+  if (!progress_wrapped(from, to))
+    return sample_root_motion(track, to) - sample_root_motion(track, from);
+  return sample_root_motion(track, 1.f) - sample_root_motion(track, from) + sample_root_motion(track, to);
+}
@@ -1,19 +1,39 @@
 #pragma once
 
+#include "engine/event.h"
 #include "engine/render/direction_light.h"
 #include "engine/import/model.h"
 #include "user_camera.h"
 #include "character.h"
+#include <functional>
+#include <unordered_map>
 
 struct Scene
 {
   std::vector<ModelAsset> models;
+  // optimized clip -> clip built from all source keys, to compare playback
+  // by handle of the optimized clip, its address changes when it's evicted and loaded again
+  std::unordered_map<AnimationHandle, AnimationPtr> rawAnimations;
+  bool useRawAnimations = false;
   DirectionLight light;
 
   UserCamera userCamera;
 
   std::vector<Character> characters;
   std::vector<StaticModelAsset> staticModels;
+  // height of the ground under world x, z, leg IK plants feet on it
+  std::function<float(float x, float z)> groundHeight = [](float, float) { return 0.f; };
+  // events of all characters crossed during a frame, dispatched on the main thread once the frame is handed to render
+  Event<AnimationEventBatch> onAnimationEvents;
+  // events of the simulation steps since the last application_prepare_render
+  std::vector<AnimationEvent> pendingAnimationEvents;
 
   // ThirdPersonController controller;
-};
\ No newline at end of file
+};
+
+// blend parameters of the controllers from character velocities, animate_character sets them before update
+void set_controller_parameters(Character &character);
+// controllers, sampling, blending and local to model of one character, dt advances controllers
+void animate_character(const Scene &scene, Character &character, float dt);
+// fires onAnimationEvents on the main thread, handlers may change the scene
+void dispatch_animation_events(Scene &scene, std::span<const AnimationEvent> events);
\ No newline at end of file
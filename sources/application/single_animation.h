@@ -7,21 +7,34 @@
 struct SingleAnimation final : IAnimationController
 {
   const AnimationPtr animation;
+  const JointMaskPtr mask; // upper body actions layered on locomotion use a mask
+  const RootMotionPtr rootMotion;
+  const AnimationTracksPtr tracks;
   float progress = 0.f;
+  float previousProgress = 0.f;
 
-  SingleAnimation(const AnimationPtr &_animation) : animation{_animation} {}
+  SingleAnimation(const AnimationPtr &_animation, const JointMaskPtr &_mask = nullptr, const RootMotionPtr &_rootMotion = nullptr,
+    const AnimationTracksPtr &_tracks = nullptr)
+    : animation{_animation}, mask{_mask}, rootMotion{_rootMotion}, tracks{_tracks} {}
 
   void update(float dt) override
   {
     float duration = animation->duration();
 
+    previousProgress = progress;
     progress += dt / duration;
     if (progress > 1.f)
       progress -= 1.f;
   }
 
-  void collect_animations(std::vector<WeightedAnimation> &out) override
+  void set_progress(float _progress) override
   {
-    out.push_back({animation, 1.f, progress});
+    progress = previousProgress = _progress;
+  }
+
+  void collect_animations(FrameVector<WeightedAnimation> &out) override
+  {
+    out.push_back({.animation = animation, .weight = 1.f, .progress = progress, .mask = mask,
+      .rootMotion = rootMotion, .previousProgress = previousProgress, .tracks = tracks});
   }
 };
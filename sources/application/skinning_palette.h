@@ -0,0 +1,28 @@
+#pragma once
+#include "engine/api.h"
+#include "engine/import/model.h"
+#include <span>
+
+// skinning matrices of mesh bones from model space pose, out has mesh.inversedBindPose.size() entries
+inline void build_skinning_palette(
+  const Mesh &mesh,
+  const SkeletonData &skeleton,
+  std::span<const mat4x4> modelPose,
+  const mat4 &transform,
+  mat4 *out)
+{
+  for (size_t i = 0; i < mesh.inversedBindPose.size(); ++i)
+  {
+    const std::string &name = mesh.boneNames[i];
+    auto it = skeleton.nodesMap.find(name);
+    if (it == skeleton.nodesMap.end())
+    {
+      engine::error(LogCategory::Render, "Bone \"%s\" from mesh \"%s\" not found in skeleton", name.c_str(), mesh.name.c_str());
+      out[i] = transform;
+    }
+    else
+    {
+      out[i] = transform * modelPose[it->second] * mesh.inversedBindPose[i];
+    }
+  }
+}
@@ -0,0 +1,527 @@
+#include "state_machine.h"
+#include "engine/api.h"
+#include "json/json.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+// binary file is a header followed by arrays in header order: states, transitions, clip parameters,
+// triangles as uint32 triples, parameter defaults, then state, clip and parameter names as uint32 length and chars.
+// Every field is written on its own with a fixed width, so files don't depend on struct layout and padding.
+static constexpr char STATE_MACHINE_MAGIC[4] = {'A', 'S', 'M', 'B'};
+static constexpr uint32_t STATE_MACHINE_VERSION = 2;
+
+struct StateMachineHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t stateCount;
+  uint32_t transitionCount;
+  uint32_t clipCount;
+  uint32_t triangleCount;
+  uint32_t parameterCount;
+  int32_t entry;
+};
+
+// bytes of every record in the file, counts of a header are checked against the file size before allocating
+static constexpr uint64_t HEADER_BYTES = 4 + 6 * sizeof(uint32_t) + sizeof(int32_t);
+static constexpr uint64_t STATE_BYTES = 2 * sizeof(uint8_t) + 4 * sizeof(int32_t) + 6 * sizeof(uint32_t) + sizeof(float);
+static constexpr uint64_t TRANSITION_BYTES = 2 * sizeof(int32_t) + sizeof(uint8_t) + 3 * sizeof(float);
+static constexpr uint64_t CLIP_BYTES = 2 * sizeof(float) + sizeof(uint32_t);      // parameter and name length
+static constexpr uint64_t TRIANGLE_BYTES = 3 * sizeof(uint32_t);
+static constexpr uint64_t PARAMETER_BYTES = sizeof(float) + sizeof(uint32_t);     // default and name length
+static constexpr uint64_t STATE_NAME_BYTES = sizeof(uint32_t);
+
+static int find_name(const std::vector<std::string> &names, const std::string &name)
+{
+  auto it = std::find(names.begin(), names.end(), name);
+  return it != names.end() ? int(it - names.begin()) : -1;
+}
+
+static std::string json_name(const Json::Value &value)
+{
+  return value.isString() ? value.asString() : std::string();
+}
+
+static bool json_parameter(const char *path, const StateMachineDesc &desc, const Json::Value &value, int &parameter)
+{
+  parameter = find_name(desc.parameterNames, json_name(value));
+  if (parameter < 0)
+    engine::error(LogCategory::Animation, "State machine \"%s\": unknown parameter \"%s\"", path, json_name(value).c_str());
+  return parameter >= 0;
+}
+
+static bool json_float(const Json::Value &value, float defaultValue, float &result)
+{
+  if (value.isNull())
+    result = defaultValue;
+  else if (value.isNumeric())
+    result = value.asFloat();
+  else
+    return false;
+  return true;
+}
+
+static bool parse_json_clips(const char *path, StateMachineDesc &desc, StateDesc &state, const Json::Value &blend)
+{
+  const bool is2D = state.kind == StateKind::Blend2D;
+  if (!json_parameter(path, desc, blend["x"], state.parameterX) || (is2D && !json_parameter(path, desc, blend["y"], state.parameterY)))
+    return false;
+
+  const Json::Value &clips = blend["clips"];
+  if (!clips.isArray() || clips.size() < (is2D ? 3u : 1u))
+  {
+    engine::error(LogCategory::Animation, "State machine \"%s\": blend space needs %s clips", path, is2D ? "3 or more" : "1 or more");
+    return false;
+  }
+  for (const Json::Value &clip : clips)
+  {
+    const Json::Value &at = clip.isObject() ? clip["at"] : Json::Value::null;
+    const bool validAt = is2D ? at.isArray() && at.size() == 2 && at[0].isNumeric() && at[1].isNumeric() : at.isNumeric();
+    if (!validAt || !clip["clip"].isString())
+    {
+      engine::error(LogCategory::Animation, "State machine \"%s\": blend space clip needs \"clip\" name and \"at\" position", path);
+      return false;
+    }
+    desc.clipNames.push_back(clip["clip"].asString());
+    desc.clipParameters.push_back(is2D ? glm::float2(at[0].asFloat(), at[1].asFloat()) : glm::float2(at.asFloat(), 0.f));
+  }
+  state.clipCount = clips.size();
+
+  if (is2D)
+  {
+    const std::span<const glm::float2> points(desc.clipParameters.data() + state.firstClip, state.clipCount);
+    const std::vector<AnimationTriangle> triangles = triangulate_blend_space(points);
+    state.firstTriangle = desc.triangles.size();
+    state.triangleCount = triangles.size();
+    desc.triangles.insert(desc.triangles.end(), triangles.begin(), triangles.end());
+  }
+  else
+  {
+    // blend_space_1d_weights expects ascending positions
+    std::vector<std::pair<float, std::string>> sorted;
+    for (uint32_t i = state.firstClip; i < state.firstClip + state.clipCount; ++i)
+      sorted.push_back({desc.clipParameters[i].x, std::move(desc.clipNames[i])});
+    std::stable_sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+    for (uint32_t i = 0; i < state.clipCount; ++i)
+    {
+      desc.clipParameters[state.firstClip + i] = {sorted[i].first, 0.f};
+      desc.clipNames[state.firstClip + i] = std::move(sorted[i].second);
+    }
+  }
+  return true;
+}
+
+static bool parse_json_transition(const char *path, StateMachineDesc &desc, const Json::Value &value)
+{
+  StateTransition &transition = desc.transitions.emplace_back();
+  const std::string target = value.isObject() ? json_name(value["to"]) : std::string();
+  transition.target = find_name(desc.stateNames, target);
+  if (transition.target < 0)
+  {
+    engine::error(LogCategory::Animation, "State machine \"%s\": transition to unknown state \"%s\"", path, target.c_str());
+    return false;
+  }
+  if (value.isMember("parameter"))
+  {
+    if (!json_parameter(path, desc, value["parameter"], transition.parameter))
+      return false;
+    const bool greater = value["greater"].isNumeric();
+    const Json::Value &threshold = greater ? value["greater"] : value["less"];
+    if (!threshold.isNumeric())
+    {
+      engine::error(LogCategory::Animation, "State machine \"%s\": transition on parameter needs \"greater\" or \"less\" threshold", path);
+      return false;
+    }
+    transition.condition = greater ? TransitionCondition::Greater : TransitionCondition::Less;
+    transition.threshold = threshold.asFloat();
+  }
+  if (!json_float(value["duration"], transition.duration, transition.duration) ||
+      !json_float(value["exit_time"], transition.exitTime, transition.exitTime))
+  {
+    engine::error(LogCategory::Animation, "State machine \"%s\": transition \"duration\" and \"exit_time\" are numbers", path);
+    return false;
+  }
+  return true;
+}
+
+// {"parameters": {name: default}, "entry": state, "states": [{"name", "parent", and one of
+//   "default": child state, "clip": name, "blend_1d" or "blend_2d": {"x", "y", "clips": [{"clip", "at"}]},
+//   "loop", "speed", "transitions": [{"to", "parameter", "greater" or "less", "duration", "exit_time"}]}]}
+static bool parse_json(const char *path, StateMachineDesc &desc)
+{
+  std::ifstream file(path);
+  Json::CharReaderBuilder builder;
+  Json::Value root;
+  std::string errors;
+  if (!file || !Json::parseFromStream(builder, file, &root, &errors) || !root.isObject())
+  {
+    engine::error(LogCategory::Animation, "Can't read state machine \"%s\" %s", path, errors.c_str());
+    return false;
+  }
+
+  const Json::Value &parameters = root["parameters"];
+  if (parameters.isObject())
+    for (const std::string &name : parameters.getMemberNames())
+    {
+      desc.parameterNames.push_back(name);
+      desc.parameterDefaults.push_back(parameters[name].isNumeric() ? parameters[name].asFloat() : 0.f);
+    }
+
+  const Json::Value &states = root["states"];
+  if (!states.isArray() || states.empty())
+  {
+    engine::error(LogCategory::Animation, "State machine \"%s\" has no states", path);
+    return false;
+  }
+  // names go first, transitions and default children may refer to states below them
+  for (const Json::Value &state : states)
+  {
+    const std::string name = state.isObject() ? json_name(state["name"]) : std::string();
+    if (name.empty() || find_name(desc.stateNames, name) >= 0)
+    {
+      engine::error(LogCategory::Animation, "State machine \"%s\": state name \"%s\" is empty or repeated", path, name.c_str());
+      return false;
+    }
+    desc.stateNames.push_back(name);
+  }
+
+  for (const Json::Value &value : states)
+  {
+    const int index = desc.states.size();
+    StateDesc &state = desc.states.emplace_back();
+    const char *name = desc.stateNames[index].c_str();
+    if (value.isMember("parent"))
+    {
+      state.parent = find_name(desc.stateNames, json_name(value["parent"]));
+      if (state.parent < 0 || state.parent >= index)
+      {
+        engine::error(LogCategory::Animation, "State machine \"%s\": parent of \"%s\" is unknown or goes after it", path, name);
+        return false;
+      }
+    }
+
+    state.firstClip = desc.clipNames.size();
+    if (value["clip"].isString())
+    {
+      state.kind = StateKind::Clip;
+      state.clipCount = 1;
+      desc.clipNames.push_back(value["clip"].asString());
+      desc.clipParameters.push_back({0.f, 0.f});
+    }
+    else if (value["blend_1d"].isObject() || value["blend_2d"].isObject())
+    {
+      state.kind = value["blend_2d"].isObject() ? StateKind::Blend2D : StateKind::Blend1D;
+      if (!parse_json_clips(path, desc, state, value[state.kind == StateKind::Blend2D ? "blend_2d" : "blend_1d"]))
+        return false;
+    }
+    else if (value["default"].isString())
+    {
+      state.kind = StateKind::Group;
+      state.defaultChild = find_name(desc.stateNames, json_name(value["default"]));
+    }
+    else
+    {
+      engine::error(LogCategory::Animation, "State machine \"%s\": state \"%s\" needs \"clip\", \"blend_1d\", \"blend_2d\" or \"default\"", path, name);
+      return false;
+    }
+
+    state.loop = value.get("loop", true).isBool() ? value["loop"].asBool() : true;
+    if (!json_float(value["speed"], 1.f, state.speed))
+    {
+      engine::error(LogCategory::Animation, "State machine \"%s\": speed of \"%s\" is not a number", path, name);
+      return false;
+    }
+
+    state.firstTransition = desc.transitions.size();
+    for (const Json::Value &transition : value["transitions"])
+      if (!parse_json_transition(path, desc, transition))
+        return false;
+    state.transitionCount = desc.transitions.size() - state.firstTransition;
+  }
+
+  desc.entry = root.isMember("entry") ? find_name(desc.stateNames, json_name(root["entry"])) : 0;
+  if (desc.entry < 0)
+  {
+    engine::error(LogCategory::Animation, "State machine \"%s\": unknown entry state", path);
+    return false;
+  }
+  return true;
+}
+
+template<typename T>
+static void write_value(FILE *file, T value)
+{
+  fwrite(&value, sizeof(T), 1, file);
+}
+
+template<typename T>
+static bool read_value(FILE *file, T &value)
+{
+  return fread(&value, sizeof(T), 1, file) == 1;
+}
+
+static void write_state(FILE *file, const StateDesc &state)
+{
+  write_value<uint8_t>(file, uint8_t(state.kind));
+  write_value<uint8_t>(file, state.loop);
+  write_value<int32_t>(file, state.parent);
+  write_value<int32_t>(file, state.defaultChild);
+  write_value<uint32_t>(file, state.firstClip);
+  write_value<uint32_t>(file, state.clipCount);
+  write_value<uint32_t>(file, state.firstTriangle);
+  write_value<uint32_t>(file, state.triangleCount);
+  write_value<int32_t>(file, state.parameterX);
+  write_value<int32_t>(file, state.parameterY);
+  write_value<float>(file, state.speed);
+  write_value<uint32_t>(file, state.firstTransition);
+  write_value<uint32_t>(file, state.transitionCount);
+}
+
+static bool read_state(FILE *file, StateDesc &state)
+{
+  uint8_t kind = 0, loop = 0;
+  int32_t parent = 0, defaultChild = 0, parameterX = 0, parameterY = 0;
+  const bool success = read_value(file, kind) && read_value(file, loop) && read_value(file, parent) && read_value(file, defaultChild) &&
+    read_value(file, state.firstClip) && read_value(file, state.clipCount) &&
+    read_value(file, state.firstTriangle) && read_value(file, state.triangleCount) &&
+    read_value(file, parameterX) && read_value(file, parameterY) && read_value(file, state.speed) &&
+    read_value(file, state.firstTransition) && read_value(file, state.transitionCount);
+  state.kind = StateKind(kind);
+  state.loop = loop != 0;
+  state.parent = parent;
+  state.defaultChild = defaultChild;
+  state.parameterX = parameterX;
+  state.parameterY = parameterY;
+  return success;
+}
+
+static void write_transition(FILE *file, const StateTransition &transition)
+{
+  write_value<int32_t>(file, transition.target);
+  write_value<uint8_t>(file, uint8_t(transition.condition));
+  write_value<int32_t>(file, transition.parameter);
+  write_value<float>(file, transition.threshold);
+  write_value<float>(file, transition.duration);
+  write_value<float>(file, transition.exitTime);
+}
+
+static bool read_transition(FILE *file, StateTransition &transition)
+{
+  int32_t target = 0, parameter = 0;
+  uint8_t condition = 0;
+  const bool success = read_value(file, target) && read_value(file, condition) && read_value(file, parameter) &&
+    read_value(file, transition.threshold) && read_value(file, transition.duration) && read_value(file, transition.exitTime);
+  transition.target = target;
+  transition.condition = TransitionCondition(condition);
+  transition.parameter = parameter;
+  return success;
+}
+
+static bool write_names(FILE *file, const std::vector<std::string> &names)
+{
+  for (const std::string &name : names)
+  {
+    const uint32_t length = uint32_t(name.size());
+    fwrite(&length, sizeof(length), 1, file);
+    fwrite(name.data(), 1, length, file);
+  }
+  return !ferror(file);
+}
+
+// name lengths are checked against the rest of the file before allocating
+static bool read_names(FILE *file, uint64_t fileSize, std::vector<std::string> &names, uint32_t count)
+{
+  bool success = true;
+  names.resize(count);
+  for (std::string &name : names)
+  {
+    uint32_t length = 0;
+    success = success && read_value(file, length) && length <= fileSize - uint64_t(ftell(file));
+    name.resize(success ? length : 0);
+    success = success && fread(name.data(), 1, length, file) == length;
+  }
+  return success;
+}
+
+bool save_state_machine(const char *path, const StateMachineDesc &desc)
+{
+  FILE *file = fopen(path, "wb");
+  if (!file)
+    return false;
+  fwrite(STATE_MACHINE_MAGIC, 1, sizeof(STATE_MACHINE_MAGIC), file);
+  write_value<uint32_t>(file, STATE_MACHINE_VERSION);
+  write_value<uint32_t>(file, desc.states.size());
+  write_value<uint32_t>(file, desc.transitions.size());
+  write_value<uint32_t>(file, desc.clipNames.size());
+  write_value<uint32_t>(file, desc.triangles.size());
+  write_value<uint32_t>(file, desc.parameterNames.size());
+  write_value<int32_t>(file, desc.entry);
+  for (const StateDesc &state : desc.states)
+    write_state(file, state);
+  for (const StateTransition &transition : desc.transitions)
+    write_transition(file, transition);
+  for (const glm::float2 &parameter : desc.clipParameters)
+  {
+    write_value<float>(file, parameter.x);
+    write_value<float>(file, parameter.y);
+  }
+  for (const AnimationTriangle &triangle : desc.triangles)
+  {
+    write_value<uint32_t>(file, triangle.idx1);
+    write_value<uint32_t>(file, triangle.idx2);
+    write_value<uint32_t>(file, triangle.idx3);
+  }
+  for (float value : desc.parameterDefaults)
+    write_value<float>(file, value);
+  const bool success = write_names(file, desc.stateNames) && write_names(file, desc.clipNames) && write_names(file, desc.parameterNames);
+  fclose(file);
+  return success;
+}
+
+static bool read_header(FILE *file, StateMachineHeader &header)
+{
+  return fread(header.magic, 1, sizeof(header.magic), file) == sizeof(header.magic) &&
+    !memcmp(header.magic, STATE_MACHINE_MAGIC, sizeof(header.magic)) &&
+    read_value(file, header.version) && header.version == STATE_MACHINE_VERSION &&
+    read_value(file, header.stateCount) && read_value(file, header.transitionCount) && read_value(file, header.clipCount) &&
+    read_value(file, header.triangleCount) && read_value(file, header.parameterCount) && read_value(file, header.entry);
+}
+
+static bool read_binary(const char *path, StateMachineDesc &desc)
+{
+  FILE *file = fopen(path, "rb");
+  if (!file)
+    return false;
+  fseek(file, 0, SEEK_END);
+  const uint64_t fileSize = uint64_t(ftell(file));
+  fseek(file, 0, SEEK_SET);
+
+  StateMachineHeader header;
+  bool success = read_header(file, header);
+  // a corrupt header fails here instead of allocating what its counts say
+  success = success && HEADER_BYTES + header.stateCount * (STATE_BYTES + STATE_NAME_BYTES) +
+    header.transitionCount * TRANSITION_BYTES + header.clipCount * CLIP_BYTES + header.triangleCount * TRIANGLE_BYTES +
+    header.parameterCount * PARAMETER_BYTES <= fileSize;
+  if (success)
+  {
+    desc.states.resize(header.stateCount);
+    desc.transitions.resize(header.transitionCount);
+    desc.clipParameters.resize(header.clipCount);
+    desc.triangles.resize(header.triangleCount);
+    desc.parameterDefaults.resize(header.parameterCount);
+    desc.entry = header.entry;
+  }
+  for (StateDesc &state : desc.states)
+    success = success && read_state(file, state);
+  for (StateTransition &transition : desc.transitions)
+    success = success && read_transition(file, transition);
+  for (glm::float2 &parameter : desc.clipParameters)
+    success = success && read_value(file, parameter.x) && read_value(file, parameter.y);
+  for (AnimationTriangle &triangle : desc.triangles)
+  {
+    uint32_t indices[3] = {};
+    success = success && read_value(file, indices[0]) && read_value(file, indices[1]) && read_value(file, indices[2]);
+    triangle = {indices[0], indices[1], indices[2]};
+  }
+  for (float &value : desc.parameterDefaults)
+    success = success && read_value(file, value);
+  success = success &&
+    read_names(file, fileSize, desc.stateNames, header.stateCount) &&
+    read_names(file, fileSize, desc.clipNames, header.clipCount) &&
+    read_names(file, fileSize, desc.parameterNames, header.parameterCount);
+  fclose(file);
+  return success;
+}
+
+// binary files skip name lookups, so every index is checked here, json ones pass the same checks
+static bool validate(const char *path, const StateMachineDesc &desc)
+{
+  const int stateCount = desc.states.size();
+  const int parameterCount = desc.parameterNames.size();
+  bool valid = desc.entry >= 0 && desc.entry < stateCount;
+  for (int i = 0; valid && i < stateCount; ++i)
+  {
+    const StateDesc &state = desc.states[i];
+    valid = (state.parent < 0 || (state.parent < i && desc.states[state.parent].kind == StateKind::Group)) &&
+      size_t(state.firstClip) + state.clipCount <= desc.clipNames.size() &&
+      size_t(state.firstTransition) + state.transitionCount <= desc.transitions.size();
+    switch (state.kind)
+    {
+    case StateKind::Clip:
+      valid = valid && state.clipCount == 1;
+      break;
+    case StateKind::Blend1D:
+      valid = valid && state.clipCount > 0 && state.parameterX >= 0 && state.parameterX < parameterCount;
+      break;
+    case StateKind::Blend2D:
+      // same minimums as json descriptions, a triangulation of 3 or more clips has at least one triangle
+      valid = valid && state.clipCount >= 3 && state.triangleCount > 0 && state.parameterX >= 0 && state.parameterX < parameterCount &&
+        state.parameterY >= 0 && state.parameterY < parameterCount &&
+        size_t(state.firstTriangle) + state.triangleCount <= desc.triangles.size();
+      for (uint32_t j = state.firstTriangle; valid && j < state.firstTriangle + state.triangleCount; ++j)
+        valid = std::max({desc.triangles[j].idx1, desc.triangles[j].idx2, desc.triangles[j].idx3}) < state.clipCount;
+      break;
+    case StateKind::Group:
+      valid = valid && state.defaultChild > i && state.defaultChild < stateCount && desc.states[state.defaultChild].parent == i;
+      break;
+    default:
+      valid = false;
+    }
+  }
+  for (const StateTransition &transition : desc.transitions)
+    valid = valid && transition.target >= 0 && transition.target < stateCount && transition.condition <= TransitionCondition::Less &&
+      (transition.condition == TransitionCondition::Always || (transition.parameter >= 0 && transition.parameter < parameterCount));
+  if (!valid)
+    engine::error(LogCategory::Animation, "State machine \"%s\" refers to missing states, clips or parameters", path);
+  return valid;
+}
+
+bool parse_state_machine(const char *path, StateMachineDesc &desc)
+{
+  const size_t length = strlen(path);
+  const bool json = length >= 5 && !strcmp(path + length - 5, ".json");
+  if (json ? !parse_json(path, desc) : !read_binary(path, desc))
+  {
+    if (!json)
+      engine::error(LogCategory::Animation, "Can't read state machine \"%s\"", path);
+    return false;
+  }
+  if (!validate(path, desc))
+    return false;
+
+  desc.speedParameter = find_name(desc.parameterNames, "speed");
+  desc.velocityXParameter = find_name(desc.parameterNames, "velocity_x");
+  desc.velocityYParameter = find_name(desc.parameterNames, "velocity_y");
+  desc.linearSpeedParameter = find_name(desc.parameterNames, "linear_speed");
+  return true;
+}
+
+bool resolve_state_machine_clips(StateMachineDesc &desc, const std::unordered_map<std::string, StateClip> &clipAssets)
+{
+  bool success = true;
+  desc.clips.resize(desc.clipNames.size());
+  for (size_t i = 0; i < desc.clipNames.size(); ++i)
+  {
+    auto it = clipAssets.find(desc.clipNames[i]);
+    if (it != clipAssets.end())
+      desc.clips[i] = it->second;
+    else
+    {
+      engine::error(LogCategory::Animation, "State machine clip \"%s\" is not loaded", desc.clipNames[i].c_str());
+      success = false;
+    }
+  }
+  return success;
+}
+
+StateMachineDescPtr load_state_machine(const char *path, const std::unordered_map<std::string, StateClip> &clipAssets)
+{
+  auto desc = std::make_shared<StateMachineDesc>();
+  if (!parse_state_machine(path, *desc) || !resolve_state_machine_clips(*desc, clipAssets))
+    return nullptr;
+  engine::log(LogCategory::Animation, "State machine \"%s\": %zu states, %zu transitions, %zu clips",
+    path, desc->states.size(), desc->transitions.size(), desc->clips.size());
+  return desc;
+}
@@ -0,0 +1,303 @@
+#pragma once
+
+#include "animation_controller.h"
+#include "blend_space_1d.h"
+#include "blend_space_2d.h"
+#include "engine/import/model.h"
+#include "sync_markers.h"
+#include <cassert>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Data-driven animation state machine. Leaf states play a clip or a blend space, group states only hold children:
+// entering a group enters its default child and transitions of a group apply to all of its descendants.
+// Description is immutable and shared by every character that plays it, states, transitions and clips are flat arrays
+// indexed by state, instance keeps playback state in arrays of the same layout, so update never allocates.
+
+enum class StateKind : uint8_t
+{
+  Clip,
+  Blend1D,
+  Blend2D,
+  Group
+};
+
+enum class TransitionCondition : uint8_t
+{
+  Always,
+  Greater,
+  Less
+};
+
+struct StateDesc
+{
+  StateKind kind = StateKind::Clip;
+  bool loop = true;      // non-looping states hold their last frame
+  int parent = -1;       // group state, -1 on the top level
+  int defaultChild = -1; // groups only
+  uint32_t firstClip = 0;
+  uint32_t clipCount = 0;
+  uint32_t firstTriangle = 0; // Blend2D, triangle indices are relative to firstClip
+  uint32_t triangleCount = 0;
+  int parameterX = -1; // Blend1D and Blend2D
+  int parameterY = -1; // Blend2D
+  float speed = 1.f;
+  uint32_t firstTransition = 0;
+  uint32_t transitionCount = 0;
+};
+
+struct StateTransition
+{
+  int target = -1; // groups are entered through their default children
+  TransitionCondition condition = TransitionCondition::Always;
+  int parameter = -1;
+  float threshold = 0.f;
+  float duration = 0.2f; // cross-fade seconds, 0 switches at once
+  float exitTime = -1.f; // normalized time of the current state to wait for, -1 fires at any time
+};
+
+struct StateClip
+{
+  AnimationPtr animation = nullptr;
+  RootMotionPtr rootMotion = nullptr;
+  SyncTrackPtr sync = nullptr;
+  AnimationTracksPtr tracks = nullptr;
+};
+
+struct StateMachineDesc
+{
+  std::vector<StateDesc> states;           // parents go before their children
+  std::vector<StateTransition> transitions; // grouped by source state
+  std::vector<StateClip> clips;            // grouped by state, filled by resolve_state_machine_clips
+  std::vector<glm::float2> clipParameters; // position of every clip in its blend space
+  std::vector<AnimationTriangle> triangles;
+  std::vector<float> parameterDefaults;
+  std::vector<std::string> stateNames;
+  std::vector<std::string> clipNames;
+  std::vector<std::string> parameterNames;
+  int entry = 0;
+  // parameters animate_character fills from character velocities, -1 when the description doesn't use them
+  int speedParameter = -1;       // "speed", length of velocity
+  int velocityXParameter = -1;   // "velocity_x"
+  int velocityYParameter = -1;   // "velocity_y"
+  int linearSpeedParameter = -1; // "linear_speed", linearVelocity
+};
+
+using StateMachineDescPtr = std::shared_ptr<const StateMachineDesc>;
+
+// .json description or binary one written by save_state_machine, clips stay unresolved
+bool parse_state_machine(const char *path, StateMachineDesc &desc);
+bool save_state_machine(const char *path, const StateMachineDesc &desc);
+// clips are looked up by name, returns false when some of them are missing
+bool resolve_state_machine_clips(StateMachineDesc &desc, const std::unordered_map<std::string, StateClip> &clipAssets);
+// parse_state_machine and resolve_state_machine_clips, nullptr when any of them fails
+StateMachineDescPtr load_state_machine(const char *path, const std::unordered_map<std::string, StateClip> &clipAssets);
+
+struct StateMachine final : IAnimationController
+{
+  StateMachineDescPtr desc;
+  std::vector<float> parameters;
+  int current = -1;  // leaf state
+  int previous = -1; // leaf state fading out, -1 when no transition is in progress
+  float fadeTime = 0.f;
+  float fadeDuration = 0.f;
+  // per state of the description
+  std::vector<float> stateProgress; // normalized time of the leading clip
+  std::vector<int> stateLeader;     // heaviest clip with sync markers, see sync_markers.h
+  // per clip of the description
+  std::vector<float> clipWeights;
+  std::vector<float> clipProgress;
+  std::vector<float> clipPreviousProgress;
+
+  StateMachine(const StateMachineDescPtr &_desc) : desc{_desc}
+  {
+    parameters = desc->parameterDefaults;
+    stateProgress.resize(desc->states.size());
+    stateLeader.resize(desc->states.size(), -1);
+    clipWeights.resize(desc->clips.size());
+    clipProgress.resize(desc->clips.size());
+    clipPreviousProgress.resize(desc->clips.size());
+    current = leaf_state(desc->entry);
+    set_progress(0.f);
+  }
+
+  int find_parameter(std::string_view name) const
+  {
+    for (size_t i = 0; i < desc->parameterNames.size(); ++i)
+      if (desc->parameterNames[i] == name)
+        return i;
+    return -1;
+  }
+
+  void set_parameter(int parameter, float value)
+  {
+    if (parameter >= 0)
+      parameters[parameter] = value;
+  }
+
+  void set_locomotion(glm::float2 velocity, float linearVelocity)
+  {
+    set_parameter(desc->speedParameter, glm::length(velocity));
+    set_parameter(desc->velocityXParameter, velocity.x);
+    set_parameter(desc->velocityYParameter, velocity.y);
+    set_parameter(desc->linearSpeedParameter, linearVelocity);
+  }
+
+  // normalized time of the transition, 1 when none is in progress
+  float fade_weight() const
+  {
+    return previous >= 0 ? std::min(fadeTime / fadeDuration, 1.f) : 1.f;
+  }
+
+  void update(float dt) override
+  {
+    update_weights(current);
+    advance_state(current, dt);
+    if (previous >= 0)
+    {
+      update_weights(previous);
+      advance_state(previous, dt);
+      fadeTime += dt;
+      if (fadeTime >= fadeDuration)
+        previous = -1;
+    }
+    // a running cross-fade finishes before the next transition starts
+    else
+      try_transitions();
+  }
+
+  void set_progress(float _progress) override
+  {
+    previous = -1;
+    enter_state(current, _progress);
+  }
+
+  void collect_animations(FrameVector<WeightedAnimation> &out) override
+  {
+    // fading out state goes first, so it keeps its layers when a transition starts
+    const float fade = fade_weight();
+    if (previous >= 0)
+      collect_state(previous, 1.f - fade, out);
+    collect_state(current, fade, out);
+  }
+
+  int leaf_state(int state) const
+  {
+    while (desc->states[state].kind == StateKind::Group)
+      state = desc->states[state].defaultChild;
+    return state;
+  }
+
+  bool transition_ready(const StateTransition &transition) const
+  {
+    if (transition.exitTime >= 0.f && stateProgress[current] < transition.exitTime)
+      return false;
+    switch (transition.condition)
+    {
+    case TransitionCondition::Greater: return parameters[transition.parameter] > transition.threshold;
+    case TransitionCondition::Less: return parameters[transition.parameter] < transition.threshold;
+    default: return true;
+    }
+  }
+
+  // own transitions of the state are checked before the ones of its groups
+  void try_transitions()
+  {
+    for (int state = current; state >= 0; state = desc->states[state].parent)
+    {
+      const StateDesc &source = desc->states[state];
+      for (uint32_t i = source.firstTransition; i < source.firstTransition + source.transitionCount; ++i)
+      {
+        const StateTransition &transition = desc->transitions[i];
+        const int target = leaf_state(transition.target);
+        if (target == current || !transition_ready(transition))
+          continue;
+        previous = transition.duration > 0.f ? current : -1;
+        current = target;
+        fadeTime = 0.f;
+        fadeDuration = transition.duration;
+        enter_state(current, 0.f);
+        return;
+      }
+    }
+  }
+
+  void enter_state(int state, float progress)
+  {
+    const StateDesc &stateDesc = desc->states[state];
+    const std::span<const StateClip> clips(desc->clips.data() + stateDesc.firstClip, stateDesc.clipCount);
+    const std::span<float> weights(clipWeights.data() + stateDesc.firstClip, stateDesc.clipCount);
+    const std::span<float> progresses(clipProgress.data() + stateDesc.firstClip, stateDesc.clipCount);
+
+    update_weights(state);
+    stateLeader[state] = find_sync_leader(clips, weights);
+    stateProgress[state] = progress;
+    sync_clip_progress(clips, stateLeader[state], progress, progresses);
+    std::copy(progresses.begin(), progresses.end(), clipPreviousProgress.begin() + stateDesc.firstClip);
+  }
+
+  void update_weights(int state)
+  {
+    const StateDesc &stateDesc = desc->states[state];
+    const std::span<float> weights(clipWeights.data() + stateDesc.firstClip, stateDesc.clipCount);
+    const glm::float2 *points = desc->clipParameters.data() + stateDesc.firstClip;
+    switch (stateDesc.kind)
+    {
+    case StateKind::Clip:
+      weights[0] = 1.f;
+      break;
+    case StateKind::Blend1D:
+      blend_space_1d_weights(stateDesc.clipCount, [points](size_t i) { return points[i].x; }, parameters[stateDesc.parameterX], weights);
+      break;
+    case StateKind::Blend2D:
+      blend_space_2d_weights(std::span(desc->triangles.data() + stateDesc.firstTriangle, stateDesc.triangleCount),
+        [points](size_t i) { return points[i]; }, {parameters[stateDesc.parameterX], parameters[stateDesc.parameterY]}, weights);
+      break;
+    case StateKind::Group:
+      assert(false && "group states are never played");
+      break;
+    }
+  }
+
+  void advance_state(int state, float dt)
+  {
+    const StateDesc &stateDesc = desc->states[state];
+    const std::span<const StateClip> clips(desc->clips.data() + stateDesc.firstClip, stateDesc.clipCount);
+    const std::span<float> weights(clipWeights.data() + stateDesc.firstClip, stateDesc.clipCount);
+    const std::span<float> progresses(clipProgress.data() + stateDesc.firstClip, stateDesc.clipCount);
+
+    float duration = 0.f;
+    for (size_t i = 0; i < clips.size(); ++i)
+      duration += weights[i] * clips[i].animation->duration();
+
+    std::copy(progresses.begin(), progresses.end(), clipPreviousProgress.begin() + stateDesc.firstClip);
+    // same leader switching as in blend spaces
+    const int newLeader = find_sync_leader(clips, weights);
+    if (newLeader >= 0 && newLeader != stateLeader[state])
+      stateProgress[state] = progresses[newLeader];
+    stateLeader[state] = newLeader;
+
+    float &progress = stateProgress[state];
+    if (duration > 0.f)
+      progress += dt * stateDesc.speed / duration;
+    if (!stateDesc.loop)
+      progress = std::min(progress, 1.f);
+    else if (progress > 1.f)
+      progress -= 1.f;
+    sync_clip_progress(clips, stateLeader[state], progress, progresses);
+  }
+
+  void collect_state(int state, float weight, FrameVector<WeightedAnimation> &out) const
+  {
+    const StateDesc &stateDesc = desc->states[state];
+    for (uint32_t i = stateDesc.firstClip; i < stateDesc.firstClip + stateDesc.clipCount; ++i)
+    {
+      const StateClip &clip = desc->clips[i];
+      out.push_back({.animation = clip.animation, .weight = weight * clipWeights[i], .progress = clipProgress[i],
+        .rootMotion = clip.rootMotion, .previousProgress = clipPreviousProgress[i], .tracks = clip.tracks});
+    }
+  }
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <span>
+#include <vector>
+#include "engine/import/model.h"
+#include "ozz/animation/runtime/track_sampling_job.h"
+
+// Phase mapping between clips of a blend space, tracks are built by make_sync_track.
+// The heaviest clip with sync markers leads, others play at the ratio where they reach the same phase,
+// so foot contacts line up whatever the clip lengths and contact timings are.
+
+inline int sync_marker_count(const ozz::animation::FloatTrack &track)
+{
+  const auto values = track.values();
+  return int(std::lround(values[values.size() - 1] - values[0]));
+}
+
+// phase in [0, marker count)
+inline float sync_phase_at_ratio(const ozz::animation::FloatTrack &track, float ratio)
+{
+  float value;
+  ozz::animation::FloatTrackSamplingJob samplingJob;
+  samplingJob.track = &track;
+  samplingJob.ratio = ratio;
+  samplingJob.result = &value;
+  const bool success = samplingJob.Run();
+  assert(success);
+  const float count = sync_marker_count(track);
+  return value - std::floor(value / count) * count;
+}
+
+// inverse of sync_phase_at_ratio, phase track is monotonic so it's a search over its keys
+inline float sync_ratio_at_phase(const ozz::animation::FloatTrack &track, float phase)
+{
+  const auto ratios = track.ratios();
+  const auto values = track.values();
+  const float count = sync_marker_count(track);
+  // same phase one loop later or earlier, within the range covered by the track
+  const float offset = phase - values[0];
+  const float value = values[0] + offset - std::floor(offset / count) * count;
+  const size_t next = std::clamp<size_t>(std::upper_bound(values.begin(), values.end(), value) - values.begin(), 1, values.size() - 1);
+  const float t = (value - values[next - 1]) / (values[next] - values[next - 1]);
+  return std::min(ratios[next - 1] + t * (ratios[next] - ratios[next - 1]), 1.f);
+}
+
+// clips without markers, or with a different marker count, share leader's normalized time as before
+inline float synced_ratio(const SyncTrackPtr &leader, float leaderRatio, const SyncTrackPtr &follower)
+{
+  if (!leader || !follower || leader == follower)
+    return leaderRatio;
+  if (sync_marker_count(*leader) != sync_marker_count(*follower))
+    return leaderRatio;
+  return sync_ratio_at_phase(*follower, sync_phase_at_ratio(*leader, leaderRatio));
+}
+
+// heaviest node with sync markers, -1 when no weighted node has them
+// nodes is any indexable range of structs with a sync member, weights is parallel to it
+template<typename Nodes, typename Weights>
+int find_sync_leader(const Nodes &nodes, const Weights &weights)
+{
+  int leader = -1;
+  for (size_t i = 0; i < nodes.size(); ++i)
+    if (nodes[i].sync && weights[i] > 0.f && (leader < 0 || weights[i] > weights[leader]))
+      leader = i;
+  return leader;
+}
+
+// clipProgress is sized by the caller, parallel to nodes
+template<typename Nodes>
+void sync_clip_progress(const Nodes &nodes, int leader, float leaderProgress, std::span<float> clipProgress)
+{
+  static const SyncTrackPtr noSync;
+  const SyncTrackPtr &leaderSync = leader >= 0 ? nodes[leader].sync : noSync;
+  assert(clipProgress.size() == nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i)
+    clipProgress[i] = synced_ratio(leaderSync, leaderProgress, nodes[i].sync);
+}
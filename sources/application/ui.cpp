@@ -4,12 +4,24 @@
 #include "imgui/ImGuizmo.h"
 
 #include "scene.h"
+#include "state_machine.h"
 #include "user_camera.h"
+#include "engine/frame_arena.h"
 
 #define IMGUI_DEFINE_MATH_OPERATORS
 #include "imgui/imgui_internal.h"
 
 #include <format>
+#include <iterator>
+
+// labels are built in frame arena, ImGui copies what it keeps
+template<typename... Args>
+static FrameString frame_format(std::format_string<Args...> format, Args &&...args)
+{
+  FrameString result;
+  std::format_to(std::back_inserter(result), format, std::forward<Args>(args)...);
+  return result;
+}
 
 static ImGuizmo::OPERATION mCurrentGizmoOperation(ImGuizmo::TRANSLATE);
 static ImGuizmo::MODE mCurrentGizmoMode(ImGuizmo::WORLD);
@@ -58,49 +70,83 @@ static void show_characters(Scene &scene)
     // implement showing characters when only one character can be selected
     static uint32_t selectedCharacter = -1u;
     static uint32_t selectedNode = -1u;
-    for (size_t i = 0; i < scene.characters.size(); i++)
-    {
-      Character &character = scene.characters[i];
-      ImGui::PushID(i);
-      if (ImGui::Selectable(character.name.c_str(), selectedCharacter == i, ImGuiSelectableFlags_AllowDoubleClick))
+    // crowd scenes have up to 100k characters, only visible rows are submitted
+    ImGui::BeginChild("characters", ImVec2(0, 8 * ImGui::GetTextLineHeightWithSpacing()), true);
+    ImGuiListClipper clipper;
+    clipper.Begin(int(scene.characters.size()));
+    while (clipper.Step())
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
       {
-        selectedCharacter = i;
-        if (ImGui::IsMouseDoubleClicked(0))
+        Character &character = scene.characters[i];
+        ImGui::PushID(i);
+        if (ImGui::Selectable(character.name.c_str(), selectedCharacter == i, ImGuiSelectableFlags_AllowDoubleClick))
         {
-          scene.userCamera.arcballCamera.targetPosition = vec3(character.transform[3]) + vec3(0, 1, 0);
+          selectedCharacter = i;
+          if (ImGui::IsMouseDoubleClicked(0))
+          {
+            scene.userCamera.arcballCamera.targetPosition = vec3(character.transform[3]) + vec3(0, 1, 0);
+          }
         }
+        ImGui::PopID();
       }
-      if (selectedCharacter == i)
+    ImGui::EndChild();
+
+    if (selectedCharacter < scene.characters.size())
+    {
+      Character &character = scene.characters[selectedCharacter];
+      if(ImGui::SliderFloat("linear velocity", &character.linearVelocity, 0.f, 3.f))
       {
-        if(ImGui::SliderFloat("linear velocity", &character.linearVelocity, 0.f, 3.f))
-        {
 
-        }
-        ImGui::SliderFloat("front velocity", &character.velocity.x, -1.f, 1.f);
-        ImGui::SliderFloat("side velocity", &character.velocity.y, -1.f, 1.f);
+      }
+      ImGui::SliderFloat("front velocity", &character.velocity.x, -1.f, 1.f);
+      ImGui::SliderFloat("side velocity", &character.velocity.y, -1.f, 1.f);
+
+      for (size_t j = 0; j < character.ik.legs.size(); ++j)
+        ImGui::SliderFloat(frame_format("leg {} IK", j).c_str(), &character.ik.legs[j].weight, 0.f, 1.f);
+      for (size_t j = 0; j < character.ik.aims.size(); ++j)
+      {
+        // target follows the camera, so the head turns to the viewer
+        AimIkChain &aim = character.ik.aims[j];
+        ImGui::SliderFloat(frame_format("look at camera {}", j).c_str(), &aim.weight, 0.f, 1.f);
+        aim.target = vec3(scene.userCamera.transform[3]);
+      }
 
-        const float INDENT = 15.0f;
-        ImGui::Indent(INDENT);
-        ImGui::Text("Meshes: %zu", character.meshes.size());
+      for (const AnimationCurveValue &curve : character.animationCurves)
+        ImGui::Text("curve %.*s: %.2f", int(curve.name.size()), curve.name.data(), curve.value);
+      if (!character.lastAnimationEvent.empty())
+        ImGui::Text("last event: %s", character.lastAnimationEvent.c_str());
 
-        const SkeletonData &skeleton = character.skeleton;
-        ImGui::Text("Skeleton Nodes: %zu", skeleton.names.size());
-        for (int j = 0; j < skeleton.names.size(); ++j)
+      for (const auto &controller : character.controllers)
+        if (const StateMachine *stateMachine = dynamic_cast<const StateMachine *>(controller.get()))
         {
-          if (ImGui::Selectable((std::string(skeleton.depth[j], ' ') + skeleton.names[j]).c_str(), selectedNode == j))
-          {
-            selectedNode = j;
-          }
+          const std::vector<std::string> &stateNames = stateMachine->desc->stateNames;
+          if (stateMachine->previous >= 0)
+            ImGui::Text("state: %s, from %s %.0f%%", stateNames[stateMachine->current].c_str(),
+              stateNames[stateMachine->previous].c_str(), 100.f * stateMachine->fade_weight());
+          else
+            ImGui::Text("state: %s", stateNames[stateMachine->current].c_str());
         }
 
-        ImGui::Unindent(INDENT);
+      const float INDENT = 15.0f;
+      ImGui::Indent(INDENT);
+      ImGui::Text("Meshes: %zu", character.meshes.size());
+
+      const SkeletonData &skeleton = *character.skeleton;
+      ImGui::Text("Skeleton Nodes: %zu", skeleton.names.size());
+      for (int j = 0; j < skeleton.names.size(); ++j)
+      {
+        if (ImGui::Selectable(frame_format("{:{}}{}", "", skeleton.depth[j], skeleton.names[j]).c_str(), selectedNode == j))
+        {
+          selectedNode = j;
+        }
       }
-      ImGui::PopID();
+
+      ImGui::Unindent(INDENT);
     }
     if (selectedCharacter < scene.characters.size())
     {
       Character &character = scene.characters[selectedCharacter];
-      if (selectedNode < character.skeleton.names.size())
+      if (selectedNode < character.skeleton->names.size())
       {
         glm::mat4 &worldTransform = reinterpret_cast<glm::mat4 &>(character.animationContext.worldTransforms[selectedNode]);
         glm::mat4 transform = character.transform * worldTransform;
@@ -115,13 +161,14 @@ static void show_characters(Scene &scene)
       ImDrawList *drawList = ImGui::GetOverlayDrawList();
       ImColor skeletonColor(255,127,255);
       const float arrowSize = 10.f;
-      for (size_t i = 1; i < character.skeleton.names.size(); ++i)
+      for (size_t i = 1; i < character.skeleton->names.size(); ++i)
       {
-        const int &parent = character.skeleton.parents[i];
-        std::vector<glm::mat4> &transforms = reinterpret_cast<std::vector<glm::mat4> &>(character.animationContext.worldTransforms);
+        const int &parent = character.skeleton->parents[i];
+        // same interpolated pose as rendered mesh
+        std::vector<glm::mat4> &transforms = reinterpret_cast<std::vector<glm::mat4> &>(character.animationContext.renderTransforms);
 
-        const glm::mat4 fromTransform = character.transform * transforms[parent];
-        const glm::mat4 toTransform = character.transform * transforms[i];
+        const glm::mat4 fromTransform = character.renderTransform * transforms[parent];
+        const glm::mat4 toTransform = character.renderTransform * transforms[i];
         const glm::vec2 fromScreen = world_to_screen(scene.userCamera, glm::vec3(fromTransform[3]));
         const glm::vec2 toScreen = world_to_screen(scene.userCamera, glm::vec3(toTransform[3]));
 
@@ -177,6 +224,10 @@ static void show_models(Scene &scene)
 {
   if (ImGui::Begin("Models"))
   {
+    // raw clips are kept only with --raw-animations
+    if (!scene.rawAnimations.empty())
+      ImGui::Checkbox("Play raw (unoptimized) animations", &scene.useRawAnimations);
+
     static uint32_t selectedModel = -1u;
     for (size_t i = 0; i < scene.models.size(); i++)
     {
@@ -192,14 +243,14 @@ static void show_models(Scene &scene)
 
         ImGui::Text("Path: %s", model.path.c_str());
 
-        if(ImGui::TreeNode(std::format("all_meshes_%d", i).c_str(), "Meshes: %zu", model.meshes.size()))
+        if(ImGui::TreeNode(frame_format("all_meshes_{}", i).c_str(), "Meshes: %zu", model.meshes.size()))
         {
           for (size_t j = 0; j < model.meshes.size(); j++)
           {
             const MeshPtr &mesh = model.meshes[j];
 
             ImGui::PushID(j);
-            if(ImGui::TreeNode(std::format("cur_mesh_%d", j).c_str(), "%s", mesh->name.c_str()))
+            if(ImGui::TreeNode(frame_format("cur_mesh_{}", j).c_str(), "%s", mesh->name.c_str()))
             {
               ImGui::Text("Bones :%zu", mesh->boneNames.size());
               int boneIndex = 0;
@@ -217,6 +268,19 @@ static void show_models(Scene &scene)
           ImGui::TreePop();
         }
 
+        if(ImGui::TreeNode(frame_format("all_animations_{}", i).c_str(), "Animations: %zu", model.animationHandles.size()))
+        {
+          for (const AnimationImportReport &report : model.animationReports)
+          {
+            const float ratio = report.rawSize > 0 ? float(report.optimizedSize) / report.rawSize : 1.f;
+            ImGui::Text("%s", report.name.c_str());
+            ImGui::Text("  %.1f KB -> %.1f KB (%.0f%%), max error %.2f mm at %s",
+              report.rawSize / 1024.f, report.optimizedSize / 1024.f, ratio * 100.f, report.maxError * 1000.f,
+              report.maxErrorJoint >= 0 ? model.skeleton.ozzSkeleton->joint_names()[report.maxErrorJoint] : "-");
+          }
+          ImGui::TreePop();
+        }
+
         ImGui::Unindent(15.0f);
       }
     }
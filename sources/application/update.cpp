@@ -1,51 +1,101 @@
 #include "animation_controller.h"
 #include "blend_space_1d.h"
 #include "blend_space_2d.h"
+#include "state_machine.h"
 #include "glm/ext/quaternion_geometric.hpp"
 #include "ozz/animation/runtime/blending_job.h"
 #include "ozz/animation/runtime/local_to_model_job.h"
 #include "scene.h"
 #include "character.h"
+#include "engine/profiler.h"
+#include "engine/replay.h"
+#include "pose_hash.h"
+#include "root_motion.h"
 #include "ozz/base/span.h"
 #include "ozz/base/maths/soa_transform.h"
 #include "ozz/animation/runtime/sampling_job.h"
 #include <cassert>
 #include <cstddef>
 
-void application_update(Scene &scene)
+// Weighted average of root deltas of full body layers, normalized the same way BlendingJob normalizes their poses,
+// so a blend of walk directions moves the character along the blended direction at the blended speed.
+// Layers without root motion (idle) still count, blending towards them slows the character down.
+static vec3 blend_root_motion(const FrameVector<WeightedAnimation> &animations)
 {
-  arcball_camera_update(
-    scene.userCamera.arcballCamera,
-    scene.userCamera.transform,
-    engine::get_delta_time());
-
-  for (Character &character : scene.characters)
+  vec3 delta(0.f);
+  float totalWeight = 0.f;
+  for (const WeightedAnimation &wa : animations)
   {
-    AnimationContext &animationContext = character.animationContext;
+    if (wa.additive || wa.mask || wa.weight <= 0.f)
+      continue;
+    totalWeight += wa.weight;
+    if (wa.rootMotion)
+      delta += wa.weight * root_motion_delta(*wa.rootMotion, wa.previousProgress, wa.progress);
+  }
+  return totalWeight > 0.f ? delta / totalWeight : vec3(0.f);
+}
 
-    std::vector<WeightedAnimation> animations;
-    for (auto &controller : character.controllers)
+void set_controller_parameters(Character &character)
+{
+  for (auto &controller : character.controllers)
+  {
+    if (BlendSpace2D *blendSpace = dynamic_cast<BlendSpace2D *>(controller.get()))
     {
-      if (BlendSpace2D *blendSpace = dynamic_cast<BlendSpace2D *>(controller.get()))
-      {
-        blendSpace -> set_parameter(character.velocity);
-      }
-      else if (BlendSpace1D *blendSpace = dynamic_cast<BlendSpace1D *>(controller.get()))
-      {
-        blendSpace -> set_parameter(glm::length(character.linearVelocity));
-      }
+      blendSpace -> set_parameter(character.velocity);
+    }
+    else if (BlendSpace1D *blendSpace = dynamic_cast<BlendSpace1D *>(controller.get()))
+    {
+      blendSpace -> set_parameter(glm::length(character.linearVelocity));
+    }
+    else if (StateMachine *stateMachine = dynamic_cast<StateMachine *>(controller.get()))
+    {
+      stateMachine->set_locomotion(character.velocity, character.linearVelocity);
     }
+  }
+}
+
+void animate_character(const Scene &scene, Character &character, float dt)
+{
+  // nothing allocated here outlives the call, so every character and step reuses the same arena memory
+  FrameArenaScope frameScope;
+  AnimationContext &animationContext = character.animationContext;
+  {
+    PROFILE_ZONE("controllers");
+    FrameVector<WeightedAnimation> animations;
+    // layers grow to the most clips the controllers collected, so it's rarely exceeded
+    animations.reserve(animationContext.layers.size());
+    set_controller_parameters(character);
     for (auto &controller : character.controllers)
     {
-      controller->update(engine::get_delta_time());
+      controller->update(dt);
       controller->collect_animations(animations);
     }
 
     animationContext.clear_animation_layers();
     for (const WeightedAnimation &wa : animations)
-      animationContext.add_animation(wa.animation, wa.progress, wa.weight);
+    {
+      const AnimationPtr *animation = &wa.animation;
+      if (scene.useRawAnimations)
+      {
+        auto it = scene.rawAnimations.find(engine::get_asset_registry().find(wa.animation.get()));
+        if (it != scene.rawAnimations.end())
+          animation = &it->second;
+      }
+      animationContext.add_animation(*animation, wa.progress, wa.weight, wa.mask, wa.additive);
+    }
+    animationContext.release_inactive_layers();
+
+    // delta is in character space, so it follows character's facing
+    const vec3 rootMotion = blend_root_motion(animations);
+    if (rootMotion != vec3(0.f))
+      character.transform = glm::translate(character.transform, rootMotion);
 
-    for (AnimationLayer &layer : animationContext.layers)
+    evaluate_animation_tracks(character, animations);
+  }
+
+  {
+    PROFILE_ZONE("sampling");
+    for (AnimationLayer &layer : animationContext.active_layers())
     {
       assert(layer.curentAnimation != nullptr);
 
@@ -54,38 +104,54 @@ void application_update(Scene &scene)
       samplingJob.animation = layer.curentAnimation.get();
       samplingJob.context = layer.samplingCache.get();
       samplingJob.output = ozz::make_span(layer.localLayerTransforms);
+      // partial body layers don't decompress joints they don't blend
+      if (layer.mask)
+        samplingJob.soa_track_mask = ozz::make_span(layer.mask->sampledSoaTracks);
 
       assert(samplingJob.Validate());
       const bool success = samplingJob.Run();
       assert(success);
     }
+  }
 
 
-    if (!animationContext.layers.empty())
+  if (animationContext.activeLayers > 0)
+  {
+    PROFILE_ZONE("blending");
+    ozz::animation::BlendingJob blendingJob;
+    blendingJob.output = ozz::make_span(animationContext.localTransforms);
+    blendingJob.threshold = 0.01f;
+    const std::span<AnimationLayer> activeLayers = animationContext.active_layers();
+    // additive layers are applied after normal ones are blended, without them rest pose is the base
+    FrameVector<ozz::animation::BlendingJob::Layer> layers;
+    FrameVector<ozz::animation::BlendingJob::Layer> additiveLayers;
+    layers.reserve(activeLayers.size());
+    additiveLayers.reserve(activeLayers.size());
+    for (const AnimationLayer &activeLayer : activeLayers)
     {
-      ozz::animation::BlendingJob blendingJob;
-      blendingJob.output = ozz::make_span(animationContext.localTransforms);
-      blendingJob.threshold = 0.01f;
-      std::vector<ozz::animation::BlendingJob::Layer> layers(animationContext.layers.size());
-      for (int i = 0; i < animationContext.layers.size(); ++i)
-      {
-        layers[i].weight = animationContext.layers[i].weight;
-        layers[i].transform = ozz::make_span(animationContext.layers[i].localLayerTransforms);
-      }
-      blendingJob.layers = ozz::make_span(layers);
-      blendingJob.rest_pose = animationContext.skeleton->joint_rest_poses();
+      ozz::animation::BlendingJob::Layer &layer = activeLayer.additive ? additiveLayers.emplace_back() : layers.emplace_back();
+      layer.weight = activeLayer.weight;
+      layer.transform = ozz::make_span(activeLayer.localLayerTransforms);
+      if (activeLayer.mask)
+        layer.joint_weights = ozz::make_span(activeLayer.mask->weights);
+    }
+    blendingJob.layers = ozz::make_span(layers);
+    blendingJob.additive_layers = ozz::make_span(additiveLayers);
+    blendingJob.rest_pose = animationContext.skeleton->joint_rest_poses();
 
-      assert(blendingJob.Validate());
-      const bool success = blendingJob.Run();
-      assert(success);
+    assert(blendingJob.Validate());
+    const bool success = blendingJob.Run();
+    assert(success);
 
-    }
-    else
-    {
-      auto tPose = animationContext.skeleton->joint_rest_poses();
-      animationContext.localTransforms.assign(tPose.begin(), tPose.end());
-    }
+  }
+  else
+  {
+    auto tPose = animationContext.skeleton->joint_rest_poses();
+    animationContext.localTransforms.assign(tPose.begin(), tPose.end());
+  }
 
+  {
+    PROFILE_ZONE("local_to_model");
     ozz::animation::LocalToModelJob localToModelJob;
     localToModelJob.skeleton = animationContext.skeleton.get();
     localToModelJob.input = ozz::make_span(animationContext.localTransforms);
@@ -95,4 +161,78 @@ void application_update(Scene &scene)
     const bool success = localToModelJob.Run();
     assert(success);
   }
-}
\ No newline at end of file
+
+  apply_character_ik(scene, character);
+}
+
+void application_update(Scene &scene)
+{
+  PROFILE_ZONE("application_update");
+  arcball_camera_update(
+    scene.userCamera.arcballCamera,
+    scene.userCamera.transform,
+    engine::get_delta_time());
+
+  // parameters set from UI, replay records them or overwrites them with recorded ones
+  float sceneParameters[1] = {scene.useRawAnimations ? 1.f : 0.f};
+  engine::replay_sync_parameters(sceneParameters, 1);
+  scene.useRawAnimations = sceneParameters[0] != 0.f;
+
+  for (Character &character : scene.characters)
+  {
+    PROFILE_ZONE("character");
+    AnimationContext &animationContext = character.animationContext;
+
+    // keep state of the previous step, rendering interpolates from it, local pose is fully overwritten below
+    character.prevTransform = character.transform;
+    std::swap(animationContext.prevLocalTransforms, animationContext.localTransforms);
+
+    float blendParameters[3] = {character.linearVelocity, character.velocity.x, character.velocity.y};
+    engine::replay_sync_parameters(blendParameters, 3);
+    character.linearVelocity = blendParameters[0];
+    character.velocity = {blendParameters[1], blendParameters[2]};
+
+    // IK weights and look-at targets are set from UI or gameplay
+    for (TwoBoneIkChain &leg : character.ik.legs)
+      engine::replay_sync_parameters(&leg.weight, 1);
+    for (AimIkChain &aim : character.ik.aims)
+    {
+      float aimParameters[4] = {aim.weight, aim.target.x, aim.target.y, aim.target.z};
+      engine::replay_sync_parameters(aimParameters, 4);
+      aim.weight = aimParameters[0];
+      aim.target = {aimParameters[1], aimParameters[2], aimParameters[3]};
+    }
+
+    animate_character(scene, character, engine::get_delta_time());
+  }
+
+  {
+    PROFILE_ZONE("animation_events");
+    // may run on the simulation thread, handlers are fired later by dispatch_animation_events
+    for (size_t i = 0; i < scene.characters.size(); ++i)
+      for (AnimationEvent event : scene.characters[i].animationEvents)
+      {
+        event.character = i;
+        scene.pendingAnimationEvents.push_back(event);
+      }
+  }
+
+  if (engine::is_replay_recording() || engine::is_replay_playing())
+  {
+    uint64_t hash = POSE_HASH_SEED;
+    for (const Character &character : scene.characters)
+      hash = hash_pose(character.animationContext.worldTransforms, hash);
+    engine::replay_check_pose_hash(hash);
+  }
+}
+
+void dispatch_animation_events(Scene &scene, std::span<const AnimationEvent> events)
+{
+  if (events.empty())
+    return;
+  PROFILE_ZONE("dispatch_animation_events");
+  for (const AnimationEvent &event : events)
+    if (event.character < scene.characters.size())
+      scene.characters[event.character].lastAnimationEvent = event.name;
+  scene.onAnimationEvents(AnimationEventBatch{events});
+}
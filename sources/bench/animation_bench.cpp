@@ -0,0 +1,359 @@
+#include "bench.h"
+#include "application/animation_events.h"
+#include "application/blend_space_2d.h"
+#include "application/scene.h"
+#include "application/joint_mask.h"
+#include "application/skinning_palette.h"
+#include "engine/frame_arena.h"
+#include <memory>
+#include <random>
+#include <ozz/animation/runtime/blending_job.h>
+#include <ozz/animation/runtime/local_to_model_job.h>
+#include <ozz/animation/runtime/sampling_job.h>
+#include <ozz/animation/runtime/track_triggering_job.h>
+#include <ozz/animation/offline/raw_track.h>
+#include <ozz/animation/offline/track_builder.h>
+#include <ozz/base/maths/simd_math.h>
+#include <ozz/base/maths/soa_transform.h>
+
+using SoaPose = std::vector<ozz::math::SoaTransform>;
+using ModelPose = std::vector<ozz::math::Float4x4>;
+
+static constexpr int RIG_DEPTH = 5; // 364 joints, a dense game character
+
+// samples at advancing ratio like playback, then at random ratios that defeat the keyframe cache
+static void bench_sampling_clip(const std::string &name, const ozz::animation::Animation &animation, int numJoints, const JointMask *mask = nullptr)
+{
+  ozz::animation::SamplingJob::Context context(numJoints);
+  SoaPose output((numJoints + 3) / 4);
+  ozz::animation::SamplingJob samplingJob;
+  samplingJob.animation = &animation;
+  samplingJob.context = &context;
+  samplingJob.output = ozz::make_span(output);
+  if (mask)
+    samplingJob.soa_track_mask = ozz::make_span(mask->sampledSoaTracks);
+
+  const int samples = 2000;
+  float ratio = 0.f;
+  const double playbackUs = measure_us(samples, [&]() {
+    ratio += 1.f / 60.f / std::max(animation.duration(), 1e-3f);
+    if (ratio > 1.f)
+      ratio -= 1.f;
+    samplingJob.ratio = ratio;
+    samplingJob.Run();
+  });
+
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> randomRatio(0.f, 1.f);
+  const double randomUs = measure_us(samples, [&]() {
+    samplingJob.ratio = randomRatio(rng);
+    samplingJob.Run();
+  });
+
+  bench_result("sampling", name + "/playback", playbackUs, "us/sample");
+  bench_result("sampling", name + "/random", randomUs, "us/sample");
+}
+
+void bench_sampling(BenchContext &context)
+{
+  SkeletonPtr skeleton = make_bench_skeleton(RIG_DEPTH);
+  struct SyntheticClip
+  {
+    const char *name;
+    float duration;
+    int keys;
+  };
+  const SyntheticClip clips[] = {
+    {"synthetic_static", 1.f, 2},
+    {"synthetic_1s_30fps", 1.f, 31},
+    {"synthetic_30s_30fps", 30.f, 901},
+  };
+  for (const SyntheticClip &clip : clips)
+  {
+    AnimationPtr animation = make_bench_animation(*skeleton, clip.duration, clip.keys);
+    bench_sampling_clip(clip.name, *animation, skeleton->num_joints());
+  }
+
+  // partial body layer on the 30s clip, first child subtree of the root is a third of the rig
+  {
+    std::vector<std::string> names;
+    SkeletonPtr maskedSkeleton = make_bench_skeleton(RIG_DEPTH, &names);
+    AnimationPtr animation = make_bench_animation(*maskedSkeleton, 30.f, 901);
+    JointMaskPtr mask = get_joint_mask(maskedSkeleton, {{names[1], 1.f}});
+    bench_sampling_clip("synthetic_30s_30fps_masked_" + std::to_string(mask->sampledJoints) + "_joints",
+      *animation, maskedSkeleton->num_joints(), mask.get());
+  }
+
+  for (const ModelAsset &model : context.models)
+    for (const AnimationPtr &animation : model.animations)
+      bench_sampling_clip(animation->name(), *animation, model.skeleton.ozzSkeleton->num_joints());
+}
+
+void bench_blending(BenchContext &)
+{
+  SkeletonPtr skeleton = make_bench_skeleton(RIG_DEPTH);
+  const int numSoaJoints = skeleton->num_soa_joints();
+  auto restPose = skeleton->joint_rest_poses();
+
+  for (int layerCount : {1, 2, 4, 8, 16, 32})
+  {
+    std::vector<SoaPose> layerPoses(layerCount, SoaPose(restPose.begin(), restPose.end()));
+    std::vector<ozz::animation::BlendingJob::Layer> layers(layerCount);
+    for (int i = 0; i < layerCount; ++i)
+    {
+      layers[i].weight = 1.f / layerCount;
+      layers[i].transform = ozz::make_span(layerPoses[i]);
+    }
+    SoaPose output(numSoaJoints);
+
+    ozz::animation::BlendingJob blendingJob;
+    blendingJob.layers = ozz::make_span(layers);
+    blendingJob.rest_pose = restPose;
+    blendingJob.output = ozz::make_span(output);
+    blendingJob.threshold = 0.01f;
+
+    const double us = measure_us(2000, [&]() { blendingJob.Run(); });
+    bench_result("blending", std::to_string(layerCount) + "_layers", us, "us/job");
+  }
+
+  // additive layers on top of one normal layer, as breathing or hit reactions over locomotion
+  SoaPose basePose(restPose.begin(), restPose.end());
+  ozz::animation::BlendingJob::Layer baseLayer;
+  baseLayer.transform = ozz::make_span(basePose);
+  for (int additiveCount : {0, 1, 2, 4, 8})
+  {
+    std::vector<SoaPose> additivePoses(additiveCount, SoaPose(restPose.begin(), restPose.end()));
+    std::vector<ozz::animation::BlendingJob::Layer> additiveLayers(additiveCount);
+    for (int i = 0; i < additiveCount; ++i)
+    {
+      additiveLayers[i].weight = 0.5f;
+      additiveLayers[i].transform = ozz::make_span(additivePoses[i]);
+    }
+    SoaPose output(numSoaJoints);
+
+    ozz::animation::BlendingJob blendingJob;
+    blendingJob.layers = {&baseLayer, 1};
+    blendingJob.additive_layers = ozz::make_span(additiveLayers);
+    blendingJob.rest_pose = restPose;
+    blendingJob.output = ozz::make_span(output);
+
+    const double us = measure_us(2000, [&]() { blendingJob.Run(); });
+    bench_result("blending", "1_layer_" + std::to_string(additiveCount) + "_additive", us, "us/job");
+  }
+}
+
+void bench_local_to_model(BenchContext &)
+{
+  // ozz skeletons are limited to 1024 joints, depth 6 would exceed it
+  for (int depth = 2; depth <= RIG_DEPTH; ++depth)
+  {
+    SkeletonPtr skeleton = make_bench_skeleton(depth);
+    auto restPose = skeleton->joint_rest_poses();
+    SoaPose input(restPose.begin(), restPose.end());
+    ModelPose output(skeleton->num_joints());
+
+    ozz::animation::LocalToModelJob localToModelJob;
+    localToModelJob.skeleton = skeleton.get();
+    localToModelJob.input = ozz::make_span(input);
+    localToModelJob.output = ozz::make_span(output);
+
+    const double us = measure_us(2000, [&]() { localToModelJob.Run(); });
+    bench_result("local_to_model", std::to_string(skeleton->num_joints()) + "_joints", us, "us/job");
+  }
+}
+
+void bench_blend_space(BenchContext &)
+{
+  SkeletonPtr skeleton = make_bench_skeleton(2);
+  AnimationPtr animation = make_bench_animation(*skeleton, 1.f, 2);
+
+  for (int nodeCount : {5, 9, 17, 33})
+  {
+    // idle in the center and rings of 8 directions around it, walk ring as in the application, then faster gaits
+    std::vector<AnimationNode2D> nodes;
+    nodes.push_back({animation, {0.f, 0.f}});
+    for (int i = 1; i < nodeCount; ++i)
+    {
+      const int ring = (i - 1) / 8;
+      const float angle = PITWO * (i - 1) / 8 + ring * 0.3f;
+      nodes.push_back({animation, {(ring + 1) * cosf(angle), (ring + 1) * sinf(angle)}});
+    }
+
+    std::unique_ptr<BlendSpace2D> blendSpace;
+    const double constructUs = measure_us(50, [&]() { blendSpace = std::make_unique<BlendSpace2D>(nodes); });
+
+    std::mt19937 rng(11);
+    const float maxParameter = 0.9f * ((nodeCount - 2) / 8 + 1);
+    std::uniform_real_distribution<float> parameter(-maxParameter, maxParameter);
+    const double lookupUs = measure_us(20000, [&]() { blendSpace->set_parameter({parameter(rng), parameter(rng)}); });
+
+    const double collectUs = measure_us(20000, [&]() {
+      FrameVector<WeightedAnimation> animations;
+      blendSpace->update(1.f / 60.f);
+      blendSpace->collect_animations(animations);
+      engine::frame_arena_reset();
+    });
+
+    const std::string name = std::to_string(nodeCount) + "_nodes";
+    bench_result("blend_space_2d", name + "/construct", constructUs, "us");
+    bench_result("blend_space_2d", name + "/set_parameter", lookupUs, "us");
+    bench_result("blend_space_2d", name + "/update_collect", collectUs, "us");
+  }
+}
+
+void bench_skinning(BenchContext &)
+{
+  std::vector<std::string> names;
+  SkeletonPtr skeleton = make_bench_skeleton(RIG_DEPTH, &names);
+
+  SkeletonData skeletonData;
+  skeletonData.names = names;
+  for (size_t i = 0; i < names.size(); ++i)
+    skeletonData.nodesMap[names[i]] = int(i);
+
+  // mesh skinned to every joint of the rig, bone order differs from joint order as in exported meshes
+  std::vector<std::string> boneNames(names.rbegin(), names.rend());
+  std::vector<mat4> inversedBindPose(boneNames.size(), mat4(1.f));
+  std::map<std::string, int> bonesMap;
+  for (size_t i = 0; i < boneNames.size(); ++i)
+    bonesMap[boneNames[i]] = int(i);
+  Mesh mesh("bench_mesh", 0, 0, std::move(inversedBindPose), std::move(boneNames), std::move(bonesMap));
+
+  std::vector<mat4> modelPose(names.size(), mat4(1.f));
+  std::vector<mat4> palette(mesh.inversedBindPose.size());
+  const mat4 transform = glm::translate(mat4(1.f), vec3(1.f, 0.f, 2.f));
+
+  const double us = measure_us(2000, [&]() {
+    build_skinning_palette(mesh, skeletonData, modelPose, transform, palette.data());
+  });
+  bench_result("skinning_palette", std::to_string(palette.size()) + "_bones", us, "us/mesh");
+}
+
+// two leg chains and a look-at chain against the full local to model they would otherwise repeat
+void bench_ik(BenchContext &)
+{
+  SkeletonPtr skeleton = make_bench_skeleton(RIG_DEPTH);
+  AnimationPtr animation = make_bench_animation(*skeleton, 1.f, 31);
+  const int numJoints = skeleton->num_joints();
+
+  Scene scene;
+  scene.groundHeight = [](float x, float /*z*/) { return 0.02f * sinf(x * 3.f) - 0.03f; };
+  Character character;
+  character.transform = mat4(1.f);
+  character.animationContext.setup(skeleton);
+
+  ozz::animation::SamplingJob::Context context(numJoints);
+  ozz::animation::SamplingJob samplingJob;
+  samplingJob.animation = animation.get();
+  samplingJob.context = &context;
+  samplingJob.ratio = 0.3f;
+  samplingJob.output = ozz::make_span(character.animationContext.localTransforms);
+  samplingJob.Run();
+  const SoaPose sampledPose = character.animationContext.localTransforms;
+
+  ozz::animation::LocalToModelJob localToModelJob;
+  localToModelJob.skeleton = skeleton.get();
+  localToModelJob.input = ozz::make_span(character.animationContext.localTransforms);
+  localToModelJob.output = ozz::make_span(character.animationContext.worldTransforms);
+  const double fullUs = measure_us(2000, [&]() {
+    character.animationContext.localTransforms = sampledPose;
+    localToModelJob.Run();
+  });
+
+  // chains end in leaves like real legs and neck do, first and last branch of the rig are legs, a middle one is the neck
+  const auto parents = skeleton->joint_parents();
+  auto add_chain = [&](int end) {
+    character.ik.legs.push_back({parents[parents[end]], parents[end], end, ozz::math::simd_float4::x_axis()});
+  };
+  add_chain(RIG_DEPTH);
+  add_chain(numJoints - 1);
+  AimIkChain aim;
+  const int head = numJoints / 2;
+  aim.joints = {head, parents[head], parents[parents[head]]};
+  aim.target = vec3(1.f, 0.5f, 1.f);
+  character.ik.aims.push_back(aim);
+
+  const double ikUs = measure_us(2000, [&]() {
+    character.animationContext.localTransforms = sampledPose;
+    localToModelJob.Run();
+    apply_character_ik(scene, character);
+  });
+
+  bench_result("ik", std::to_string(numJoints) + "_joints/local_to_model", fullUs, "us/character");
+  bench_result("ik", std::to_string(numJoints) + "_joints/with_2_legs_look_at", ikUs, "us/character");
+}
+
+// crowd playing a 30 second clip with a footstep every half second: edge detection on the contact curve every frame
+// against the sorted events with a cursor per layer, both fire the same events
+void bench_events(BenchContext &)
+{
+  const int characters = 10000;
+  const int curveKeys = 900;
+  const int steps = 60;
+  const int frames = 60;
+  const float frameRatio = 1.f / 60.f / 30.f;
+
+  ozz::animation::offline::RawFloatTrack contact;
+  auto tracks = std::make_shared<AnimationTracks>();
+  tracks->eventNames = {"LeftFoot", "RightFoot"};
+  for (int k = 0; k <= curveKeys; ++k)
+  {
+    const float ratio = float(k) / curveKeys;
+    const float value = 0.5f + 0.6f * cosf(ratio * steps * 2.f * 3.14159265f);
+    contact.keyframes.push_back({ozz::animation::offline::RawTrackInterpolation::kLinear, ratio, value});
+  }
+  const ozz::unique_ptr<ozz::animation::FloatTrack> curve = ozz::animation::offline::TrackBuilder()(contact);
+  // same edges import finds on contact curves
+  std::vector<SyncMarker> markers;
+  add_contact_markers(*curve, 0, markers);
+  for (size_t i = 0; i < markers.size(); ++i)
+    tracks->events.push_back({markers[i].ratio, uint32_t(i % 2)});
+  AnimationTracksPtr tracksPtr = tracks;
+
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  std::vector<float> progress(characters);
+  for (float &p : progress)
+    p = unit(rng);
+
+  size_t triggeringEvents = 0;
+  std::vector<float> triggeringProgress = progress;
+  const double triggeringUs = measure_us(frames, [&]() {
+    for (float &p : triggeringProgress)
+    {
+      ozz::animation::TrackTriggeringJob::Iterator iterator;
+      ozz::animation::TrackTriggeringJob job;
+      job.track = curve.get();
+      job.from = p;
+      job.to = p + frameRatio;
+      job.threshold = 0.5f;
+      job.iterator = &iterator;
+      job.Run();
+      for (; iterator != job.end(); ++iterator)
+        triggeringEvents += iterator->rising;
+      p = job.to < 1.f ? job.to : job.to - 1.f;
+    }
+  });
+
+  size_t cursorEvents = 0;
+  std::vector<AnimationEventCursor> cursors(characters);
+  std::vector<AnimationEvent> events;
+  std::vector<float> cursorProgress = progress;
+  const double cursorUs = measure_us(frames, [&]() {
+    events.clear();
+    for (int i = 0; i < characters; ++i)
+    {
+      float to = cursorProgress[i] + frameRatio;
+      if (to > 1.f)
+        to -= 1.f;
+      trigger_animation_events(tracksPtr, cursorProgress[i], to, 1.f, cursors[i], events);
+      cursorProgress[i] = to;
+    }
+    cursorEvents += events.size();
+  });
+
+  printf("  %d characters, %d curve keys, %zu events per clip, %zu / %zu events fired\n",
+    characters, curveKeys, tracks->events.size(), triggeringEvents, cursorEvents);
+  bench_result("events", std::to_string(characters) + "_characters/triggering_job", triggeringUs, "us/frame");
+  bench_result("events", std::to_string(characters) + "_characters/event_cursor", cursorUs, "us/frame");
+}
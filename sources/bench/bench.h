@@ -0,0 +1,57 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "engine/import/model.h"
+
+// minimal timing helpers for animations_bench, no SDL or GL involved
+
+using bench_clock = std::chrono::high_resolution_clock;
+
+inline double elapsed_ms(bench_clock::time_point from)
+{
+  return std::chrono::duration<double, std::milli>(bench_clock::now() - from).count();
+}
+
+// runs func iterations times and returns average time of one iteration in milliseconds
+template<typename Func>
+double measure_ms(int iterations, Func &&func)
+{
+  bench_clock::time_point start = bench_clock::now();
+  for (int i = 0; i < iterations; ++i)
+    func();
+  return elapsed_ms(start) / iterations;
+}
+
+// same as measure_ms in microseconds, for jobs that take less than a millisecond
+template<typename Func>
+double measure_us(int iterations, Func &&func)
+{
+  return measure_ms(iterations, func) * 1000.0;
+}
+
+// prints result and keeps it for --json output
+void bench_result(const char *stage, const std::string &name, double value, const char *unit);
+
+// state shared between stages, load_model stage fills models for later ones
+struct BenchContext
+{
+  std::string resourcesPath = "resources";
+  std::vector<ModelAsset> models;
+};
+
+// synthetic rig: every joint up to maxDepth has 3 children, joint names are "mixamorig:Joint_NNN"
+SkeletonPtr make_bench_skeleton(int maxDepth, std::vector<std::string> *names = nullptr);
+// clip where every joint rotates, keysPerTrack rotation keys spread over duration
+AnimationPtr make_bench_animation(const ozz::animation::Skeleton &skeleton, float duration, int keysPerTrack, float phase = 0.f);
+
+void bench_import(BenchContext &context);
+void bench_load_model(BenchContext &context);
+void bench_sampling(BenchContext &context);
+void bench_blending(BenchContext &context);
+void bench_local_to_model(BenchContext &context);
+void bench_blend_space(BenchContext &context);
+void bench_skinning(BenchContext &context);
+void bench_ik(BenchContext &context);
+void bench_events(BenchContext &context);
@@ -0,0 +1,171 @@
+#include "bench.h"
+#include "engine/import/model.h"
+#include <assimp/anim.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <vector>
+
+// synthetic rig of depth 5 has 364 joints
+static constexpr int MAX_DEPTH = 5;
+static constexpr int CLIP_COUNT = 32;
+static constexpr int KEYS_PER_CHANNEL = 900; // 30 seconds of 30 fps mocap
+static constexpr double TICKS_PER_SECOND = 30.0;
+
+static aiNodeAnim *make_channel(const std::string &name, int keys, float phase)
+{
+  aiNodeAnim *channel = new aiNodeAnim();
+  channel->mNodeName = aiString(name);
+  channel->mNumPositionKeys = 1;
+  channel->mPositionKeys = new aiVectorKey[1];
+  channel->mPositionKeys[0] = aiVectorKey(0.0, aiVector3D(0.f, 0.1f, 0.f));
+  channel->mNumScalingKeys = 1;
+  channel->mScalingKeys = new aiVectorKey[1];
+  channel->mScalingKeys[0] = aiVectorKey(0.0, aiVector3D(1.f));
+  channel->mNumRotationKeys = keys;
+  channel->mRotationKeys = new aiQuatKey[keys];
+  for (int i = 0; i < keys; ++i)
+  {
+    const float angle = 0.3f * sinf(phase + i * 0.05f);
+    channel->mRotationKeys[i] = aiQuatKey(i, aiQuaternion(cosf(angle), sinf(angle), 0.f, 0.f));
+  }
+  return channel;
+}
+
+// channels come in shuffled order, every 7th joint is missing and a few channels target unknown nodes,
+// as it happens with real mocap exports
+static std::vector<aiAnimation *> make_clip_library(const std::vector<std::string> &names)
+{
+  std::mt19937 rng(42);
+  std::vector<aiAnimation *> clips;
+  for (int c = 0; c < CLIP_COUNT; ++c)
+  {
+    std::vector<aiNodeAnim *> channels;
+    for (size_t j = 0; j < names.size(); ++j)
+      if (j % 7 != 6)
+        channels.push_back(make_channel(names[j], KEYS_PER_CHANNEL, float(j)));
+    for (int j = 0; j < 4; ++j)
+      channels.push_back(make_channel("mixamorig:Extra_" + std::to_string(j), 2, 0.f));
+    std::shuffle(channels.begin(), channels.end(), rng);
+
+    aiAnimation *clip = new aiAnimation();
+    clip->mName = aiString("clip_" + std::to_string(c));
+    clip->mTicksPerSecond = TICKS_PER_SECOND;
+    clip->mDuration = KEYS_PER_CHANNEL - 1;
+    clip->mNumChannels = channels.size();
+    clip->mChannels = new aiNodeAnim *[channels.size()];
+    std::copy(channels.begin(), channels.end(), clip->mChannels);
+    clips.push_back(clip);
+  }
+  return clips;
+}
+
+// previous create_animation behaviour, kept here as the baseline
+static int linear_channel_lookup(const aiAnimation &clip, const ozz::animation::Skeleton &skeleton)
+{
+  int found = 0;
+  for (int k = 0; k < skeleton.num_joints(); ++k)
+  {
+    std::string_view jointName = skeleton.joint_names()[k];
+    for (size_t i = 0; i < clip.mNumChannels; ++i)
+      if (jointName == clip.mChannels[i]->mNodeName.C_Str())
+      {
+        found++;
+        break;
+      }
+  }
+  return found;
+}
+
+static int hashed_channel_lookup(const aiAnimation &clip, const JointNameIndex &jointIndex)
+{
+  int found = 0;
+  for (size_t i = 0; i < clip.mNumChannels; ++i)
+    found += jointIndex.count(std::string_view(clip.mChannels[i]->mNodeName.C_Str())) ? 1 : 0;
+  return found;
+}
+
+void bench_import(BenchContext &)
+{
+  std::vector<std::string> names;
+  SkeletonPtr skeleton = make_bench_skeleton(MAX_DEPTH, &names);
+
+  std::vector<aiAnimation *> clips = make_clip_library(names);
+
+  printf("  %d joints, %d clips, %d keys per channel\n", skeleton->num_joints(), CLIP_COUNT, KEYS_PER_CHANNEL);
+
+  volatile int sink = 0;
+  const double linearMs = measure_ms(10, [&]() {
+    for (const aiAnimation *clip : clips)
+      sink = sink + linear_channel_lookup(*clip, *skeleton);
+  });
+  JointNameIndex jointIndex;
+  const double hashedMs = measure_ms(10, [&]() {
+    jointIndex = build_joint_name_index(*skeleton);
+    for (const aiAnimation *clip : clips)
+      sink = sink + hashed_channel_lookup(*clip, jointIndex);
+  });
+  bench_result("import", "channel_lookup_linear", linearMs, "ms/library");
+  bench_result("import", "channel_lookup_hashed", hashedMs, "ms/library");
+
+  AnimationImportSettings rawSettings;
+  rawSettings.optimize = false;
+
+  std::vector<AnimationPtr> animations;
+  animations.reserve(clips.size());
+  bench_clock::time_point start = bench_clock::now();
+  for (const aiAnimation *clip : clips)
+    animations.push_back(create_animation(clip, skeleton, jointIndex, rawSettings));
+  const double createMs = elapsed_ms(start);
+  bench_result("import", "create_animation", createMs / clips.size(), "ms/clip");
+
+  // keyframe reduction is much slower than import itself, a few clips are enough
+  const int optimizedClips = 4;
+  AnimationImportSettings optimizeSettings;
+  optimizeSettings.chainTolerances = {{"mixamorig:Joint_001", 5e-3f, 1e-1f}};
+  size_t rawSize = 0, optimizedSize = 0;
+  float maxError = 0.f;
+  start = bench_clock::now();
+  for (int i = 0; i < optimizedClips; ++i)
+  {
+    AnimationImportReport report;
+    create_animation(clips[i], skeleton, jointIndex, optimizeSettings, &report);
+    rawSize += report.rawSize;
+    optimizedSize += report.optimizedSize;
+    maxError = std::max(maxError, report.maxError);
+  }
+  const double optimizeMs = elapsed_ms(start);
+  bench_result("import", "create_animation_optimized", optimizeMs / optimizedClips, "ms/clip");
+  bench_result("import", "optimized_size_ratio", double(optimizedSize) / std::max<size_t>(rawSize, 1), "ratio");
+  bench_result("import", "optimized_max_error", maxError * 1000.f, "mm");
+
+  for (aiAnimation *clip : clips)
+    delete clip;
+}
+
+// models the application loads at startup, skipped when resources are not next to the bench
+static const char *BUNDLED_MODELS[] = {
+  "Animations/IPC/MOB1_Stand_Relaxed_Idle_IPC.fbx",
+  "Animations/IPC/MOB1_Walk_F_Loop_IPC.fbx",
+  "sketchfab/ruby.fbx",
+};
+
+void bench_load_model(BenchContext &context)
+{
+  for (const char *model : BUNDLED_MODELS)
+  {
+    const std::string path = context.resourcesPath + "/" + model;
+    struct stat fileStat;
+    if (stat(path.c_str(), &fileStat) != 0)
+    {
+      printf("  %s not found, skipped (use --resources to point at resources folder)\n", path.c_str());
+      continue;
+    }
+    bench_clock::time_point start = bench_clock::now();
+    ModelAsset asset = load_model(path.c_str());
+    bench_result("load_model", model, elapsed_ms(start), "ms");
+    context.models.push_back(std::move(asset));
+  }
+}
@@ -0,0 +1,121 @@
+#include "bench.h"
+#include "engine/api.h"
+#include <algorithm>
+#include <cstring>
+
+struct BenchResult
+{
+  std::string stage;
+  std::string name;
+  double value;
+  std::string unit;
+};
+
+static std::vector<BenchResult> results;
+
+void bench_result(const char *stage, const std::string &name, double value, const char *unit)
+{
+  printf("  %-40s %12.4f %s\n", name.c_str(), value, unit);
+  results.push_back({stage, name, value, unit});
+}
+
+static void write_json_string(FILE *file, const std::string &text)
+{
+  fputc('"', file);
+  for (char c : text)
+  {
+    if (c == '"' || c == '\\')
+      fputc('\\', file);
+    fputc(c, file);
+  }
+  fputc('"', file);
+}
+
+// {"results": [{"stage", "name", "value", "unit"}, ...]}, one result per line to keep diffs readable
+static bool write_json(const char *path)
+{
+  FILE *file = fopen(path, "w");
+  if (!file)
+    return false;
+  fprintf(file, "{\n  \"results\": [\n");
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    const BenchResult &result = results[i];
+    fprintf(file, "    {\"stage\": ");
+    write_json_string(file, result.stage);
+    fprintf(file, ", \"name\": ");
+    write_json_string(file, result.name);
+    fprintf(file, ", \"value\": %.6g, \"unit\": ", result.value);
+    write_json_string(file, result.unit);
+    fprintf(file, "}%s\n", i + 1 < results.size() ? "," : "");
+  }
+  fprintf(file, "  ]\n}\n");
+  fclose(file);
+  return true;
+}
+
+struct BenchStage
+{
+  const char *name;
+  void (*run)(BenchContext &);
+};
+
+// load_model runs before sampling, so bundled clips are sampled too
+static const BenchStage STAGES[] = {
+  {"import", bench_import},
+  {"load_model", bench_load_model},
+  {"sampling", bench_sampling},
+  {"blending", bench_blending},
+  {"local_to_model", bench_local_to_model},
+  {"blend_space_2d", bench_blend_space},
+  {"skinning_palette", bench_skinning},
+  {"ik", bench_ik},
+  {"events", bench_events},
+};
+
+// animations_bench [--json path] [--resources dir] [--stage name]...
+int main(int argc, char **argv)
+{
+  // benchmarks never create GL context
+  engine::set_headless(true);
+
+  BenchContext context;
+  const char *jsonPath = nullptr;
+  std::vector<std::string> selectedStages;
+  for (int i = 1; i < argc; ++i)
+  {
+    const bool hasValue = i + 1 < argc;
+    if (!strcmp(argv[i], "--json") && hasValue)
+      jsonPath = argv[++i];
+    else if (!strcmp(argv[i], "--resources") && hasValue)
+      context.resourcesPath = argv[++i];
+    else if (!strcmp(argv[i], "--stage") && hasValue)
+      selectedStages.push_back(argv[++i]);
+    else
+    {
+      printf("Unknown option \"%s\"\nusage: %s [--json path] [--resources dir] [--stage name]...\n", argv[i], argv[0]);
+      return 1;
+    }
+  }
+
+  for (const BenchStage &stage : STAGES)
+  {
+    if (!selectedStages.empty() && std::find(selectedStages.begin(), selectedStages.end(), stage.name) == selectedStages.end())
+      continue;
+    printf("%s:\n", stage.name);
+    stage.run(context);
+    // stage logs go out before the next stage header
+    engine::flush_log();
+  }
+
+  if (jsonPath)
+  {
+    if (!write_json(jsonPath))
+    {
+      printf("Can't write results to \"%s\"\n", jsonPath);
+      return 1;
+    }
+    printf("%zu results written to \"%s\"\n", results.size(), jsonPath);
+  }
+  return 0;
+}
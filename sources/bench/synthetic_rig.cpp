@@ -0,0 +1,59 @@
+#include "bench.h"
+#include <cmath>
+#include <ozz/animation/offline/animation_builder.h>
+#include <ozz/animation/offline/raw_animation.h>
+#include <ozz/animation/offline/raw_skeleton.h>
+#include <ozz/animation/offline/skeleton_builder.h>
+
+using RawSkeleton = ozz::animation::offline::RawSkeleton;
+using RawAnimation = ozz::animation::offline::RawAnimation;
+
+static void build_joint(RawSkeleton::Joint &joint, std::vector<std::string> &names, int depth, int maxDepth)
+{
+  char name[64];
+  snprintf(name, sizeof(name), "mixamorig:Joint_%03zu", names.size());
+  names.push_back(name);
+  joint.name = name;
+  joint.transform = ozz::math::Transform::identity();
+  joint.transform.translation = ozz::math::Float3(0.f, 0.1f, 0.f);
+
+  if (depth == maxDepth)
+    return;
+  joint.children.resize(3);
+  for (RawSkeleton::Joint &child : joint.children)
+    build_joint(child, names, depth + 1, maxDepth);
+}
+
+SkeletonPtr make_bench_skeleton(int maxDepth, std::vector<std::string> *names)
+{
+  RawSkeleton rawSkeleton;
+  rawSkeleton.roots.resize(1);
+  std::vector<std::string> jointNames;
+  build_joint(rawSkeleton.roots[0], jointNames, 0, maxDepth);
+  if (names)
+    *names = std::move(jointNames);
+
+  ozz::animation::offline::SkeletonBuilder skeletonBuilder;
+  return skeletonBuilder(rawSkeleton);
+}
+
+AnimationPtr make_bench_animation(const ozz::animation::Skeleton &skeleton, float duration, int keysPerTrack, float phase)
+{
+  RawAnimation rawAnimation;
+  rawAnimation.duration = duration;
+  rawAnimation.tracks.resize(skeleton.num_joints());
+  for (int j = 0; j < skeleton.num_joints(); ++j)
+  {
+    RawAnimation::JointTrack &track = rawAnimation.tracks[j];
+    track.translations.push_back({0.f, ozz::math::Float3(0.f, 0.1f, 0.f)});
+    track.scales.push_back({0.f, ozz::math::Float3::one()});
+    for (int k = 0; k < keysPerTrack; ++k)
+    {
+      const float time = keysPerTrack > 1 ? duration * k / (keysPerTrack - 1) : 0.f;
+      const float angle = 0.3f * sinf(phase + j + k * 0.05f);
+      track.rotations.push_back({time, ozz::math::Quaternion(sinf(angle), 0.f, 0.f, cosf(angle))});
+    }
+  }
+  ozz::animation::offline::AnimationBuilder animationBuilder;
+  return animationBuilder(rawAnimation);
+}
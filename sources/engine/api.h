@@ -2,6 +2,7 @@
 #include <SDL2/SDL_keyboard.h>
 #include <SDL2/SDL_events.h>
 #include "engine/event.h"
+#include "engine/log_history.h"
 
 namespace engine
 {
@@ -10,9 +11,45 @@ namespace engine
   // return time in seconds since the start of the program
   float get_time();
 
-  // return delta time in seconds since the last frame
+  // return delta time in seconds since the last frame, fixed step duration during fixed step updates
   float get_delta_time();
 
+  // FRAME PACING //
+
+  enum class FramePacing
+  {
+    Vsync,
+    TargetFps,
+    Uncapped,
+  };
+
+  struct FrameSettings
+  {
+    // game_update runs with fixed dt as many times as accumulated frame time allows
+    bool fixedStep = true;
+    float fixedDeltaTime = 1.f / 60.f;
+    // more steps per frame are dropped, so slow frames don't make next frames even slower
+    int maxStepsPerFrame = 5;
+    FramePacing pacing = FramePacing::Vsync;
+    float targetFps = 60.f;
+    // simulation of the next frame runs on its own thread while the current one is rendered,
+    // adds one frame of latency
+    bool pipelined = true;
+  };
+
+  FrameSettings &get_frame_settings();
+
+  // part of fixed step passed since the last simulated step, 1 without fixed step,
+  // rendering interpolates between previous and current step with it
+  float get_interpolation_alpha();
+
+  // HEADLESS MODE //
+
+  // true when running without window and GL context, GPU uploads and rendering are skipped
+  bool is_headless();
+
+  void set_headless(bool headless);
+
   // WINDOW SUBSYSTEM //
 
   // return aspect ratio of the window
@@ -21,21 +58,35 @@ namespace engine
   // return screen size
   std::pair<int, int> get_screen_size();
 
-  // Event for window resize
+  // Event for window resize, posted with post_latest, so handlers run once per frame with the final drawable size
   extern Event<std::pair<int, int>> onWindowResizedEvent;
 
   // LOGGING SUBSYSTEM //
 
-  // thread safe logging with saving history into ringBuffer
+  // Logging never locks or allocates on the calling thread: message is formatted straight into
+  // a preallocated slot of a lock-free ring, flush thread writes it to console, log file and history.
+  // When the ring is full messages are dropped and counted.
 
   // max number of log messages to keep in history
   const int MAX_LOG_HISTORY = 128;
 
   // log red message into console
   void error(const char *format, ...);
+  void error(LogCategory category, const char *format, ...);
 
   // log white message into console
   void log(const char *format, ...);
+  void log(LogCategory category, const char *format, ...);
+
+  // disabled messages are rejected before formatting
+  void set_log_enabled(LogCategory category, LogType type, bool enabled);
+  bool is_log_enabled(LogCategory category, LogType type);
+
+  // flushed messages are also appended to file at path, nullptr closes it
+  void set_log_file(const char *path);
+
+  // writes all published messages on the calling thread, used before exit and by tools
+  void flush_log();
 
   // INPUT SUBSYSTEM //
 
@@ -47,6 +98,30 @@ namespace engine
   extern Event<SDL_MouseMotionEvent> onMouseMotionEvent;
   // Event for mouse wheel input
   extern Event<SDL_MouseWheelEvent> onMouseWheelEvent;
-  // Return 1 if key is pressed, 0 otherwise
+  // Return 1 if key is pressed, 0 otherwise, keycode is mapped to scancode with current keyboard layout
   float get_key(SDL_Keycode keycode);
+
+  // Key states and edges are bitsets indexed by scancode, so queries are a bit test.
+  // Edges, text and mouse deltas cover input since the previous step, a key pressed and released
+  // within one step is both pressed and released.
+
+  // key is held down
+  bool is_key_down(SDL_Scancode scancode);
+  // key went down since the previous step
+  bool is_key_pressed(SDL_Scancode scancode);
+  // key went up since the previous step
+  bool is_key_released(SDL_Scancode scancode);
+  // UTF-8 text typed since the previous step
+  const char *get_text_input();
+  // sum of mouse motion in pixels since the previous step
+  std::pair<int, int> get_mouse_delta();
+  // sum of vertical wheel scroll since the previous step
+  int get_mouse_wheel();
+
+  // updates input state and triggers input events, used by main loop
+  void dispatch_input_event(const SDL_Event &event);
+  // the two halves of dispatch_input_event: replay playback updates the state on the simulation thread
+  // and triggers events on main thread, handlers may use GL and UI
+  void update_input_state(const SDL_Event &event);
+  void trigger_input_events(const SDL_Event &event);
 } // namespace engine
\ No newline at end of file
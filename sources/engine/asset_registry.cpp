@@ -0,0 +1,228 @@
+#include "engine/asset_registry.h"
+#include "engine/render/mesh.h"
+#include "engine/render/texture2d.h"
+#include <algorithm>
+#include <cstring>
+#include <ozz/animation/runtime/animation.h>
+#include <ozz/animation/runtime/skeleton.h>
+#include <ozz/base/maths/soa_transform.h>
+
+AssetMemory asset_memory(const Mesh &mesh)
+{
+  size_t cpuBytes = sizeof(Mesh) + mesh.inversedBindPose.size() * sizeof(mat4);
+  for (const std::string &name : mesh.boneNames)
+    cpuBytes += name.size() + sizeof(std::string);
+  return {cpuBytes, mesh.gpuMemory};
+}
+
+AssetMemory asset_memory(const Texture2D &texture)
+{
+  return {sizeof(Texture2D), texture.gpuMemory};
+}
+
+AssetMemory asset_memory(const ozz::animation::Skeleton &skeleton)
+{
+  size_t cpuBytes = sizeof(ozz::animation::Skeleton);
+  cpuBytes += skeleton.joint_rest_poses().size_bytes();
+  cpuBytes += skeleton.joint_parents().size_bytes();
+  cpuBytes += skeleton.joint_names().size_bytes();
+  for (const char *name : skeleton.joint_names())
+    cpuBytes += strlen(name) + 1;
+  return {cpuBytes, 0};
+}
+
+AssetMemory asset_memory(const ozz::animation::Animation &animation)
+{
+  return {animation.size(), 0};
+}
+
+static void add_memory(AssetMemory &to, const AssetMemory &memory)
+{
+  to.cpuBytes += memory.cpuBytes;
+  to.gpuBytes += memory.gpuBytes;
+}
+
+static void sub_memory(AssetMemory &from, const AssetMemory &memory)
+{
+  from.cpuBytes -= memory.cpuBytes;
+  from.gpuBytes -= memory.gpuBytes;
+}
+
+std::pair<uint32_t, uint32_t> AssetRegistry::add_entry(std::string &&name, AssetType type, ErasedAsset &&asset, ErasedLoader &&loader)
+{
+  std::unique_lock lock(mutex);
+
+  if (asset.asset)
+  {
+    auto it = entryByAsset.find(asset.asset.get());
+    if (it != entryByAsset.end())
+      return {it->second, entries[it->second].generation};
+  }
+
+  uint32_t index;
+  if (!freeEntries.empty())
+  {
+    index = freeEntries.back();
+    freeEntries.pop_back();
+  }
+  else
+  {
+    index = entries.size();
+    entries.emplace_back();
+  }
+
+  Entry &entry = entries[index];
+  entry.name = std::move(name);
+  entry.type = type;
+  entry.asset = std::move(asset.asset);
+  entry.loader = std::move(loader);
+  entry.memory = asset.memory;
+  entry.lastUsedFrame = frame;
+  entry.alive = true;
+
+  if (entry.asset)
+  {
+    entryByAsset[entry.asset.get()] = index;
+    add_memory(residentMemory[size_t(type)], entry.memory);
+  }
+  return {index, entry.generation};
+}
+
+std::shared_ptr<void> AssetRegistry::acquire_entry(uint32_t index, uint32_t generation)
+{
+  ErasedLoader loader;
+  {
+    std::unique_lock lock(mutex);
+    if (index >= entries.size() || entries[index].generation != generation || !entries[index].alive)
+      return nullptr;
+
+    Entry &entry = entries[index];
+    entry.lastUsedFrame = frame;
+    if (entry.asset || !entry.loader)
+      return entry.asset;
+    loader = entry.loader;
+  }
+
+  // loading can take long, other threads may use registry meanwhile
+  ErasedAsset loaded = loader();
+
+  std::unique_lock lock(mutex);
+  Entry &entry = entries[index];
+  if (entry.generation != generation || !entry.alive)
+    return loaded.asset;
+  fill_entry(index, std::move(loaded));
+  return entry.asset;
+}
+
+void AssetRegistry::restore_entry(uint32_t index, uint32_t generation, ErasedAsset &&asset)
+{
+  std::unique_lock lock(mutex);
+  if (index < entries.size() && entries[index].generation == generation && entries[index].alive)
+    fill_entry(index, std::move(asset));
+}
+
+// evicted entry takes the loaded asset, resident one keeps its own
+void AssetRegistry::fill_entry(uint32_t index, ErasedAsset &&asset)
+{
+  Entry &entry = entries[index];
+  if (entry.asset || !asset.asset)
+    return;
+  entry.asset = std::move(asset.asset);
+  entry.memory = asset.memory;
+  entryByAsset[entry.asset.get()] = index;
+  add_memory(residentMemory[size_t(entry.type)], entry.memory);
+  reloads++;
+}
+
+std::pair<uint32_t, uint32_t> AssetRegistry::find_entry(const void *asset) const
+{
+  std::unique_lock lock(mutex);
+  auto it = entryByAsset.find(asset);
+  if (it == entryByAsset.end())
+    return {~0u, 0};
+  return {it->second, entries[it->second].generation};
+}
+
+void AssetRegistry::remove_entry(uint32_t index, uint32_t generation)
+{
+  std::unique_lock lock(mutex);
+  if (index >= entries.size() || entries[index].generation != generation || !entries[index].alive)
+    return;
+
+  Entry &entry = entries[index];
+  if (entry.asset)
+  {
+    entryByAsset.erase(entry.asset.get());
+    sub_memory(residentMemory[size_t(entry.type)], entry.memory);
+  }
+  entry = Entry{};
+  entry.generation = generation + 1;
+  freeEntries.push_back(index);
+}
+
+void AssetRegistry::set_budget(size_t bytes)
+{
+  std::unique_lock lock(mutex);
+  budget = bytes;
+}
+
+size_t AssetRegistry::get_budget() const
+{
+  std::unique_lock lock(mutex);
+  return budget;
+}
+
+AssetMemory AssetRegistry::resident_memory(AssetType type) const
+{
+  std::unique_lock lock(mutex);
+  return residentMemory[size_t(type)];
+}
+
+void AssetRegistry::evict_over_budget()
+{
+  size_t resident = 0;
+  for (const AssetMemory &memory : residentMemory)
+    resident += memory.cpuBytes + memory.gpuBytes;
+  if (resident <= budget)
+    return;
+
+  // only the registry holds these, so releasing them really frees memory
+  std::vector<uint32_t> candidates;
+  for (uint32_t i = 0; i < entries.size(); ++i)
+  {
+    const Entry &entry = entries[i];
+    if (entry.asset && entry.loader && entry.asset.use_count() == 1)
+      candidates.push_back(i);
+  }
+  std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+    return entries[a].lastUsedFrame < entries[b].lastUsedFrame;
+  });
+
+  for (uint32_t index : candidates)
+  {
+    if (resident <= budget)
+      break;
+    Entry &entry = entries[index];
+    resident -= entry.memory.cpuBytes + entry.memory.gpuBytes;
+    sub_memory(residentMemory[size_t(entry.type)], entry.memory);
+    entryByAsset.erase(entry.asset.get());
+    entry.asset.reset();
+    evictions++;
+  }
+}
+
+void AssetRegistry::update()
+{
+  std::unique_lock lock(mutex);
+  frame++;
+  evict_over_budget();
+}
+
+namespace engine
+{
+  AssetRegistry &get_asset_registry()
+  {
+    static AssetRegistry registry;
+    return registry;
+  }
+}
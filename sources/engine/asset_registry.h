@@ -0,0 +1,180 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+struct Mesh;
+struct Texture2D;
+namespace ozz::animation
+{
+  class Skeleton;
+  class Animation;
+}
+
+enum class AssetType
+{
+  Mesh,
+  Texture,
+  Skeleton,
+  Animation,
+  Count
+};
+
+struct AssetMemory
+{
+  size_t cpuBytes = 0;
+  size_t gpuBytes = 0;
+};
+
+AssetMemory asset_memory(const Mesh &mesh);
+AssetMemory asset_memory(const Texture2D &texture);
+AssetMemory asset_memory(const ozz::animation::Skeleton &skeleton);
+AssetMemory asset_memory(const ozz::animation::Animation &animation);
+
+template<typename T>
+constexpr AssetType asset_type_of()
+{
+  if constexpr (std::is_same_v<T, Mesh>)
+    return AssetType::Mesh;
+  else if constexpr (std::is_same_v<T, Texture2D>)
+    return AssetType::Texture;
+  else if constexpr (std::is_same_v<T, ozz::animation::Skeleton>)
+    return AssetType::Skeleton;
+  else
+  {
+    static_assert(std::is_same_v<T, ozz::animation::Animation>, "unsupported asset type");
+    return AssetType::Animation;
+  }
+}
+
+// Typed reference to a registry entry. Stays valid while the asset is evicted,
+// generation protects from using a handle of a removed entry whose slot was reused.
+template<typename T>
+struct AssetHandle
+{
+  uint32_t index = ~0u;
+  uint32_t generation = 0;
+
+  bool is_valid() const { return index != ~0u; }
+  bool operator==(const AssetHandle &other) const = default;
+};
+
+template<typename T>
+struct std::hash<AssetHandle<T>>
+{
+  size_t operator()(const AssetHandle<T> &handle) const { return std::hash<uint64_t>()(uint64_t(handle.generation) << 32 | handle.index); }
+};
+
+// Owns a strong reference to every registered asset and accounts its CPU and GPU memory.
+// While resident memory is over budget, update() evicts least recently acquired assets that are
+// referenced only by the registry and have a loader, acquire() loads them again on demand.
+class AssetRegistry
+{
+public:
+  template<typename T>
+  using Loader = std::function<std::shared_ptr<T>()>;
+
+  // registering the same asset twice returns the same handle
+  template<typename T>
+  AssetHandle<T> add(std::string name, const std::shared_ptr<T> &asset, Loader<T> loader = nullptr)
+  {
+    ErasedLoader erasedLoader;
+    if (loader)
+      erasedLoader = [loader = std::move(loader)]() -> ErasedAsset {
+        std::shared_ptr<T> loaded = loader();
+        return {loaded, loaded ? asset_memory(*loaded) : AssetMemory{}};
+      };
+    ErasedAsset erased{asset, asset ? asset_memory(*asset) : AssetMemory{}};
+    auto [index, generation] = add_entry(std::move(name), asset_type_of<T>(), std::move(erased), std::move(erasedLoader));
+    return {index, generation};
+  }
+
+  // returns nullptr for invalid handles and assets that failed to load
+  template<typename T>
+  std::shared_ptr<T> acquire(AssetHandle<T> handle)
+  {
+    return std::static_pointer_cast<T>(acquire_entry(handle.index, handle.generation));
+  }
+
+  // Puts an asset loaded along with another one into its evicted entry, so a loader that reads a whole file
+  // restores every evicted asset of it at once. Resident entries keep their asset.
+  template<typename T>
+  void restore(AssetHandle<T> handle, const std::shared_ptr<T> &asset)
+  {
+    if (asset)
+      restore_entry(handle.index, handle.generation, {asset, asset_memory(*asset)});
+  }
+
+  // handle of a resident asset, invalid when the asset isn't registered
+  template<typename T>
+  AssetHandle<T> find(const T *asset) const
+  {
+    auto [index, generation] = find_entry(asset);
+    return {index, generation};
+  }
+
+  template<typename T>
+  void remove(AssetHandle<T> handle)
+  {
+    remove_entry(handle.index, handle.generation);
+  }
+
+  // budget for resident CPU + GPU bytes
+  void set_budget(size_t bytes);
+  size_t get_budget() const;
+
+  // advances LRU clock and evicts assets while over budget, call once per frame
+  void update();
+
+  AssetMemory resident_memory(AssetType type) const;
+
+  void show_imgui();
+
+private:
+  struct ErasedAsset
+  {
+    std::shared_ptr<void> asset;
+    AssetMemory memory;
+  };
+  using ErasedLoader = std::function<ErasedAsset()>;
+
+  struct Entry
+  {
+    std::string name;
+    AssetType type;
+    std::shared_ptr<void> asset;
+    ErasedLoader loader;
+    AssetMemory memory;
+    uint64_t lastUsedFrame = 0;
+    uint32_t generation = 0;
+    bool alive = false;
+  };
+
+  std::pair<uint32_t, uint32_t> add_entry(std::string &&name, AssetType type, ErasedAsset &&asset, ErasedLoader &&loader);
+  std::shared_ptr<void> acquire_entry(uint32_t index, uint32_t generation);
+  void restore_entry(uint32_t index, uint32_t generation, ErasedAsset &&asset);
+  std::pair<uint32_t, uint32_t> find_entry(const void *asset) const;
+  void fill_entry(uint32_t index, ErasedAsset &&asset);
+  void remove_entry(uint32_t index, uint32_t generation);
+  void evict_over_budget();
+
+  mutable std::mutex mutex;
+  std::vector<Entry> entries;
+  std::vector<uint32_t> freeEntries;
+  std::unordered_map<const void *, uint32_t> entryByAsset;
+  AssetMemory residentMemory[size_t(AssetType::Count)];
+  size_t budget = SIZE_MAX;
+  uint64_t frame = 0;
+  uint32_t evictions = 0;
+  uint32_t reloads = 0;
+};
+
+namespace engine
+{
+  AssetRegistry &get_asset_registry();
+}
@@ -0,0 +1,54 @@
+#include "engine/asset_registry.h"
+#include "imgui/imgui.h"
+
+static const char *asset_type_name(AssetType type)
+{
+  switch (type)
+  {
+  case AssetType::Mesh: return "Mesh";
+  case AssetType::Texture: return "Texture";
+  case AssetType::Skeleton: return "Skeleton";
+  case AssetType::Animation: return "Animation";
+  default: return "Unknown";
+  }
+}
+
+void AssetRegistry::show_imgui()
+{
+  if (ImGui::Begin("Assets"))
+  {
+    std::unique_lock lock(mutex);
+
+    const float MB = 1024.f * 1024.f;
+    float budgetMB = budget == SIZE_MAX ? 0.f : budget / MB;
+    if (ImGui::InputFloat("Budget, MB (0 - unlimited)", &budgetMB, 1.f, 16.f, "%.1f"))
+      budget = budgetMB > 0.f ? size_t(budgetMB * MB) : SIZE_MAX;
+    ImGui::Text("Evictions: %u, reloads: %u", evictions, reloads);
+
+    AssetMemory total;
+    for (size_t type = 0; type < size_t(AssetType::Count); ++type)
+    {
+      const AssetMemory &memory = residentMemory[type];
+      total.cpuBytes += memory.cpuBytes;
+      total.gpuBytes += memory.gpuBytes;
+      ImGui::Text("%-10s CPU %8.2f MB  GPU %8.2f MB", asset_type_name(AssetType(type)), memory.cpuBytes / MB, memory.gpuBytes / MB);
+    }
+    ImGui::Text("%-10s CPU %8.2f MB  GPU %8.2f MB", "Total", total.cpuBytes / MB, total.gpuBytes / MB);
+
+    if (ImGui::TreeNode("Residency"))
+    {
+      for (const Entry &entry : entries)
+      {
+        if (!entry.alive)
+          continue;
+        const ImVec4 color = entry.asset ? ImVec4(1, 1, 1, 1) : ImVec4(0.5f, 0.5f, 0.5f, 1);
+        ImGui::TextColored(color, "%s [%s] %s, CPU %.1f KB, GPU %.1f KB, refs %ld, used %llu frames ago",
+          entry.asset ? "resident" : "evicted ", asset_type_name(entry.type), entry.name.c_str(),
+          entry.memory.cpuBytes / 1024.f, entry.memory.gpuBytes / 1024.f,
+          entry.asset ? entry.asset.use_count() - 1 : 0l, (unsigned long long)(frame - entry.lastUsedFrame));
+      }
+      ImGui::TreePop();
+    }
+  }
+  ImGui::End();
+}
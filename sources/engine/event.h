@@ -1,23 +1,260 @@
 #pragma once
 
-#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Callable stored inside the object, captures up to Capacity bytes and never allocates.
+template<typename Signature, size_t Capacity = 4 * sizeof(void *)>
+class InplaceFunction;
+
+template<typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity>
+{
+  alignas(std::max_align_t) unsigned char storage[Capacity];
+  R (*invoker)(void *, Args...) = nullptr;
+  void (*manager)(void *dst, void *src) = nullptr; // moves src into dst, destroys src when dst is null
+
+public:
+  InplaceFunction() = default;
+
+  template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, InplaceFunction>>>
+  InplaceFunction(F &&f)
+  {
+    using Callable = std::decay_t<F>;
+    static_assert(sizeof(Callable) <= Capacity, "handler captures too much, capture a pointer to the state instead");
+    static_assert(alignof(Callable) <= alignof(std::max_align_t), "handler is overaligned");
+    new (storage) Callable(std::forward<F>(f));
+    invoker = [](void *callable, Args... args) -> R { return (*static_cast<Callable *>(callable))(std::forward<Args>(args)...); };
+    manager = [](void *dst, void *src) {
+      if (dst)
+        new (dst) Callable(std::move(*static_cast<Callable *>(src)));
+      static_cast<Callable *>(src)->~Callable();
+    };
+  }
+
+  InplaceFunction(InplaceFunction &&other) noexcept { *this = std::move(other); }
+
+  InplaceFunction &operator=(InplaceFunction &&other) noexcept
+  {
+    if (this == &other)
+      return *this;
+    reset();
+    if (other.manager)
+    {
+      other.manager(storage, other.storage);
+      invoker = other.invoker;
+      manager = other.manager;
+      other.invoker = nullptr;
+      other.manager = nullptr;
+    }
+    return *this;
+  }
+
+  InplaceFunction(const InplaceFunction &) = delete;
+  InplaceFunction &operator=(const InplaceFunction &) = delete;
+
+  ~InplaceFunction() { reset(); }
+
+  void reset()
+  {
+    if (manager)
+      manager(nullptr, storage);
+    invoker = nullptr;
+    manager = nullptr;
+  }
+
+  explicit operator bool() const { return invoker != nullptr; }
+
+  R operator()(Args... args) const
+  {
+    return invoker(const_cast<unsigned char *>(storage), std::forward<Args>(args)...);
+  }
+};
+
+// Returned by subscribe, removes the handler in O(1). Stale tokens are ignored.
+struct EventToken
+{
+  uint32_t index = UINT32_MAX;
+  uint32_t generation = 0;
+};
+
+namespace engine
+{
+  // events with posted values, flushed by flush_deferred_events
+  struct DeferredEvent
+  {
+    void *event;
+    void (*flush)(void *event);
+  };
+  // posting is allowed from any thread, the mutex guards the list and the queues of all events
+  struct DeferredEvents
+  {
+    std::mutex mutex;
+    std::vector<DeferredEvent> events;
+  };
+
+  // every Event touches it in its constructor, so it's destroyed after the last static Event
+  inline DeferredEvents &get_deferred_events()
+  {
+    static DeferredEvents deferredEvents;
+    return deferredEvents;
+  }
+
+  // dispatches all posted events on the main thread, main loop calls it once per frame after input is polled
+  inline void flush_deferred_events()
+  {
+    // handlers may post again, those are dispatched on the next flush
+    std::vector<DeferredEvent> events;
+    {
+      DeferredEvents &deferred = get_deferred_events();
+      std::lock_guard lock(deferred.mutex);
+      events.swap(deferred.events);
+    }
+    for (const DeferredEvent &deferred : events)
+      deferred.flush(deferred.event);
+  }
+}
 
 template<typename T>
 struct Event
 {
-  using Delegate = std::function<void (const T &)>;
-  std::vector<Delegate> callbacks;
+  using Delegate = InplaceFunction<void(const T &)>;
+
+  struct Slot
+  {
+    Delegate delegate;
+    uint32_t generation = 0;
+    bool alive = false;
+  };
+  // deque keeps slots in place, so handlers may subscribe while they are dispatched
+  std::deque<Slot> slots;
+  std::vector<uint32_t> freeSlots;
+  std::vector<uint32_t> pendingRemovals;
+  int dispatchDepth = 0;
+
+  // guarded by the deferred events mutex
+  std::vector<T> queue;
+  bool registered = false;
+
+  Event() { engine::get_deferred_events(); }
+  Event(const Event &) = delete;
+  Event &operator=(const Event &) = delete;
+
+  ~Event()
+  {
+    engine::DeferredEvents &deferred = engine::get_deferred_events();
+    std::lock_guard lock(deferred.mutex);
+    if (registered)
+      std::erase_if(deferred.events, [this](const engine::DeferredEvent &event) { return event.event == this; });
+  }
+
+  EventToken subscribe(Delegate &&delegate)
+  {
+    uint32_t index;
+    if (!freeSlots.empty())
+    {
+      index = freeSlots.back();
+      freeSlots.pop_back();
+    }
+    else
+    {
+      index = uint32_t(slots.size());
+      slots.emplace_back();
+    }
+    Slot &slot = slots[index];
+    slot.delegate = std::move(delegate);
+    slot.alive = true;
+    return EventToken{index, slot.generation};
+  }
+
+  void unsubscribe(EventToken token)
+  {
+    if (token.index >= slots.size())
+      return;
+    Slot &slot = slots[token.index];
+    if (!slot.alive || slot.generation != token.generation)
+      return;
+    slot.alive = false;
+    slot.generation++;
+    // handler may be the one running now, it's destroyed after dispatch
+    if (dispatchDepth > 0)
+      pendingRemovals.push_back(token.index);
+    else
+      release(token.index);
+  }
 
   Event &operator+=(Delegate &&delegate)
   {
-    callbacks.emplace_back(std::move(delegate));
+    subscribe(std::move(delegate));
     return *this;
   }
 
-  void operator()(const T & event) const
+  void operator()(const T &event)
+  {
+    dispatchDepth++;
+    // handlers subscribed during dispatch may miss the current event
+    const size_t count = slots.size();
+    for (size_t i = 0; i < count; ++i)
+      if (slots[i].alive)
+        slots[i].delegate(event);
+    if (--dispatchDepth == 0 && !pendingRemovals.empty())
+      release_pending();
+  }
+
+  // event is dispatched on the main thread at the next engine::flush_deferred_events, safe to call from any thread
+  void post(const T &event) { push_deferred(event, false); }
+
+  // only the last value posted before flush is dispatched, for events like window resize
+  void post_latest(const T &event) { push_deferred(event, true); }
+
+private:
+  void release(uint32_t index)
+  {
+    slots[index].delegate.reset();
+    freeSlots.push_back(index);
+  }
+
+  void release_pending()
+  {
+    for (uint32_t index : pendingRemovals)
+      release(index);
+    pendingRemovals.clear();
+  }
+
+  void push_deferred(const T &value, bool latest)
   {
-    for (const Delegate& delegate : callbacks)
-      delegate(event);
+    engine::DeferredEvents &deferred = engine::get_deferred_events();
+    std::lock_guard lock(deferred.mutex);
+    if (latest)
+      queue.clear();
+    queue.push_back(value);
+    if (registered)
+      return;
+    registered = true;
+    deferred.events.push_back({this, [](void *self) {
+      Event &event = *static_cast<Event *>(self);
+      engine::DeferredEvents &deferred = engine::get_deferred_events();
+      // queue is swapped out, so handlers may post new events while it is dispatched
+      std::vector<T> queue;
+      {
+        std::lock_guard lock(deferred.mutex);
+        event.registered = false;
+        queue.swap(event.queue);
+      }
+      for (const T &value : queue)
+        event(value);
+      // give the storage back to keep posting allocation free
+      queue.clear();
+      std::lock_guard lock(deferred.mutex);
+      if (event.queue.empty())
+        event.queue.swap(queue);
+    }});
   }
 };
 
@@ -26,8 +263,13 @@ struct Event
 // How to use:
 // 1) Define an event:
 // Event<ListenedType> onSomeEvent;
-// 2) Add a listener:
-// onSomeEvent += [](const ListenedType &event) { /* do something */ };
+// 2) Add a listener, keep the token to remove it later:
+// EventToken token = onSomeEvent.subscribe([](const ListenedType &event) { /* do something */ });
 // onSomeEvent += [](const ListenedType &event) { /* do something else */ };
-// 3) Trigger the event:
+// 3) Trigger the event right away:
 // onSomeEvent(event);
+// or queue it until engine::flush_deferred_events, post_latest keeps only the last queued value.
+// Posting is thread safe, subscribing and triggering right away are for the main thread only:
+// onSomeEvent.post(event);
+// 4) Remove the listener:
+// onSomeEvent.unsubscribe(token);
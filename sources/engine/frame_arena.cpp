@@ -0,0 +1,124 @@
+#include "engine/frame_arena.h"
+#include "engine/profiler.h"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <new>
+
+static constexpr size_t FRAME_ARENA_INITIAL_CAPACITY = 256 * 1024;
+static constexpr size_t FRAME_ARENA_BLOCK_ALIGNMENT = 64;
+
+static char *allocate_block(size_t size)
+{
+  return static_cast<char *>(::operator new(size, std::align_val_t(FRAME_ARENA_BLOCK_ALIGNMENT)));
+}
+
+static void free_block(char *data)
+{
+  ::operator delete(data, std::align_val_t(FRAME_ARENA_BLOCK_ALIGNMENT));
+}
+
+FrameArena::FrameArena(size_t capacity)
+{
+  block = {allocate_block(capacity), capacity};
+}
+
+FrameArena::~FrameArena()
+{
+  reset();
+  free_block(block.data);
+}
+
+void *FrameArena::allocate_overflow(size_t size, size_t alignment)
+{
+  // overflow blocks are bump allocated too, a new one is added when the last is full
+  size_t start = overflow.empty() ? 0 : (overflowOffset + alignment - 1) & ~(alignment - 1);
+  if (overflow.empty() || start + size > overflow.back().size)
+  {
+    const size_t blockSize = std::max(size + alignment, block.size);
+    overflow.push_back({allocate_block(blockSize), blockSize});
+    start = 0;
+  }
+  frameBytes += size;
+  overflowOffset = start + size;
+  lastAllocation = nullptr;
+  return overflow.back().data + start;
+}
+
+void FrameArena::rewind(const FrameArenaMarker &marker)
+{
+  peakFrameBytes = std::max(peakFrameBytes, frameBytes);
+  // overflow blocks added since marker are freed, reset grows the main block from the peak anyway
+  for (size_t i = marker.overflowBlocks; i < overflow.size(); ++i)
+    free_block(overflow[i].data);
+  if (overflow.size() > marker.overflowBlocks)
+  {
+    overflow.resize(marker.overflowBlocks);
+    overflowGrown = true;
+  }
+  offset = marker.offset;
+  overflowOffset = marker.overflowOffset;
+  frameBytes = marker.frameBytes;
+  lastAllocation = nullptr;
+}
+
+void FrameArena::reset()
+{
+  peakFrameBytes = std::max(peakFrameBytes, frameBytes);
+  lastFrameBytes = peakFrameBytes;
+  highWaterBytes = std::max(highWaterBytes, peakFrameBytes);
+  if (!overflow.empty() || overflowGrown)
+  {
+    overflowFrames++;
+    for (const Block &extra : overflow)
+      free_block(extra.data);
+    overflow.clear();
+    // next frames of the same size fit into one block
+    free_block(block.data);
+    block.size = std::max(block.size * 2, highWaterBytes + highWaterBytes / 4);
+    block.data = allocate_block(block.size);
+  }
+  offset = 0;
+  overflowOffset = 0;
+  frameBytes = 0;
+  peakFrameBytes = 0;
+  overflowGrown = false;
+  lastAllocation = nullptr;
+}
+
+// arenas are registered once per thread and live until exit, like profiler thread rings
+static std::mutex arenasMutex;
+static std::vector<std::unique_ptr<FrameArena>> arenas;
+static thread_local FrameArena *currentArena = nullptr;
+
+namespace engine
+{
+  FrameArena &frame_arena()
+  {
+    if (!currentArena)
+    {
+      std::unique_lock lock(arenasMutex);
+      currentArena = arenas.emplace_back(std::make_unique<FrameArena>(FRAME_ARENA_INITIAL_CAPACITY)).get();
+    }
+    return *currentArena;
+  }
+
+  void frame_arena_reset()
+  {
+    FrameArena &arena = frame_arena();
+    // stats are read by UI thread, the lock is taken once per frame, never while allocating
+    std::unique_lock lock(arenasMutex);
+    arena.threadName = profiler_thread_name();
+    arena.reset();
+  }
+
+  std::vector<FrameArenaStats> frame_arena_stats()
+  {
+    std::unique_lock lock(arenasMutex);
+    std::vector<FrameArenaStats> stats;
+    stats.reserve(arenas.size());
+    for (const std::unique_ptr<FrameArena> &arena : arenas)
+      stats.push_back({arena->threadName, arena->lastFrameBytes, arena->highWaterBytes, arena->capacity(), arena->overflowFrames});
+    return stats;
+  }
+}
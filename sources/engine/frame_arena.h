@@ -0,0 +1,145 @@
+#pragma once
+#include <cstddef>
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Linear allocator for data that lives no longer than a frame.
+// Every thread bumps a pointer in its own arena, so allocation takes no lock and freeing is a no-op
+// (except the latest allocation, which is rolled back). Reserve containers when the size is known, growth leaves old buffers behind.
+// Owner thread calls engine::frame_arena_reset() at the end of its frame, all memory allocated since is dropped.
+// When a frame doesn't fit, overflow goes to extra blocks and the arena grows to the peak size on reset.
+// Work that repeats many times per frame (per character, per step) rewinds its allocations with FrameArenaScope.
+
+struct FrameArenaStats
+{
+  const char *threadName;
+  size_t lastFrameBytes; // peak use of the previous frame
+  size_t highWaterBytes; // peak of all frames
+  size_t capacityBytes;
+  size_t overflowFrames; // frames that didn't fit into the main block
+};
+
+// allocation state to rewind to, see FrameArenaScope
+struct FrameArenaMarker
+{
+  size_t offset;
+  size_t overflowBlocks;
+  size_t overflowOffset;
+  size_t frameBytes;
+};
+
+class FrameArena;
+
+namespace engine
+{
+  // arena of the calling thread
+  FrameArena &frame_arena();
+  // drops all allocations of the calling thread's arena, call once per frame from its owner
+  void frame_arena_reset();
+
+  std::vector<FrameArenaStats> frame_arena_stats();
+}
+
+class FrameArena
+{
+  struct Block
+  {
+    char *data;
+    size_t size;
+  };
+
+  Block block = {nullptr, 0};
+  size_t offset = 0;
+  std::vector<Block> overflow;
+  size_t overflowOffset = 0;
+  size_t frameBytes = 0;
+  size_t peakFrameBytes = 0; // rewinds lower frameBytes, growth on reset still sees the peak
+  bool overflowGrown = false; // overflow blocks were used and rewound this frame
+  void *lastAllocation = nullptr;
+
+  void *allocate_overflow(size_t size, size_t alignment);
+
+public:
+  // read by stats from other threads, written only by owner in reset
+  const char *threadName = "thread";
+  size_t lastFrameBytes = 0;
+  size_t highWaterBytes = 0;
+  size_t overflowFrames = 0;
+
+  explicit FrameArena(size_t capacity);
+  ~FrameArena();
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  void *allocate(size_t size, size_t alignment)
+  {
+    const size_t start = (offset + alignment - 1) & ~(alignment - 1);
+    if (start + size > block.size)
+      return allocate_overflow(size, alignment);
+    frameBytes += start + size - offset;
+    offset = start + size;
+    return lastAllocation = block.data + start;
+  }
+
+  void deallocate(void *ptr, size_t size)
+  {
+    // only the latest allocation from the main block can be given back
+    if (ptr == lastAllocation && ptr == block.data + offset - size)
+    {
+      peakFrameBytes = std::max(peakFrameBytes, frameBytes);
+      offset -= size;
+      frameBytes -= size;
+      lastAllocation = nullptr;
+    }
+  }
+
+  FrameArenaMarker marker() const
+  {
+    return {offset, overflow.size(), overflowOffset, frameBytes};
+  }
+
+  // drops everything allocated since marker, containers allocated after it must not be used anymore
+  void rewind(const FrameArenaMarker &marker);
+
+  void reset();
+
+  size_t capacity() const { return block.size; }
+};
+
+// rewinds the arena of the calling thread when the scope ends
+struct FrameArenaScope
+{
+  FrameArena &arena;
+  const FrameArenaMarker marker;
+
+  FrameArenaScope() : arena(engine::frame_arena()), marker(arena.marker()) {}
+  ~FrameArenaScope() { arena.rewind(marker); }
+  FrameArenaScope(const FrameArenaScope &) = delete;
+  FrameArenaScope &operator=(const FrameArenaScope &) = delete;
+};
+
+// STL allocator over a frame arena, binds to the arena of the thread that creates it
+template<typename T>
+struct FrameAllocator
+{
+  using value_type = T;
+
+  FrameArena *arena;
+
+  FrameAllocator() : arena(&engine::frame_arena()) {}
+  explicit FrameAllocator(FrameArena &arena) : arena(&arena) {}
+  template<typename U>
+  FrameAllocator(const FrameAllocator<U> &other) : arena(other.arena) {}
+
+  T *allocate(size_t n) { return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T))); }
+  void deallocate(T *ptr, size_t n) { arena->deallocate(ptr, n * sizeof(T)); }
+
+  template<typename U>
+  bool operator==(const FrameAllocator<U> &other) const { return arena == other.arena; }
+};
+
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+using FrameString = std::basic_string<char, std::char_traits<char>, FrameAllocator<char>>;
@@ -0,0 +1,172 @@
+#include "engine/gpu_profiler.h"
+#include "engine/api.h"
+#include "glad/glad.h"
+#include <algorithm>
+
+// frame N queries are read while frame N + GPU_PROFILER_FRAMES - 1 is recorded
+static constexpr int GPU_PROFILER_FRAMES = 3;
+
+struct GpuZone
+{
+  const char *name;
+  uint32_t beginQuery;
+  uint32_t endQuery;
+  uint32_t depth;
+};
+
+struct GpuFrameQueries
+{
+  std::vector<GLuint> queries; // pool grows to the largest frame and is reused
+  uint32_t usedQueries = 0;
+  std::vector<GpuZone> zones;
+  // GPU and CPU clocks sampled together, maps query timestamps to CPU profiler time
+  int64_t gpuSync = 0;
+  uint64_t cpuSync = 0;
+  bool pending = false;
+};
+
+static GpuFrameQueries frames[GPU_PROFILER_FRAMES];
+static int currentSlot = 0;
+static uint32_t zoneDepth = 0;
+static bool available = false;
+static ProfileFrame lastFrame;
+static uint64_t droppedFrames = 0;
+
+static uint32_t next_query(GpuFrameQueries &frame)
+{
+  if (frame.usedQueries == frame.queries.size())
+  {
+    GLuint query;
+    glGenQueries(1, &query);
+    frame.queries.push_back(query);
+  }
+  return frame.usedQueries++;
+}
+
+static void sync_clocks(GpuFrameQueries &frame)
+{
+  GLint64 gpuTime = 0;
+  glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+  frame.gpuSync = gpuTime;
+  frame.cpuSync = engine::profiler_now();
+}
+
+static void resolve_frame(GpuFrameQueries &frame)
+{
+  if (frame.pending && !frame.zones.empty())
+  {
+    // queries finish in submission order, the last one being ready means all are
+    GLint ready = 0;
+    glGetQueryObjectiv(frame.queries[frame.usedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &ready);
+    if (!ready)
+      droppedFrames++;
+    else
+    {
+      auto to_cpu_time = [&](uint32_t query) {
+        GLuint64 timestamp = 0;
+        glGetQueryObjectui64v(frame.queries[query], GL_QUERY_RESULT, &timestamp);
+        return uint64_t(int64_t(frame.cpuSync) + (int64_t(timestamp) - frame.gpuSync));
+      };
+
+      ProfileThreadFrame thread{engine::GPU_PROFILER_THREAD_ID, "GPU", {}};
+      thread.events.reserve(frame.zones.size());
+      for (const GpuZone &zone : frame.zones)
+        thread.events.push_back(ProfileEvent{zone.name, to_cpu_time(zone.beginQuery), to_cpu_time(zone.endQuery), zone.depth});
+
+      lastFrame.start = UINT64_MAX;
+      lastFrame.end = 0;
+      for (const ProfileEvent &event : thread.events)
+      {
+        lastFrame.start = std::min(lastFrame.start, event.start);
+        lastFrame.end = std::max(lastFrame.end, event.end);
+      }
+      engine::profiler_capture_events(thread);
+      lastFrame.threads.clear();
+      lastFrame.threads.push_back(std::move(thread));
+    }
+  }
+  frame.usedQueries = 0;
+  frame.zones.clear();
+  frame.pending = false;
+}
+
+namespace engine
+{
+  void gpu_profiler_init()
+  {
+    available = !is_headless() && (GLAD_GL_VERSION_3_3 || GLAD_GL_ARB_timer_query);
+    if (available)
+    {
+      // implementations may expose queries but have no timer behind them
+      GLint counterBits = 0;
+      glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &counterBits);
+      available = counterBits > 0;
+    }
+    if (!available)
+    {
+      engine::log(LogCategory::Profiler, "GPU timer queries are not supported, GPU profiler is disabled");
+      return;
+    }
+    sync_clocks(frames[currentSlot]);
+  }
+
+  void gpu_profiler_terminate()
+  {
+    for (GpuFrameQueries &frame : frames)
+    {
+      if (!frame.queries.empty())
+        glDeleteQueries(frame.queries.size(), frame.queries.data());
+      frame = GpuFrameQueries{};
+    }
+    available = false;
+  }
+
+  bool gpu_profiler_available()
+  {
+    return available;
+  }
+
+  void gpu_profiler_new_frame()
+  {
+    if (!available)
+      return;
+    frames[currentSlot].pending = true;
+    currentSlot = (currentSlot + 1) % GPU_PROFILER_FRAMES;
+    resolve_frame(frames[currentSlot]);
+    sync_clocks(frames[currentSlot]);
+  }
+
+  const ProfileFrame &gpu_profiler_last_frame()
+  {
+    return lastFrame;
+  }
+
+  uint64_t gpu_profiler_dropped_frames()
+  {
+    return droppedFrames;
+  }
+
+  int gpu_profiler_begin_zone(const char *name)
+  {
+    if (!available)
+      return -1;
+    GpuFrameQueries &frame = frames[currentSlot];
+    const GpuZone zone{name, next_query(frame), 0, zoneDepth++};
+    glQueryCounter(frame.queries[zone.beginQuery], GL_TIMESTAMP);
+    frame.zones.push_back(zone);
+    return int(frame.zones.size()) - 1;
+  }
+
+  void gpu_profiler_end_zone(int zone)
+  {
+    if (zone < 0)
+      return;
+    zoneDepth--;
+    GpuFrameQueries &frame = frames[currentSlot];
+    if (size_t(zone) >= frame.zones.size())
+      return;
+    GpuZone &gpuZone = frame.zones[zone];
+    gpuZone.endQuery = next_query(frame);
+    glQueryCounter(frame.queries[gpuZone.endQuery], GL_TIMESTAMP);
+  }
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "engine/profiler.h"
+
+// GPU profiler based on GL timestamp queries.
+// GPU_PROFILE_ZONE("name") puts a timestamp query at scope begin and end, zones may nest.
+// Queries of a frame are read back GPU_PROFILER_FRAMES - 1 frames later and only when already available,
+// so reading never stalls the pipeline. Without timer query support (or headless) zones do nothing.
+
+namespace engine
+{
+  // pseudo thread id of GPU zones in traces
+  constexpr uint32_t GPU_PROFILER_THREAD_ID = 1000;
+
+  // checks timer query support, call once after GL context creation
+  void gpu_profiler_init();
+  void gpu_profiler_terminate();
+  bool gpu_profiler_available();
+
+  // closes current frame queries and reads back the oldest pending frame, call once per frame
+  void gpu_profiler_new_frame();
+
+  // last resolved GPU frame, times are converted to the CPU profiler clock
+  const ProfileFrame &gpu_profiler_last_frame();
+  // frames whose queries were still not ready when their slot was reused
+  uint64_t gpu_profiler_dropped_frames();
+
+  // used by GpuProfileZone, return index of zone in current frame or -1 when disabled
+  int gpu_profiler_begin_zone(const char *name);
+  void gpu_profiler_end_zone(int zone);
+}
+
+class GpuProfileZone
+{
+  int zone;
+
+public:
+  explicit GpuProfileZone(const char *name) : zone(engine::gpu_profiler_begin_zone(name)) {}
+  ~GpuProfileZone() { engine::gpu_profiler_end_zone(zone); }
+
+  GpuProfileZone(const GpuProfileZone &) = delete;
+  GpuProfileZone &operator=(const GpuProfileZone &) = delete;
+};
+
+#if ENGINE_PROFILER
+#define GPU_PROFILE_ZONE(name) GpuProfileZone PROFILE_CONCAT(gpuProfileZone, __LINE__)(name)
+#else
+#define GPU_PROFILE_ZONE(name) ((void)0)
+#endif
@@ -0,0 +1,16 @@
+#include "engine/api.h"
+
+namespace engine
+{
+  static bool headlessMode = false;
+
+  bool is_headless()
+  {
+    return headlessMode;
+  }
+
+  void set_headless(bool headless)
+  {
+    headlessMode = headless;
+  }
+}
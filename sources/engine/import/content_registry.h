@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+constexpr uint64_t HASH_BYTES_SEED = 14695981039346656037ull;
+
+// 64-bit FNV-1a, identifies imported assets by their content, pass result of the previous call as hash to continue it
+inline uint64_t hash_bytes(const void *data, size_t size, uint64_t hash = HASH_BYTES_SEED)
+{
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// second 64-bit hash with its own multiplier and an xor shift per byte, unrelated to hash_bytes
+inline uint64_t hash_bytes_check(const void *data, size_t size, uint64_t hash)
+{
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash = (hash ^ bytes[i]) * 0x9e3779b97f4a7c15ull;
+    hash ^= hash >> 29;
+  }
+  return hash;
+}
+
+// Content of an asset reduced to two independent hashes. The first finds candidates in ContentRegistry
+// and the second is compared on a hit, so assets are mixed up only if both hashes collide at once.
+// Content itself isn't kept, a copy of every mesh would double its CPU memory.
+class ContentKey
+{
+private:
+  uint64_t contentHash = HASH_BYTES_SEED;
+  uint64_t checkHash = 0;
+
+public:
+  void add_bytes(const void *data, size_t size)
+  {
+    contentHash = hash_bytes(data, size, contentHash);
+    checkHash = hash_bytes_check(data, size, checkHash);
+  }
+
+  // size goes first, so empty and missing channels don't collide with each other
+  template<typename T>
+  void add_span(std::span<const T> values)
+  {
+    const uint64_t size = values.size();
+    add_bytes(&size, sizeof(size));
+    add_bytes(values.data(), values.size_bytes());
+  }
+
+  void add_strings(const std::vector<std::string> &strings)
+  {
+    for (const std::string &s : strings)
+      add_span(std::span<const char>(s));
+  }
+
+  uint64_t hash() const { return contentHash; }
+  bool operator==(const ContentKey &other) const = default;
+};
+
+// Keeps weak references to loaded assets by content, so identical content imported from
+// different files is shared instead of being created twice. Does not keep assets alive,
+// keys are dropped with their assets.
+template<typename T>
+class ContentRegistry
+{
+private:
+  struct Entry
+  {
+    ContentKey key;
+    std::weak_ptr<T> asset;
+  };
+  std::mutex mutex;
+  std::unordered_multimap<uint64_t, Entry> assets;
+
+public:
+  std::shared_ptr<T> find(const ContentKey &key)
+  {
+    std::unique_lock lock(mutex);
+    auto [it, end] = assets.equal_range(key.hash());
+    while (it != end)
+    {
+      std::shared_ptr<T> asset = it->second.asset.lock();
+      if (!asset)
+        it = assets.erase(it);
+      else if (it->second.key == key)
+        return asset;
+      else
+        ++it;
+    }
+    return nullptr;
+  }
+
+  void add(ContentKey &&key, const std::shared_ptr<T> &asset)
+  {
+    std::unique_lock lock(mutex);
+    const uint64_t hash = key.hash();
+    assets.emplace(hash, Entry{std::move(key), asset});
+  }
+};
@@ -2,14 +2,25 @@
 #include "assimp/quaternion.h"
 #include "assimp/vector3.h"
 #include "glm/matrix.hpp"
+#include "ozz/animation/offline/additive_animation_builder.h"
 #include "ozz/animation/offline/animation_builder.h"
+#include "ozz/animation/offline/animation_optimizer.h"
 #include "ozz/animation/offline/raw_animation.h"
+#include "ozz/animation/offline/raw_track.h"
+#include "ozz/animation/offline/track_builder.h"
+#include "ozz/animation/offline/track_optimizer.h"
 #include "ozz/animation/runtime/animation.h"
+#include "ozz/animation/runtime/local_to_model_job.h"
+#include "ozz/animation/runtime/sampling_job.h"
+#include "ozz/animation/runtime/track.h"
+#include "ozz/animation/runtime/track_triggering_job.h"
 #include "ozz/base/maths/soa_transform.h"
 #include "ozz/base/memory/unique_ptr.h"
 #include "render/mesh.h"
+#include <algorithm>
 #include <memory>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 #include <3dmath.h>
 #include <assimp/scene.h>
@@ -26,6 +37,11 @@
 #include <ozz/animation/runtime/skeleton_utils.h>
 
 #include "import/model.h"
+#include "import/content_registry.h"
+
+// meshes and skeletons are shared between models by content, see ContentRegistry
+static ContentRegistry<Mesh> meshRegistry;
+static ContentRegistry<ozz::animation::Skeleton> skeletonRegistry;
 
 MeshPtr create_mesh(const aiMesh *mesh)
 {
@@ -109,7 +125,27 @@ MeshPtr create_mesh(const aiMesh *mesh)
       weights[i] *= 1.f / s;
     }
   }
-  return create_mesh(mesh->mName.C_Str(), indices, vertices, normals, uv, weights, weightsIndex, std::move(inversedBindPose), std::move(boneNames), std::move(bonesMap));
+
+  ContentKey key;
+  key.add_span(std::span<const char>(mesh->mName.C_Str(), mesh->mName.length));
+  key.add_span<uint32_t>(indices);
+  key.add_span<vec3>(vertices);
+  key.add_span<vec3>(normals);
+  key.add_span<vec2>(uv);
+  key.add_span<vec4>(weights);
+  key.add_span<uvec4>(weightsIndex);
+  key.add_span<mat4>(inversedBindPose);
+  key.add_strings(boneNames);
+
+  if (MeshPtr cached = meshRegistry.find(key))
+  {
+    engine::log(LogCategory::Import, "Mesh \"%s\" reused, identical content is already loaded", mesh->mName.C_Str());
+    return cached;
+  }
+
+  MeshPtr result = create_mesh(mesh->mName.C_Str(), indices, vertices, normals, uv, weights, weightsIndex, std::move(inversedBindPose), std::move(boneNames), std::move(bonesMap));
+  meshRegistry.add(std::move(key), result);
+  return result;
 }
 
 using RawSkeleton = ozz::animation::offline::RawSkeleton;
@@ -151,7 +187,345 @@ static void load_skeleton(Joint &joint, SkeletonData &skeleton, const aiNode *no
   }
 }
 
-AnimationPtr create_animation(const aiAnimation *animation, const SkeletonPtr &skeleton)
+JointNameIndex build_joint_name_index(const ozz::animation::Skeleton &skeleton)
+{
+  JointNameIndex index;
+  index.reserve(skeleton.num_joints());
+  auto names = skeleton.joint_names();
+  for (size_t i = 0; i < names.size(); ++i)
+    index.emplace(names[i], int(i));
+  return index;
+}
+
+static ozz::animation::offline::AnimationOptimizer make_optimizer(
+  const ozz::animation::Skeleton &skeleton,
+  const JointNameIndex &jointIndex,
+  const AnimationImportSettings &settings)
+{
+  ozz::animation::offline::AnimationOptimizer optimizer;
+  optimizer.setting = {settings.tolerance, settings.distance};
+
+  std::vector<int> jointChain(skeleton.num_joints(), -1);
+  for (size_t i = 0; i < settings.chainTolerances.size(); ++i)
+  {
+    auto it = jointIndex.find(settings.chainTolerances[i].jointName);
+    if (it == jointIndex.end())
+    {
+      engine::error(LogCategory::Import, "Joint \"%s\" for tolerance override not found", settings.chainTolerances[i].jointName.c_str());
+      continue;
+    }
+    jointChain[it->second] = i;
+  }
+
+  // parents always go before children, so one pass spreads each chain to its whole subtree
+  auto parents = skeleton.joint_parents();
+  for (int i = 0; i < skeleton.num_joints(); ++i)
+  {
+    if (jointChain[i] == -1 && parents[i] != ozz::animation::Skeleton::kNoParent)
+      jointChain[i] = jointChain[parents[i]];
+    if (jointChain[i] != -1)
+    {
+      const JointChainTolerance &chain = settings.chainTolerances[jointChain[i]];
+      optimizer.joints_setting_override[i] = {chain.tolerance, chain.distance};
+    }
+  }
+  return optimizer;
+}
+
+static void sample_model_space(
+  const ozz::animation::Skeleton &skeleton,
+  const ozz::animation::Animation &animation,
+  float ratio,
+  ozz::animation::SamplingJob::Context &context,
+  std::vector<ozz::math::SoaTransform> &locals,
+  std::vector<ozz::math::Float4x4> &models)
+{
+  ozz::animation::SamplingJob samplingJob;
+  samplingJob.animation = &animation;
+  samplingJob.context = &context;
+  samplingJob.ratio = ratio;
+  samplingJob.output = ozz::make_span(locals);
+  const bool sampled = samplingJob.Run();
+  assert(sampled);
+
+  ozz::animation::LocalToModelJob localToModelJob;
+  localToModelJob.skeleton = &skeleton;
+  localToModelJob.input = ozz::make_span(locals);
+  localToModelJob.output = ozz::make_span(models);
+  const bool converted = localToModelJob.Run();
+  assert(converted);
+}
+
+// compares model space joint positions, so error accumulated along the hierarchy is accounted
+static void measure_optimization_error(
+  const ozz::animation::Skeleton &skeleton,
+  const ozz::animation::Animation &reference,
+  const ozz::animation::Animation &optimized,
+  AnimationImportReport &report)
+{
+  const float sampleRate = 30.f;
+  std::vector<ozz::math::SoaTransform> locals(skeleton.num_soa_joints());
+  std::vector<ozz::math::Float4x4> referenceModels(skeleton.num_joints());
+  std::vector<ozz::math::Float4x4> optimizedModels(skeleton.num_joints());
+  ozz::animation::SamplingJob::Context referenceContext(skeleton.num_joints());
+  ozz::animation::SamplingJob::Context optimizedContext(skeleton.num_joints());
+
+  const int numSamples = std::max(2, int(reference.duration() * sampleRate) + 1);
+  for (int s = 0; s < numSamples; ++s)
+  {
+    const float ratio = float(s) / (numSamples - 1);
+    sample_model_space(skeleton, reference, ratio, referenceContext, locals, referenceModels);
+    sample_model_space(skeleton, optimized, ratio, optimizedContext, locals, optimizedModels);
+
+    for (int j = 0; j < skeleton.num_joints(); ++j)
+    {
+      const ozz::math::SimdFloat4 diff = referenceModels[j].cols[3] - optimizedModels[j].cols[3];
+      const float error = ozz::math::GetX(ozz::math::Length3(diff));
+      if (error > report.maxError)
+      {
+        report.maxError = error;
+        report.maxErrorJoint = j;
+      }
+    }
+  }
+}
+
+static int find_root_motion_joint(
+  const ozz::animation::offline::RawAnimation &rawAnimation,
+  const JointNameIndex &jointIndex,
+  const AnimationImportSettings &settings)
+{
+  if (!settings.rootMotionJoint.empty())
+  {
+    auto it = jointIndex.find(settings.rootMotionJoint);
+    if (it == jointIndex.end())
+      engine::error(LogCategory::Import, "Root motion joint \"%s\" not found", settings.rootMotionJoint.c_str());
+    return it != jointIndex.end() ? it->second : -1;
+  }
+  for (size_t i = 0; i < rawAnimation.tracks.size(); ++i)
+    if (rawAnimation.tracks[i].translations.size() > 1)
+      return i;
+  return -1;
+}
+
+// Samples model space position of the root joint at its own keys, stores horizontal displacement from the first frame
+// in a track and removes the same displacement from the joint keys, so the clip plays in place.
+// Vertical motion (bobbing, crouching) stays in the clip.
+static RootMotionPtr extract_root_motion(
+  ozz::animation::offline::RawAnimation &rawAnimation,
+  const ozz::animation::Skeleton &skeleton,
+  const JointNameIndex &jointIndex,
+  const AnimationImportSettings &settings)
+{
+  const int root = find_root_motion_joint(rawAnimation, jointIndex, settings);
+  if (root < 0 || rawAnimation.duration <= 0.f)
+    return nullptr;
+
+  ozz::animation::offline::AnimationBuilder builder;
+  const ozz::unique_ptr<ozz::animation::Animation> reference = builder(rawAnimation);
+  std::vector<ozz::math::SoaTransform> locals(skeleton.num_soa_joints());
+  std::vector<ozz::math::Float4x4> models(skeleton.num_joints());
+  ozz::animation::SamplingJob::Context context(skeleton.num_joints());
+
+  const int parent = skeleton.joint_parents()[root];
+  ozz::math::SimdFloat4 start = ozz::math::simd_float4::zero();
+  ozz::animation::offline::RawFloat3Track rawTrack;
+  for (auto &key : rawAnimation.tracks[root].translations)
+  {
+    const float ratio = key.time / rawAnimation.duration;
+    sample_model_space(skeleton, *reference, ratio, context, locals, models);
+    if (rawTrack.keyframes.empty())
+      start = models[root].cols[3];
+
+    ozz::math::SimdFloat4 delta = models[root].cols[3] - start;
+    delta = ozz::math::SetY(delta, ozz::math::simd_float4::zero());
+    // keys at the same time are the ends of a step, the first of them is kept in the track
+    if (rawTrack.keyframes.empty() || ratio > rawTrack.keyframes.back().ratio)
+    {
+      ozz::math::Float3 value;
+      ozz::math::Store3PtrU(delta, &value.x);
+      rawTrack.keyframes.push_back({ozz::animation::offline::RawTrackInterpolation::kLinear, ratio, value});
+    }
+
+    // joint key is in parent space, which may be rotated and scaled relative to model space
+    if (parent != ozz::animation::Skeleton::kNoParent)
+      delta = ozz::math::TransformVector(ozz::math::Invert(models[parent]), delta);
+    ozz::math::Float3 localDelta;
+    ozz::math::Store3PtrU(delta, &localDelta.x);
+    key.value = key.value - localDelta;
+  }
+
+  ozz::animation::offline::RawFloat3Track optimizedTrack;
+  ozz::animation::offline::TrackOptimizer optimizer;
+  optimizer.tolerance = settings.tolerance;
+  if (!settings.optimize || !optimizer(rawTrack, &optimizedTrack))
+    optimizedTrack = std::move(rawTrack);
+
+  ozz::animation::offline::TrackBuilder trackBuilder;
+  RootMotionPtr rootMotion = trackBuilder(optimizedTrack);
+  if (!rootMotion)
+    engine::error(LogCategory::Import, "Can't build root motion track of \"%s\"", rawAnimation.name.c_str());
+  return rootMotion;
+}
+
+SyncTrackPtr make_sync_track(std::span<const SyncMarker> markers)
+{
+  if (markers.empty())
+    return nullptr;
+
+  std::vector<SyncMarker> sorted(markers.begin(), markers.end());
+  std::sort(sorted.begin(), sorted.end(), [](const SyncMarker &a, const SyncMarker &b) { return a.ratio < b.ratio; });
+  const int count = sorted.size();
+
+  // phase 0 is the first marker with the lowest id, so clips starting on different feet still line up
+  int first = 0;
+  for (int i = 1; i < count; ++i)
+    if (sorted[i].id < sorted[first].id)
+      first = i;
+
+  // phase at ratio 0 lies between the last marker of the previous loop and the first one
+  const float gap = sorted[0].ratio + 1.f - sorted[count - 1].ratio;
+  const float startPhase = float(-1 - first) + (1.f - sorted[count - 1].ratio) / gap;
+
+  using ozz::animation::offline::RawTrackInterpolation;
+  ozz::animation::offline::RawFloatTrack rawTrack;
+  rawTrack.keyframes.push_back({RawTrackInterpolation::kLinear, 0.f, startPhase});
+  for (int i = 0; i < count; ++i)
+    if (sorted[i].ratio > rawTrack.keyframes.back().ratio && sorted[i].ratio < 1.f)
+      rawTrack.keyframes.push_back({RawTrackInterpolation::kLinear, sorted[i].ratio, float(i - first)});
+  rawTrack.keyframes.push_back({RawTrackInterpolation::kLinear, 1.f, startPhase + count});
+
+  ozz::animation::offline::TrackBuilder builder;
+  SyncTrackPtr track = builder(rawTrack);
+  return track;
+}
+
+void add_contact_markers(const ozz::animation::FloatTrack &contact, int id, std::vector<SyncMarker> &markers)
+{
+  ozz::animation::TrackTriggeringJob::Iterator iterator;
+  ozz::animation::TrackTriggeringJob triggeringJob;
+  triggeringJob.track = &contact;
+  triggeringJob.from = 0.f;
+  triggeringJob.to = 1.f;
+  triggeringJob.threshold = 0.5f;
+  triggeringJob.iterator = &iterator;
+  if (!triggeringJob.Run())
+    return;
+
+  for (; iterator != triggeringJob.end(); ++iterator)
+    if (iterator->rising)
+      markers.push_back({iterator->ratio < 1.f ? iterator->ratio : 0.f, id});
+}
+
+// settings may omit the rig prefix of joint names
+static int find_joint_by_name_or_suffix(const ozz::animation::Skeleton &skeleton, const JointNameIndex &jointIndex, std::string_view name)
+{
+  auto it = jointIndex.find(name);
+  if (it != jointIndex.end())
+    return it->second;
+  auto names = skeleton.joint_names();
+  for (size_t i = 0; i < names.size(); ++i)
+    if (std::string_view(names[i]).ends_with(name))
+      return i;
+  return -1;
+}
+
+// Foot contact heuristic: a foot is planted while its model space height is in the lowest fifth of its range over the clip.
+// Height is remapped to a contact curve that crosses 0.5 at the same ratios, so detected and authored contacts
+// go through the same edge detection. With tracks, contact curves and foot plant events are kept for playback.
+static SyncTrackPtr detect_foot_contacts(
+  const ozz::animation::offline::RawAnimation &rawAnimation,
+  const ozz::animation::Skeleton &skeleton,
+  const JointNameIndex &jointIndex,
+  const AnimationImportSettings &settings,
+  AnimationTracks *tracks)
+{
+  std::vector<int> feet;
+  for (const std::string &name : settings.syncMarkerJoints)
+  {
+    const int joint = find_joint_by_name_or_suffix(skeleton, jointIndex, name);
+    if (joint < 0)
+    {
+      engine::error(LogCategory::Import, "Sync marker joint \"%s\" not found", name.c_str());
+      return nullptr;
+    }
+    feet.push_back(joint);
+  }
+
+  ozz::animation::offline::AnimationBuilder builder;
+  const ozz::unique_ptr<ozz::animation::Animation> animation = builder(rawAnimation);
+  std::vector<ozz::math::SoaTransform> locals(skeleton.num_soa_joints());
+  std::vector<ozz::math::Float4x4> models(skeleton.num_joints());
+  ozz::animation::SamplingJob::Context context(skeleton.num_joints());
+
+  const float sampleRate = 30.f;
+  const int numSamples = std::max(8, int(rawAnimation.duration * sampleRate));
+  std::vector<float> heights(feet.size() * (numSamples + 1));
+  for (int s = 0; s <= numSamples; ++s)
+  {
+    sample_model_space(skeleton, *animation, float(s) / numSamples, context, locals, models);
+    for (size_t f = 0; f < feet.size(); ++f)
+      heights[f * (numSamples + 1) + s] = ozz::math::GetY(models[feet[f]].cols[3]);
+  }
+
+  std::vector<SyncMarker> markers;
+  for (size_t f = 0; f < feet.size(); ++f)
+  {
+    const auto footHeights = std::span(heights).subspan(f * (numSamples + 1), numSamples + 1);
+    const auto [minHeight, maxHeight] = std::minmax_element(footHeights.begin(), footHeights.end());
+    const float range = *maxHeight - *minHeight;
+    // foot never leaves the ground
+    if (range < 1e-3f)
+      continue;
+    const float threshold = *minHeight + 0.2f * range;
+
+    ozz::animation::offline::RawFloatTrack contact;
+    for (int s = 0; s <= numSamples; ++s)
+      contact.keyframes.push_back({ozz::animation::offline::RawTrackInterpolation::kLinear, float(s) / numSamples,
+        0.5f + (threshold - footHeights[s]) / range});
+    ozz::animation::offline::TrackBuilder trackBuilder;
+    const ozz::unique_ptr<ozz::animation::FloatTrack> contactTrack = trackBuilder(contact);
+    if (!contactTrack)
+      continue;
+    const size_t footMarkers = markers.size();
+    add_contact_markers(*contactTrack, f, markers);
+
+    if (tracks)
+    {
+      const std::string &name = settings.syncMarkerJoints[f];
+      const uint32_t eventName = tracks->eventNames.size();
+      tracks->eventNames.push_back(name);
+      for (size_t m = footMarkers; m < markers.size(); ++m)
+        tracks->events.push_back({markers[m].ratio, eventName});
+
+      // kept curve is a planted weight: 1 at the lowest height, 0.5 at the threshold, 0 in the air
+      ozz::animation::offline::RawFloatTrack planted;
+      for (int s = 0; s <= numSamples; ++s)
+        planted.keyframes.push_back({ozz::animation::offline::RawTrackInterpolation::kLinear, float(s) / numSamples,
+          std::clamp(0.5f + 0.5f * (threshold - footHeights[s]) / (threshold - *minHeight), 0.f, 1.f)});
+      ozz::animation::offline::RawFloatTrack optimizedPlanted;
+      ozz::animation::offline::TrackOptimizer optimizer;
+      if (!optimizer(planted, &optimizedPlanted))
+        optimizedPlanted = std::move(planted);
+      tracks->curves.push_back({name, trackBuilder(optimizedPlanted)});
+    }
+  }
+
+  if (markers.empty())
+    engine::log(LogCategory::Import, "No foot contacts found in \"%s\", clip has no sync markers", rawAnimation.name.c_str());
+  return make_sync_track(markers);
+}
+
+AnimationPtr create_animation(
+  const aiAnimation *animation,
+  const SkeletonPtr &skeleton,
+  const JointNameIndex &jointIndex,
+  const AnimationImportSettings &settings,
+  AnimationImportReport *report,
+  AnimationPtr *outRawAnimation,
+  RootMotionPtr *outRootMotion,
+  SyncTrackPtr *outSyncTrack,
+  AnimationTracksPtr *outTracks)
 {
   ozz::animation::offline::RawAnimation rawAnimation;
 
@@ -159,19 +533,18 @@ AnimationPtr create_animation(const aiAnimation *animation, const SkeletonPtr &s
   rawAnimation.duration = animation->mDuration / animation->mTicksPerSecond;
   rawAnimation.tracks.resize(skeleton->num_joints());
 
+  // one hash lookup per channel instead of scanning all channels for every joint
+  std::vector<int> jointChannels(skeleton->num_joints(), -1);
+  for (size_t i = 0; i < animation->mNumChannels; ++i)
+  {
+    auto it = jointIndex.find(std::string_view(animation->mChannels[i]->mNodeName.C_Str()));
+    if (it != jointIndex.end() && jointChannels[it->second] == -1)
+      jointChannels[it->second] = i;
+  }
+
   for (size_t k = 0; k < skeleton->num_joints(); ++k)
   {
-    std::string_view jointName = skeleton->joint_names()[k];
-    int channelIdx = -1;
-    for (size_t i = 0; i < animation->mNumChannels; ++i)
-    {
-      const aiNodeAnim &channel = *animation->mChannels[i];
-      if (jointName == channel.mNodeName.C_Str())
-      {
-        channelIdx = i;
-        break;
-      }
-    }
+    const int channelIdx = jointChannels[k];
 
     ozz::animation::offline::RawAnimation::JointTrack &track = rawAnimation.tracks[k];
 
@@ -237,15 +610,130 @@ AnimationPtr create_animation(const aiAnimation *animation, const SkeletonPtr &s
 
   assert(rawAnimation.Validate());
 
+  auto tracks = std::make_shared<AnimationTracks>();
+  for (const AnimationEventSettings &event : settings.events)
+  {
+    if (!event.clip.empty() && event.clip != rawAnimation.name.c_str())
+      continue;
+    auto name = std::find(tracks->eventNames.begin(), tracks->eventNames.end(), event.name);
+    if (name == tracks->eventNames.end())
+      name = tracks->eventNames.insert(name, event.name);
+    const float ratio = rawAnimation.duration > 0.f ? std::clamp(event.time / rawAnimation.duration, 0.f, 1.f) : 0.f;
+    tracks->events.push_back({ratio, uint32_t(name - tracks->eventNames.begin())});
+  }
+
+  // additive clips are deltas on top of a pose that already moves, they have no root motion or contacts of their own
+  if (settings.additive == AdditiveReference::None)
+  {
+    if (settings.extractRootMotion)
+    {
+      RootMotionPtr rootMotion = extract_root_motion(rawAnimation, *skeleton, jointIndex, settings);
+      if (outRootMotion)
+        *outRootMotion = std::move(rootMotion);
+    }
+    if (!settings.syncMarkerJoints.empty())
+    {
+      SyncTrackPtr syncTrack = detect_foot_contacts(rawAnimation, *skeleton, jointIndex, settings,
+        settings.contactTracks ? tracks.get() : nullptr);
+      if (outSyncTrack)
+        *outSyncTrack = std::move(syncTrack);
+    }
+  }
+
+  std::stable_sort(tracks->events.begin(), tracks->events.end(),
+    [](const AnimationEventKey &a, const AnimationEventKey &b) { return a.ratio < b.ratio; });
+  if (outTracks && (!tracks->curves.empty() || !tracks->events.empty()))
+    *outTracks = std::move(tracks);
+
+  // optimizer and error measurement below work on deltas the same way as on regular keys
+  if (settings.additive != AdditiveReference::None)
+  {
+    ozz::animation::offline::AdditiveAnimationBuilder additiveBuilder;
+    ozz::animation::offline::RawAnimation additiveAnimation;
+    bool built;
+    if (settings.additive == AdditiveReference::RestPose)
+    {
+      std::vector<ozz::math::Transform> restPose(skeleton->num_joints());
+      for (int i = 0; i < skeleton->num_joints(); ++i)
+        restPose[i] = ozz::animation::GetJointLocalRestPose(*skeleton, i);
+      built = additiveBuilder(rawAnimation, ozz::make_span(restPose), &additiveAnimation);
+    }
+    else
+      built = additiveBuilder(rawAnimation, &additiveAnimation);
+    if (built)
+      rawAnimation = std::move(additiveAnimation);
+    else
+      engine::error(LogCategory::Import, "Can't build additive animation \"%s\", imported as regular", animation->mName.C_Str());
+  }
+
   ozz::animation::offline::AnimationBuilder builder;
-  std::shared_ptr<ozz::animation::Animation> resAnimation = builder(rawAnimation);
+  std::shared_ptr<ozz::animation::Animation> resAnimation;
+  AnimationImportReport clipReport;
+  clipReport.name = animation->mName.C_Str();
+
+  if (settings.optimize)
+  {
+    std::shared_ptr<ozz::animation::Animation> unoptimized = builder(rawAnimation);
+
+    ozz::animation::offline::RawAnimation optimizedRawAnimation;
+    const ozz::animation::offline::AnimationOptimizer optimizer = make_optimizer(*skeleton, jointIndex, settings);
+    const bool optimized = optimizer(rawAnimation, *skeleton, &optimizedRawAnimation);
+    assert(optimized);
+    resAnimation = builder(optimizedRawAnimation);
+
+    clipReport.rawSize = unoptimized->size();
+    clipReport.optimizedSize = resAnimation->size();
+    measure_optimization_error(*skeleton, *unoptimized, *resAnimation, clipReport);
+
+    engine::log(LogCategory::Import, "Animation \"%s\" loaded, optimized %zu -> %zu bytes, max error %.2f mm at joint \"%s\"",
+      animation->mName.C_Str(), clipReport.rawSize, clipReport.optimizedSize, clipReport.maxError * 1000.f,
+      clipReport.maxErrorJoint >= 0 ? skeleton->joint_names()[clipReport.maxErrorJoint] : "-");
+
+    if (outRawAnimation)
+      *outRawAnimation = std::move(unoptimized);
+  }
+  else
+  {
+    resAnimation = builder(rawAnimation);
+    clipReport.rawSize = clipReport.optimizedSize = resAnimation->size();
+
+    engine::log(LogCategory::Import, "Animation \"%s\" loaded", animation->mName.C_Str());
+
+    if (outRawAnimation)
+      *outRawAnimation = resAnimation;
+  }
 
-  engine::log("Animation \"%s\" loaded", animation->mName.C_Str());
+  if (report)
+    *report = std::move(clipReport);
 
   return resAnimation;
 }
 
-ModelAsset load_model(const char *path)
+static void import_animations(const aiScene *scene, const SkeletonPtr &skeleton, const AnimationImportSettings &settings, ModelAsset &model)
+{
+  const JointNameIndex jointIndex = build_joint_name_index(*skeleton);
+  model.animations.resize(scene->mNumAnimations);
+  model.animationReports.resize(scene->mNumAnimations);
+  if (settings.keepRawAnimations)
+    model.rawAnimations.resize(scene->mNumAnimations);
+  if (settings.extractRootMotion)
+    model.rootMotions.resize(scene->mNumAnimations);
+  if (!settings.syncMarkerJoints.empty())
+    model.syncTracks.resize(scene->mNumAnimations);
+  const bool hasTracks = settings.contactTracks || !settings.events.empty();
+  if (hasTracks)
+    model.tracks.resize(scene->mNumAnimations);
+  for (uint32_t i = 0; i < scene->mNumAnimations; i++)
+  {
+    model.animations[i] = create_animation(scene->mAnimations[i], skeleton, jointIndex, settings,
+      &model.animationReports[i], settings.keepRawAnimations ? &model.rawAnimations[i] : nullptr,
+      settings.extractRootMotion ? &model.rootMotions[i] : nullptr,
+      !settings.syncMarkerJoints.empty() ? &model.syncTracks[i] : nullptr,
+      hasTracks ? &model.tracks[i] : nullptr);
+  }
+}
+
+ModelAsset load_model(const char *path, const AnimationImportSettings &settings)
 {
 
   Assimp::Importer importer;
@@ -264,7 +752,7 @@ ModelAsset load_model(const char *path)
   model.path = path;
   if (!scene)
   {
-    engine::error("Filed to read model file \"%s\"", path);
+    engine::error(LogCategory::Import, "Failed to read model file \"%s\"", path);
     return model;
   }
 
@@ -274,8 +762,17 @@ ModelAsset load_model(const char *path)
   load_skeleton(rawSkeleton.roots[0], model.skeleton, scene->mRootNode, -1, 0);
   assert(rawSkeleton.Validate());
 
-  ozz::animation::offline::SkeletonBuilder builder;
-  model.skeleton.ozzSkeleton = builder(rawSkeleton);
+  ContentKey skeletonKey;
+  skeletonKey.add_strings(model.skeleton.names);
+  skeletonKey.add_span<int>(model.skeleton.parents);
+  skeletonKey.add_span<mat4>(model.skeleton.localTransforms);
+  model.skeleton.ozzSkeleton = skeletonRegistry.find(skeletonKey);
+  if (!model.skeleton.ozzSkeleton)
+  {
+    ozz::animation::offline::SkeletonBuilder builder;
+    model.skeleton.ozzSkeleton = builder(rawSkeleton);
+    skeletonRegistry.add(std::move(skeletonKey), model.skeleton.ozzSkeleton);
+  }
 
   model.meshes.resize(scene->mNumMeshes);
   for (uint32_t i = 0; i < scene->mNumMeshes; i++)
@@ -283,12 +780,69 @@ ModelAsset load_model(const char *path)
     model.meshes[i] = create_mesh(scene->mMeshes[i]);
   }
 
-  model.animations.resize(scene->mNumAnimations);
-  for (uint32_t i = 0; i < scene->mNumAnimations; i++)
+  import_animations(scene, model.skeleton.ozzSkeleton, settings, model);
+
+  engine::log(LogCategory::Import, "Model \"%s\" loaded", path);
+  return model;
+}
+
+ModelAsset load_animations(const char *path, const SkeletonPtr &skeleton, const AnimationImportSettings &settings)
+{
+  Assimp::Importer importer;
+  importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_PRESERVE_PIVOTS, false);
+  importer.SetPropertyFloat(AI_CONFIG_GLOBAL_SCALE_FACTOR_KEY, 1.f);
+  importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_READ_MATERIALS, false);
+  importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_READ_TEXTURES, false);
+
+  // only steps that change animation keys, mesh processing is skipped along with the meshes
+  importer.ReadFile(path, aiPostProcessSteps::aiProcess_GlobalScale);
+
+  const aiScene *scene = importer.GetScene();
+  ModelAsset model;
+  model.path = path;
+  model.skeleton.ozzSkeleton = skeleton;
+  if (!scene)
   {
-    model.animations[i] = create_animation(scene->mAnimations[i], model.skeleton.ozzSkeleton);
+    engine::error(LogCategory::Import, "Failed to read animation file \"%s\"", path);
+    return model;
   }
 
-  engine::log("Model \"%s\" loaded", path);
+  import_animations(scene, skeleton, settings, model);
+
+  engine::log(LogCategory::Import, "Animations \"%s\" loaded onto shared skeleton", path);
   return model;
-}
\ No newline at end of file
+}
+
+void register_model_assets(ModelAsset &model, const AnimationImportSettings &settings)
+{
+  AssetRegistry &registry = engine::get_asset_registry();
+
+  for (const MeshPtr &mesh : model.meshes)
+    registry.add(model.path + ":" + mesh->name, mesh);
+
+  const SkeletonPtr &skeleton = model.skeleton.ozzSkeleton;
+  if (skeleton)
+    registry.add(model.path, skeleton);
+
+  // raw clips are for debug comparison only, evicted clips come back optimized
+  AnimationImportSettings reloadSettings = settings;
+  reloadSettings.keepRawAnimations = false;
+
+  // one reload imports the whole file, so it restores every evicted clip of it, not only the acquired one
+  auto handles = std::make_shared<std::vector<AnimationHandle>>(model.animations.size());
+  for (size_t i = 0; i < model.animations.size(); ++i)
+  {
+    const std::string name = i < model.animationReports.size() ? model.animationReports[i].name : std::to_string(i);
+    AssetRegistry::Loader<ozz::animation::Animation> loader = [path = model.path, skeleton, reloadSettings, handles, i]() -> AnimationPtr {
+      ModelAsset reloaded = load_animations(path.c_str(), skeleton, reloadSettings);
+      AssetRegistry &registry = engine::get_asset_registry();
+      for (size_t j = 0; j < reloaded.animations.size() && j < handles->size(); ++j)
+        if (j != i)
+          registry.restore((*handles)[j], reloaded.animations[j]);
+      return i < reloaded.animations.size() ? reloaded.animations[i] : nullptr;
+    };
+    (*handles)[i] = registry.add(model.path + ":" + name, model.animations[i], std::move(loader));
+  }
+  model.animationHandles = *handles;
+  model.animations.clear();
+}
@@ -1,13 +1,24 @@
 #pragma once
 #include "render/mesh.h"
 #include "render/material.h"
+#include "asset_registry.h"
+#include <span>
 #include <vector>
+#include <string_view>
+#include <unordered_map>
 
 #include <ozz/animation/runtime/skeleton.h>
 #include <ozz/animation/runtime/animation.h>
+#include <ozz/animation/runtime/track.h>
 
 using SkeletonPtr = std::shared_ptr<ozz::animation::Skeleton>;
 using AnimationPtr = std::shared_ptr<ozz::animation::Animation>;
+using AnimationHandle = AssetHandle<ozz::animation::Animation>;
+// model space displacement of the root joint from the first frame, keyed by clip ratio, y is always 0
+using RootMotionPtr = std::shared_ptr<const ozz::animation::Float3Track>;
+// sync phase by clip ratio, increases by 1 at every sync marker and by the marker count over the clip,
+// marker with the lowest id is phase 0, see make_sync_track
+using SyncTrackPtr = std::shared_ptr<const ozz::animation::FloatTrack>;
 
 
 struct SkeletonData
@@ -20,12 +31,102 @@ struct SkeletonData
   SkeletonPtr ozzSkeleton;
 };
 
+// optimization settings override for a joint and all of its descendants
+struct JointChainTolerance
+{
+  std::string jointName;
+  float tolerance = 1e-3f; // max error allowed on the chain, in meters
+  float distance = 1e-1f;  // distance from the joint at which error is measured, emulates skinned vertices
+};
+
+// what an additive clip is relative to, its keys become deltas from that pose
+enum class AdditiveReference
+{
+  None,      // regular clip
+  FirstFrame, // breathing, leaning and other loops authored on top of the clip's own first pose
+  RestPose,  // hit reactions and poses authored on top of skeleton rest pose
+};
+
+// float curve imported alongside a clip, keyed by clip ratio
+struct AnimationCurve
+{
+  std::string name;
+  std::shared_ptr<const ozz::animation::FloatTrack> track;
+};
+
+struct AnimationEventKey
+{
+  float ratio;
+  uint32_t name; // index in AnimationTracks::eventNames
+};
+
+// Curves are sampled every frame. Events (footsteps, sound and VFX cues) are found once at import and kept sorted,
+// so playback only visits the events it crosses instead of scanning curve keys.
+struct AnimationTracks
+{
+  std::vector<AnimationCurve> curves;
+  std::vector<std::string> eventNames;
+  std::vector<AnimationEventKey> events;
+};
+using AnimationTracksPtr = std::shared_ptr<const AnimationTracks>;
+
+// cue authored outside of the clip file
+struct AnimationEventSettings
+{
+  std::string name;
+  float time = 0.f; // seconds from clip start
+  std::string clip; // clip name, empty adds the cue to every clip of the file
+};
+
+struct AnimationImportSettings
+{
+  // run ozz AnimationOptimizer on imported clips to drop redundant keyframes
+  bool optimize = true;
+  // also keep unoptimized clips, to compare playback at runtime
+  bool keepRawAnimations = false;
+  float tolerance = 1e-3f;
+  float distance = 1e-1f;
+  // later chains override earlier ones for the joints they share
+  std::vector<JointChainTolerance> chainTolerances;
+  // additive clips are played by additive layers only, on top of the blended pose
+  AdditiveReference additive = AdditiveReference::None;
+  // moves horizontal translation of the root joint out of the clip into a separate track,
+  // the clip plays in place and the character is moved by the track instead
+  bool extractRootMotion = false;
+  // empty picks the first joint with animated translation (hips for Mixamo rigs)
+  std::string rootMotionJoint;
+  // joint names or name suffixes ("LeftFoot" matches "mixamorig:LeftFoot"), a sync marker is placed where each of them
+  // touches the ground, marker id is the index in this list. Empty imports clips without sync markers
+  std::vector<std::string> syncMarkerJoints;
+  // keeps planted weight curves (0 in the air, 1 on the ground) of syncMarkerJoints named after the joint,
+  // foot plants become events of the same name
+  bool contactTracks = false;
+  std::vector<AnimationEventSettings> events;
+};
+
+struct AnimationImportReport
+{
+  std::string name;
+  size_t rawSize = 0;       // bytes of runtime animation built from all source keys
+  size_t optimizedSize = 0; // bytes after keyframe reduction
+  float maxError = 0.f;     // max model space joint position error, in meters
+  int maxErrorJoint = -1;
+};
+
 struct ModelAsset
 {
   std::string path;
   std::vector<MeshPtr> meshes;
   SkeletonData skeleton;
+  // register_model_assets moves clips to the registry and clears this, so evicted ones can be freed,
+  // take clips a controller plays before that and use animationHandles afterwards
   std::vector<AnimationPtr> animations;
+  std::vector<AnimationPtr> rawAnimations; // empty unless AnimationImportSettings::keepRawAnimations
+  std::vector<AnimationImportReport> animationReports;
+  std::vector<RootMotionPtr> rootMotions; // parallel to animations, empty unless AnimationImportSettings::extractRootMotion
+  std::vector<SyncTrackPtr> syncTracks;   // parallel to animations, empty unless AnimationImportSettings::syncMarkerJoints
+  std::vector<AnimationTracksPtr> tracks; // parallel to animations, empty unless contactTracks or events are imported
+  std::vector<AnimationHandle> animationHandles; // filled by register_model_assets
 };
 
 struct StaticModelAsset
@@ -34,4 +135,48 @@ struct StaticModelAsset
   MaterialPtr material;
 };
 
-ModelAsset load_model(const char *path);
+ModelAsset load_model(const char *path, const AnimationImportSettings &settings = {});
+
+// Registers meshes, skeleton and animations of the model in engine asset registry.
+// Animations are moved out of model.animations into the registry and are addressed by model.animationHandles,
+// so clips nobody plays can be evicted under memory budget and imported again on demand.
+void register_model_assets(ModelAsset &model, const AnimationImportSettings &settings = {});
+
+// Animation-only load: imports clips from path onto an existing skeleton, matching channels to joints by name.
+// No meshes, materials or skeleton are created, model.skeleton only refers to the given skeleton.
+ModelAsset load_animations(const char *path, const SkeletonPtr &skeleton, const AnimationImportSettings &settings = {});
+
+// event shared by clips that have to play in phase (left foot down, right foot down)
+struct SyncMarker
+{
+  float ratio; // normalized time in [0, 1)
+  int id;
+};
+
+// Builds sync phase track of a looping clip from its markers, null when there are none.
+// Clips of a blend space are matched by phase, so they need the same number of markers in the same id order.
+SyncTrackPtr make_sync_track(std::span<const SyncMarker> markers);
+
+// Adds a marker where an authored contact curve (1 while the foot is planted, 0 in the air) rises above 0.5.
+// Use it for clips where the height heuristic of AnimationImportSettings::syncMarkerJoints fails (shuffles, slides).
+void add_contact_markers(const ozz::animation::FloatTrack &contact, int id, std::vector<SyncMarker> &markers);
+
+struct aiAnimation;
+
+// joint name -> joint index, built once per skeleton and shared by all clips imported onto it
+// keys point into skeleton's joint names, so the index must not outlive the skeleton
+using JointNameIndex = std::unordered_map<std::string_view, int>;
+
+JointNameIndex build_joint_name_index(const ozz::animation::Skeleton &skeleton);
+
+// report, outRawAnimation, outRootMotion, outSyncTrack and outTracks are optional outputs
+AnimationPtr create_animation(
+  const aiAnimation *animation,
+  const SkeletonPtr &skeleton,
+  const JointNameIndex &jointIndex,
+  const AnimationImportSettings &settings = {},
+  AnimationImportReport *report = nullptr,
+  AnimationPtr *outRawAnimation = nullptr,
+  RootMotionPtr *outRootMotion = nullptr,
+  SyncTrackPtr *outSyncTrack = nullptr,
+  AnimationTracksPtr *outTracks = nullptr);
@@ -0,0 +1,129 @@
+#include "engine/api.h"
+#include <bitset>
+#include <string>
+
+struct InputState
+{
+  std::bitset<SDL_NUM_SCANCODES> keys;
+  // edges since the previous step, a key tapped within one step sets both
+  std::bitset<SDL_NUM_SCANCODES> pressed;
+  std::bitset<SDL_NUM_SCANCODES> released;
+  std::string text; // keeps capacity between steps
+  int mouseDeltaX = 0;
+  int mouseDeltaY = 0;
+  int mouseWheel = 0;
+};
+
+static InputState input;
+
+namespace engine
+{
+  Event<SDL_KeyboardEvent> onKeyboardEvent;
+  Event<SDL_MouseButtonEvent> onMouseButtonEvent;
+  Event<SDL_MouseMotionEvent> onMouseMotionEvent;
+  Event<SDL_MouseWheelEvent> onMouseWheelEvent;
+
+  float get_key(SDL_Keycode keycode)
+  {
+    return is_key_down(SDL_GetScancodeFromKey(keycode)) ? 1.f : 0.f;
+  }
+
+  bool is_key_down(SDL_Scancode scancode)
+  {
+    return unsigned(scancode) < SDL_NUM_SCANCODES && input.keys[scancode];
+  }
+
+  bool is_key_pressed(SDL_Scancode scancode)
+  {
+    return unsigned(scancode) < SDL_NUM_SCANCODES && input.pressed[scancode];
+  }
+
+  bool is_key_released(SDL_Scancode scancode)
+  {
+    return unsigned(scancode) < SDL_NUM_SCANCODES && input.released[scancode];
+  }
+
+  const char *get_text_input()
+  {
+    return input.text.c_str();
+  }
+
+  std::pair<int, int> get_mouse_delta()
+  {
+    return {input.mouseDeltaX, input.mouseDeltaY};
+  }
+
+  int get_mouse_wheel()
+  {
+    return input.mouseWheel;
+  }
+
+  void update_input_state(const SDL_Event &event)
+  {
+    switch (event.type)
+    {
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+      if (!event.key.repeat && unsigned(event.key.keysym.scancode) < SDL_NUM_SCANCODES)
+      {
+        const SDL_Scancode scancode = event.key.keysym.scancode;
+        const bool down = event.key.state == SDL_PRESSED;
+        input.keys[scancode] = down;
+        (down ? input.pressed : input.released)[scancode] = true;
+      }
+      break;
+
+    case SDL_TEXTINPUT:
+      input.text += event.text.text;
+      break;
+
+    case SDL_MOUSEMOTION:
+      input.mouseDeltaX += event.motion.xrel;
+      input.mouseDeltaY += event.motion.yrel;
+      break;
+
+    case SDL_MOUSEWHEEL:
+      input.mouseWheel += event.wheel.y;
+      break;
+    }
+  }
+
+  void trigger_input_events(const SDL_Event &event)
+  {
+    switch (event.type)
+    {
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+      onKeyboardEvent(event.key);
+      break;
+
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+      onMouseButtonEvent(event.button);
+      break;
+
+    case SDL_MOUSEMOTION:
+      onMouseMotionEvent(event.motion);
+      break;
+
+    case SDL_MOUSEWHEEL:
+      onMouseWheelEvent(event.wheel);
+      break;
+    }
+  }
+
+  void dispatch_input_event(const SDL_Event &event)
+  {
+    update_input_state(event);
+    trigger_input_events(event);
+  }
+
+  // called after every game_update, edges and deltas were seen by the step
+  void input_end_step()
+  {
+    input.pressed.reset();
+    input.released.reset();
+    input.text.clear();
+    input.mouseDeltaX = input.mouseDeltaY = input.mouseWheel = 0;
+  }
+}
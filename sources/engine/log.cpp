@@ -1,51 +1,260 @@
-
 #include "engine/log_history.h"
 #include "engine/api.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
 #include <stdarg.h>
+#include <thread>
+
+static constexpr uint64_t LOG_SLOTS = 1024; // power of two
+static constexpr int LOG_MESSAGE_LEN = 1024; // longer messages are cut and end with "..."
 
-std::mutex logMutex;
-std::deque<LogItem> logHistory;
+struct LogSlot
+{
+  // slot is free for producer at position p when sequence == p, ready for consumer when sequence == p + 1
+  std::atomic<uint64_t> sequence;
+  LogType type;
+  LogCategory category;
+  float time;
+  char message[LOG_MESSAGE_LEN];
+};
 
-void debug_common(const char *fmt, LogType message_type, va_list args)
+// Bounded multi-producer single-consumer ring. Producers claim a position with CAS,
+// format into its slot and publish it through slot sequence. Consumer side is serialized by consumerMutex,
+// which is shared only by flush thread and flush_log.
+struct Logger
 {
-  constexpr int messageLen = 1024, timeLen = 20;
-  char messageBuf[messageLen], timeBuf[timeLen];
-  vsnprintf(messageBuf, messageLen, fmt, args);
-  snprintf(timeBuf, timeLen, "[%.2f] ", engine::get_time());
+  LogSlot slots[LOG_SLOTS];
+  std::atomic<uint64_t> enqueuePosition = 0;
+  std::atomic<uint64_t> droppedMessages = 0;
+  std::atomic<uint32_t> enabledMask = ~0u; // bit per category and type
+
+  std::mutex consumerMutex;
+  uint64_t dequeuePosition = 0;
+  uint64_t reportedDropped = 0;
+  FILE *file = nullptr;
+
+  std::mutex wakeMutex;
+  std::condition_variable wake;
 
-  std::string logConcat = std::string(timeBuf) + std::string(messageBuf);
+  std::mutex historyMutex;
+  LogItem history[engine::MAX_LOG_HISTORY];
+  size_t historyCount = 0;
 
-  if (message_type == LogType::Error)
+  Logger()
   {
-    fprintf(stdout, "\033[31m%s%s\033[39m\n", logConcat.c_str(), messageBuf);
+    for (uint64_t i = 0; i < LOG_SLOTS; ++i)
+      slots[i].sequence.store(i, std::memory_order_relaxed);
   }
+};
+
+static void flush_thread(Logger &logger);
+
+// never destroyed, so messages logged from static destructors are still safe
+static Logger &get_logger()
+{
+  static Logger *logger = []() {
+    Logger *logger = new Logger();
+    std::thread(flush_thread, std::ref(*logger)).detach();
+    std::atexit(engine::flush_log);
+    return logger;
+  }();
+  return *logger;
+}
+
+static uint32_t enabled_bit(LogCategory category, LogType type)
+{
+  return 1u << (uint32_t(category) * uint32_t(LogType::Count) + uint32_t(type));
+}
+
+static void write_message(Logger &logger, const LogSlot &slot)
+{
+  constexpr int lineLen = LOG_MESSAGE_LEN + 32;
+  char line[lineLen];
+  snprintf(line, lineLen, "[%.2f] %s", slot.time, slot.message);
+
+  if (slot.type == LogType::Error)
+    fprintf(stdout, "\033[31m%s\033[39m\n", line);
   else
+    fprintf(stdout, "%s\n", line);
+  if (logger.file)
+    fprintf(logger.file, "%s\n", line);
+
+  std::unique_lock lock(logger.historyMutex);
+  // history strings keep their capacity, after warm up nothing is allocated here
+  LogItem &item = logger.history[logger.historyCount % engine::MAX_LOG_HISTORY];
+  item.message.assign(line);
+  item.type = slot.type;
+  item.category = slot.category;
+  logger.historyCount++;
+}
+
+static void drain(Logger &logger)
+{
+  std::unique_lock lock(logger.consumerMutex);
+  bool written = false;
+  while (true)
+  {
+    LogSlot &slot = logger.slots[logger.dequeuePosition & (LOG_SLOTS - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != logger.dequeuePosition + 1)
+      break;
+    write_message(logger, slot);
+    slot.sequence.store(logger.dequeuePosition + LOG_SLOTS, std::memory_order_release);
+    logger.dequeuePosition++;
+    written = true;
+  }
+
+  const uint64_t dropped = logger.droppedMessages.load(std::memory_order_relaxed);
+  if (dropped != logger.reportedDropped)
+  {
+    fprintf(stdout, "\033[31m%llu log messages dropped, log ring is full\033[39m\n", (unsigned long long)(dropped - logger.reportedDropped));
+    logger.reportedDropped = dropped;
+    written = true;
+  }
+  if (written)
   {
-    fprintf(stdout, "%s%s\n", logConcat.c_str(), messageBuf);
+    fflush(stdout);
+    if (logger.file)
+      fflush(logger.file);
   }
+}
 
+static void flush_thread(Logger &logger)
+{
+  while (true)
   {
-    std::unique_lock read_write_lock(logMutex);
-    if (logHistory.size() >= engine::MAX_LOG_HISTORY)
     {
-      logHistory.pop_front();
+      std::unique_lock lock(logger.wakeMutex);
+      logger.wake.wait_for(lock, std::chrono::milliseconds(10));
     }
-    logHistory.push_back({std::move(logConcat), message_type});
+    drain(logger);
   }
 }
 
-void engine::error(const char *fmt, ...)
+static void push_message(LogCategory category, LogType type, const char *fmt, va_list args)
 {
-  va_list args;
-  va_start(args, fmt);
-  debug_common(fmt, LogType::Error, args);
-  va_end(args);
+  Logger &logger = get_logger();
+  if (!(logger.enabledMask.load(std::memory_order_relaxed) & enabled_bit(category, type)))
+    return;
+
+  uint64_t position = logger.enqueuePosition.load(std::memory_order_relaxed);
+  LogSlot *slot;
+  while (true)
+  {
+    slot = &logger.slots[position & (LOG_SLOTS - 1)];
+    const int64_t diff = int64_t(slot->sequence.load(std::memory_order_acquire)) - int64_t(position);
+    if (diff == 0)
+    {
+      if (logger.enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+        break;
+    }
+    else if (diff < 0)
+    {
+      // consumer is a whole ring behind
+      logger.droppedMessages.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    else
+      position = logger.enqueuePosition.load(std::memory_order_relaxed);
+  }
+
+  slot->type = type;
+  slot->category = category;
+  slot->time = engine::get_time();
+  const int length = vsnprintf(slot->message, LOG_MESSAGE_LEN, fmt, args);
+  if (length >= LOG_MESSAGE_LEN)
+    memcpy(slot->message + LOG_MESSAGE_LEN - 4, "...", 4);
+  slot->sequence.store(position + 1, std::memory_order_release);
+
+  // errors are written without waiting for the next flush tick
+  if (type == LogType::Error)
+    logger.wake.notify_one();
 }
 
-void engine::log(const char *fmt, ...)
+namespace engine
 {
-  va_list args;
-  va_start(args, fmt);
-  debug_common(fmt, LogType::Log, args);
-  va_end(args);
+  void error(const char *fmt, ...)
+  {
+    va_list args;
+    va_start(args, fmt);
+    push_message(LogCategory::General, LogType::Error, fmt, args);
+    va_end(args);
+  }
+
+  void error(LogCategory category, const char *fmt, ...)
+  {
+    va_list args;
+    va_start(args, fmt);
+    push_message(category, LogType::Error, fmt, args);
+    va_end(args);
+  }
+
+  void log(const char *fmt, ...)
+  {
+    va_list args;
+    va_start(args, fmt);
+    push_message(LogCategory::General, LogType::Log, fmt, args);
+    va_end(args);
+  }
+
+  void log(LogCategory category, const char *fmt, ...)
+  {
+    va_list args;
+    va_start(args, fmt);
+    push_message(category, LogType::Log, fmt, args);
+    va_end(args);
+  }
+
+  void set_log_enabled(LogCategory category, LogType type, bool enabled)
+  {
+    if (enabled)
+      get_logger().enabledMask.fetch_or(enabled_bit(category, type), std::memory_order_relaxed);
+    else
+      get_logger().enabledMask.fetch_and(~enabled_bit(category, type), std::memory_order_relaxed);
+  }
+
+  bool is_log_enabled(LogCategory category, LogType type)
+  {
+    return get_logger().enabledMask.load(std::memory_order_relaxed) & enabled_bit(category, type);
+  }
+
+  void set_log_file(const char *path)
+  {
+    Logger &logger = get_logger();
+    std::unique_lock lock(logger.consumerMutex);
+    if (logger.file)
+      fclose(logger.file);
+    logger.file = path ? fopen(path, "a") : nullptr;
+  }
+
+  void flush_log()
+  {
+    drain(get_logger());
+  }
+
+  void for_each_log_history(const std::function<void(const LogItem &)> &func)
+  {
+    Logger &logger = get_logger();
+    std::unique_lock lock(logger.historyMutex);
+    const size_t count = std::min<size_t>(logger.historyCount, MAX_LOG_HISTORY);
+    for (size_t i = logger.historyCount - count; i < logger.historyCount; ++i)
+      func(logger.history[i % MAX_LOG_HISTORY]);
+  }
+
+  const char *log_category_name(LogCategory category)
+  {
+    switch (category)
+    {
+    case LogCategory::General: return "General";
+    case LogCategory::Import: return "Import";
+    case LogCategory::Render: return "Render";
+    case LogCategory::Animation: return "Animation";
+    case LogCategory::Profiler: return "Profiler";
+    default: return "Unknown";
+    }
+  }
 }
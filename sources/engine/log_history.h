@@ -1,19 +1,38 @@
 #pragma once
+#include <functional>
 #include <string>
-#include <deque>
-#include <mutex>
 
 enum class LogType
 {
   Error,
   Log,
+  Count
+};
+
+enum class LogCategory
+{
+  General,
+  Import,
+  Render,
+  Animation,
+  Profiler,
+  Count
 };
 
 struct LogItem
 {
   std::string message;
-  LogType LogType;
+  LogType type;
+  LogCategory category;
 };
 
-extern std::mutex logMutex;
-extern std::deque<LogItem> logHistory;
\ No newline at end of file
+namespace engine
+{
+  // calls func for the last MAX_LOG_HISTORY flushed messages from the oldest,
+  // history lock is shared only with the flush thread, never with logging threads
+  void for_each_log_history(const std::function<void(const LogItem &)> &func);
+
+  const char *log_category_name(LogCategory category);
+
+  void show_log_imgui();
+}
@@ -0,0 +1,35 @@
+#include "engine/api.h"
+#include "engine/log_history.h"
+#include "imgui/imgui.h"
+
+namespace engine
+{
+  void show_log_imgui()
+  {
+    if (ImGui::Begin("Log History"))
+    {
+      if (ImGui::TreeNode("Filter"))
+      {
+        for (int category = 0; category < int(LogCategory::Count); ++category)
+        {
+          ImGui::PushID(category);
+          for (LogType type : {LogType::Log, LogType::Error})
+          {
+            bool enabled = is_log_enabled(LogCategory(category), type);
+            if (ImGui::Checkbox(type == LogType::Log ? "log" : "error", &enabled))
+              set_log_enabled(LogCategory(category), type, enabled);
+            ImGui::SameLine();
+          }
+          ImGui::Text("%s", log_category_name(LogCategory(category)));
+          ImGui::PopID();
+        }
+        ImGui::TreePop();
+      }
+
+      for_each_log_history([](const LogItem &m) {
+        ImGui::TextColored(m.type == LogType::Log ? ImVec4(1, 1, 1, 1) : ImVec4(1, 0.1f, 0.1f, 1), "%s", m.message.c_str());
+      });
+    }
+    ImGui::End();
+  }
+}
@@ -3,14 +3,31 @@
 #include <imgui/imgui_impl_sdl.h>
 #define SDL_MAIN_HANDLED
 #include <SDL2/SDL.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
 #include <iostream>
-#include <map>
+#include <thread>
+#include <vector>
 #include "engine/event.h"
 #include "engine/log_history.h"
+#include "engine/asset_registry.h"
+#include "engine/api.h"
+#include "engine/frame_arena.h"
+#include "engine/gpu_profiler.h"
+#include "engine/profiler.h"
+#include "engine/replay.h"
 
 // forward declarations for game's entry points
+extern bool game_parse_launch_option(int argc, char **argv, int &i);
 extern void game_init();
+extern bool game_run_headless_task(int &exitCode);
 extern void game_update();
+extern void game_prepare_render();
+extern void game_swap_render_snapshots();
 extern void game_render();
 extern void game_imgui_render();
 extern void game_terminate();
@@ -26,6 +43,58 @@ struct SDLContext
 
 SDLContext context;
 
+struct LaunchOptions
+{
+  bool headless = false;
+  int frames = 1000;
+  float deltaTime = 1.f / 60.f;
+  const char *timingsPath = nullptr; // per-frame timings as csv
+  const char *tracePath = nullptr; // profiler zones of the whole run as Chrome trace
+  const char *recordPath = nullptr; // replay of the whole run
+  const char *replayPath = nullptr; // replay to play instead of live input
+};
+
+static LaunchOptions parse_launch_options(int argc, char **argv)
+{
+  LaunchOptions options;
+  for (int i = 1; i < argc; ++i)
+  {
+    const bool hasValue = i + 1 < argc;
+    if (!strcmp(argv[i], "--headless"))
+      options.headless = true;
+    else if (!strcmp(argv[i], "--frames") && hasValue)
+      options.frames = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "--dt") && hasValue)
+      options.deltaTime = float(atof(argv[++i]));
+    else if (!strcmp(argv[i], "--timings") && hasValue)
+      options.timingsPath = argv[++i];
+    else if (!strcmp(argv[i], "--trace") && hasValue)
+      options.tracePath = argv[++i];
+    else if (!strcmp(argv[i], "--record") && hasValue)
+      options.recordPath = argv[++i];
+    else if (!strcmp(argv[i], "--replay") && hasValue)
+      options.replayPath = argv[++i];
+    else if (!strcmp(argv[i], "--log-file") && hasValue)
+      engine::set_log_file(argv[++i]);
+    else if (!strcmp(argv[i], "--serial"))
+      engine::get_frame_settings().pipelined = false;
+    else if (!strcmp(argv[i], "--variable-step"))
+      engine::get_frame_settings().fixedStep = false;
+    else if (!strcmp(argv[i], "--vsync"))
+      engine::get_frame_settings().pacing = engine::FramePacing::Vsync;
+    else if (!strcmp(argv[i], "--uncapped"))
+      engine::get_frame_settings().pacing = engine::FramePacing::Uncapped;
+    else if (!strcmp(argv[i], "--fps") && hasValue)
+    {
+      engine::get_frame_settings().pacing = engine::FramePacing::TargetFps;
+      engine::get_frame_settings().targetFps = std::max(1.f, float(atof(argv[++i])));
+    }
+    else if (!game_parse_launch_option(argc, argv, i))
+      engine::error("Unknown launch option \"%s\"", argv[i]);
+  }
+  return options;
+}
+
 static void init_application()
 {
   SDL_Init(SDL_INIT_EVERYTHING);
@@ -42,7 +111,6 @@ static void init_application()
   context.window = SDL_CreateWindow(PROJECT_NAME, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1024, 512, (SDL_WindowFlags)(window_flags));
   context.gl_context = SDL_GL_CreateContext(context.window);
   SDL_GL_MakeCurrent(context.window, context.gl_context);
-  SDL_GL_SetSwapInterval(0);
 
   if (!gladLoadGLLoader(SDL_GL_GetProcAddress))
   {
@@ -56,6 +124,7 @@ static void init_application()
   ImGui_ImplSDL2_InitForOpenGL(context.window, context.gl_context);
   const char *glsl_version = "#version 450";
   ImGui_ImplOpenGL3_Init(glsl_version);
+  engine::gpu_profiler_init();
   glEnable(GL_DEBUG_OUTPUT);
   // enable msaa antialiasing
   glEnable(GL_MULTISAMPLE);
@@ -64,6 +133,9 @@ static void init_application()
 static void close_application()
 {
   game_terminate();
+  if (engine::is_headless())
+    return;
+  engine::gpu_profiler_terminate();
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplSDL2_Shutdown();
   ImGui::DestroyContext();
@@ -73,36 +145,42 @@ static void close_application()
 namespace engine
 {
   Event<std::pair<int, int>> onWindowResizedEvent;
+  // headless mode has no window, size of a typical one keeps projections valid
+  static const std::pair<int, int> HEADLESS_SCREEN_SIZE = {1920, 1080};
+
   float get_aspect_ratio()
   {
-    int width, height;
-    SDL_GL_GetDrawableSize(context.window, &width, &height);
+    auto [width, height] = get_screen_size();
     return (float)width / height;
   }
 
   std::pair<int, int> get_screen_size()
   {
+    if (!context.window)
+      return HEADLESS_SCREEN_SIZE;
     int width, height;
     SDL_GL_GetDrawableSize(context.window, &width, &height);
     return {width, height};
   }
 
-  Event<SDL_KeyboardEvent> onKeyboardEvent;
-  Event<SDL_MouseButtonEvent> onMouseButtonEvent;
-  Event<SDL_MouseMotionEvent> onMouseMotionEvent;
-  Event<SDL_MouseWheelEvent> onMouseWheelEvent;
-
-  std::map<SDL_Keycode, bool> keyMap;
-  float get_key(SDL_Keycode keycode)
-  {
-    auto it = keyMap.find(keycode);
-    return (it != keyMap.end() ? it->second : false) ? 1.f : 0.f;
-  }
   extern void start_time();
   extern void update_time();
+  extern void advance_time(float dt);
+  extern void set_delta_time(float dt);
+  extern void set_interpolation_alpha(float alpha);
+  extern void input_end_step();
 
 }
 
+// during playback game input comes from the replay only
+static void dispatch_game_input(const SDL_Event &event)
+{
+  if (engine::is_replay_playing())
+    return;
+  engine::dispatch_input_event(event);
+  engine::replay_record_event(event);
+}
+
 static bool sdl_event_handler()
 {
   SDL_Event event;
@@ -120,99 +198,403 @@ static bool sdl_event_handler()
     case SDL_KEYUP:
       if (ImGui::GetIO().WantCaptureKeyboard)
         break;
-      if (!event.key.repeat)
-      {
-        if (event.key.state == SDL_PRESSED)
-          engine::keyMap[event.key.keysym.sym] = true;
-        if (event.key.state == SDL_RELEASED)
-          engine::keyMap[event.key.keysym.sym] = false;
-      }
-      engine::onKeyboardEvent(event.key);
-
       if (event.key.keysym.sym == SDLK_ESCAPE)
         running = false;
-
-    case SDL_MOUSEBUTTONDOWN:
-    case SDL_MOUSEBUTTONUP:
-      if (ImGui::GetIO().WantCaptureMouse)
-        break;
-      engine::onMouseButtonEvent(event.button);
+      dispatch_game_input(event);
       break;
 
-    case SDL_MOUSEMOTION:
-      if (ImGui::GetIO().WantCaptureMouse)
+    case SDL_TEXTINPUT:
+      if (ImGui::GetIO().WantCaptureKeyboard)
         break;
-      engine::onMouseMotionEvent(event.motion);
+      dispatch_game_input(event);
       break;
 
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+    case SDL_MOUSEMOTION:
     case SDL_MOUSEWHEEL:
       if (ImGui::GetIO().WantCaptureMouse)
         break;
-      engine::onMouseWheelEvent(event.wheel);
+      dispatch_game_input(event);
       break;
 
     case SDL_WINDOWEVENT:
+      // a drag resize sends many events, handlers run once per frame with the final size
+      if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+        engine::onWindowResizedEvent.post_latest(engine::get_screen_size());
       break;
     }
   }
   return running;
 }
 
+// Worker that runs one job per frame, main thread kicks it and waits for it within the same frame.
+class SimulationThread
+{
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::function<void()> job;
+  bool busy = false;
+  bool quit = false;
+
+  void run()
+  {
+    engine::profiler_set_thread_name("simulation");
+    std::unique_lock lock(mutex);
+    while (true)
+    {
+      condition.wait(lock, [this]() { return job || quit; });
+      if (quit)
+        return;
+      std::function<void()> currentJob = std::move(job);
+      job = nullptr;
+      lock.unlock();
+      currentJob();
+      engine::frame_arena_reset();
+      lock.lock();
+      busy = false;
+      condition.notify_all();
+    }
+  }
+
+public:
+  void kick(std::function<void()> &&newJob)
+  {
+    if (!thread.joinable())
+      thread = std::thread([this]() { run(); });
+    std::unique_lock lock(mutex);
+    job = std::move(newJob);
+    busy = true;
+    condition.notify_all();
+  }
+
+  void wait()
+  {
+    std::unique_lock lock(mutex);
+    condition.wait(lock, [this]() { return !busy; });
+  }
+
+  void stop()
+  {
+    if (!thread.joinable())
+      return;
+    {
+      std::unique_lock lock(mutex);
+      quit = true;
+      condition.notify_all();
+    }
+    thread.join();
+  }
+};
+
+static SimulationThread simulationThread;
+
+// runs as many fixed steps as accumulated time allows, the remainder is used to interpolate rendering
+static void simulate(float frameDeltaTime, float &accumulator)
+{
+  const engine::FrameSettings &settings = engine::get_frame_settings();
+  if (engine::is_replay_playing())
+  {
+    // recorded steps are played at their own dt, slow frames delay playback instead of skipping steps
+    accumulator += frameDeltaTime;
+    float step = settings.fixedDeltaTime;
+    int steps = 0;
+    while (steps < settings.maxStepsPerFrame && engine::replay_next_delta_time(step) && accumulator >= step)
+    {
+      engine::set_delta_time(step);
+      engine::replay_begin_step(step);
+      game_update();
+      engine::input_end_step();
+      accumulator -= step;
+      steps++;
+    }
+    if (!engine::replay_next_delta_time(step))
+      engine::replay_stop();
+    accumulator = std::min(accumulator, step);
+    engine::set_interpolation_alpha(accumulator / step);
+    return;
+  }
+  if (!settings.fixedStep)
+  {
+    accumulator = 0.f;
+    engine::set_interpolation_alpha(1.f);
+    engine::replay_begin_step(frameDeltaTime);
+    game_update();
+    engine::input_end_step();
+    return;
+  }
+
+  const float step = settings.fixedDeltaTime;
+  accumulator += frameDeltaTime;
+  int steps = 0;
+  while (accumulator >= step && steps < settings.maxStepsPerFrame)
+  {
+    engine::set_delta_time(step);
+    engine::replay_begin_step(step);
+    game_update();
+    engine::input_end_step();
+    accumulator -= step;
+    steps++;
+  }
+  // simulation can't keep up, drop the backlog instead of spiraling into longer and longer frames
+  if (accumulator >= step)
+    accumulator = std::fmod(accumulator, step);
+  engine::set_interpolation_alpha(accumulator / step);
+}
+
+static void apply_swap_interval(engine::FramePacing pacing)
+{
+  static int currentInterval = -1;
+  const int interval = pacing == engine::FramePacing::Vsync ? 1 : 0;
+  if (interval == currentInterval)
+    return;
+  currentInterval = interval;
+  if (SDL_GL_SetSwapInterval(interval) != 0)
+    engine::error("Can't set swap interval %d: %s", interval, SDL_GetError());
+}
+
+// sleeps most of the remaining frame time and spins the last millisecond, sleep is too coarse for exact pacing
+static void wait_for_next_frame(std::chrono::steady_clock::time_point &nextFrame, float targetFps)
+{
+  using namespace std::chrono;
+  const steady_clock::duration frameDuration = duration_cast<steady_clock::duration>(duration<float>(1.f / targetFps));
+  const steady_clock::time_point now = steady_clock::now();
+  nextFrame += frameDuration;
+  // too late or after pause, start pacing from now instead of catching up
+  if (nextFrame < now - frameDuration)
+    nextFrame = now;
+
+  std::this_thread::sleep_until(nextFrame - milliseconds(1));
+  while (steady_clock::now() < nextFrame)
+    std::this_thread::yield();
+}
+
+static void show_frame_settings()
+{
+  if (ImGui::Begin("Frame timing"))
+  {
+    engine::FrameSettings &settings = engine::get_frame_settings();
+    ImGui::Text("%.1f FPS, %.2f ms", ImGui::GetIO().Framerate, 1000.f / ImGui::GetIO().Framerate);
+
+    ImGui::Checkbox("Fixed step simulation", &settings.fixedStep);
+    if (settings.fixedStep)
+    {
+      float stepRate = 1.f / settings.fixedDeltaTime;
+      if (ImGui::SliderFloat("Step rate, Hz", &stepRate, 10.f, 240.f, "%.0f"))
+        settings.fixedDeltaTime = 1.f / stepRate;
+      ImGui::SliderInt("Max steps per frame", &settings.maxStepsPerFrame, 1, 16);
+      ImGui::Text("Interpolation alpha %.2f", engine::get_interpolation_alpha());
+    }
+
+    ImGui::Checkbox("Pipelined simulation", &settings.pipelined);
+
+    int pacing = int(settings.pacing);
+    ImGui::Combo("Pacing", &pacing, "Vsync\0Target FPS\0Uncapped\0");
+    settings.pacing = engine::FramePacing(pacing);
+    if (settings.pacing == engine::FramePacing::TargetFps)
+      ImGui::SliderFloat("Target FPS", &settings.targetFps, 10.f, 300.f, "%.0f");
+  }
+  ImGui::End();
+}
+
 void main_loop()
 {
   engine::start_time();
   game_init();
 
-  static std::pair<int, int> lastWindowSize = engine::get_screen_size();
-
+  float accumulator = 0.f;
+  std::chrono::steady_clock::time_point nextFrame = std::chrono::steady_clock::now();
   bool running = true;
   while (running)
   {
+    engine::profiler_new_frame();
+    engine::gpu_profiler_new_frame();
+    PROFILE_ZONE("frame");
     engine::update_time();
+    const float frameDeltaTime = engine::get_delta_time();
 
-    running = sdl_event_handler();
+    {
+      PROFILE_ZONE("events");
+      running = sdl_event_handler();
+      engine::replay_trigger_played_events();
+    }
 
-    std::pair<int, int> windowSize = engine::get_screen_size();
-    if (windowSize != lastWindowSize)
     {
-      lastWindowSize = windowSize;
-      engine::onWindowResizedEvent(windowSize);
+      PROFILE_ZONE("deferred_events");
+      engine::flush_deferred_events();
     }
 
     if (running)
     {
-      game_update();
-      SDL_GL_SwapWindow(context.window);
+      // UI is built while simulation is idle, so it may change the scene freely
+      {
+        PROFILE_ZONE("imgui_build");
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplSDL2_NewFrame(context.window);
+        ImGui::NewFrame();
+        engine::show_log_imgui();
+        engine::get_asset_registry().show_imgui();
+        engine::profiler_show_imgui();
+        show_frame_settings();
+
+        game_imgui_render();
+        ImGui::Render();
+      }
 
-      game_render();
+      const engine::FrameSettings &settings = engine::get_frame_settings();
+      auto simulate_frame = [&]() {
+        PROFILE_ZONE("game_update");
+        simulate(frameDeltaTime, accumulator);
+        game_prepare_render();
+      };
+      // pipelined: simulate next frame while the snapshot of the previous one is rendered
+      const bool pipelined = settings.pipelined;
+      if (pipelined)
+        simulationThread.kick(simulate_frame);
+      else
+      {
+        simulate_frame();
+        game_swap_render_snapshots();
+      }
 
-      ImGui_ImplOpenGL3_NewFrame();
-      ImGui_ImplSDL2_NewFrame(context.window);
-      ImGui::NewFrame();
       {
-        if (ImGui::Begin("Log History"))
+        apply_swap_interval(settings.pacing);
+        if (settings.pacing == engine::FramePacing::TargetFps)
         {
-          std::unique_lock read_write_lock(logMutex);
-          for (const LogItem &m : logHistory)
-            ImGui::TextColored(m.LogType == LogType::Log ? ImVec4(1, 1, 1, 1) : ImVec4(1, 0.1f, 0.1f, 1), "%s", m.message.c_str());
+          PROFILE_ZONE("pacing");
+          wait_for_next_frame(nextFrame, settings.targetFps);
         }
-        ImGui::End();
+        PROFILE_ZONE("swap");
+        SDL_GL_SwapWindow(context.window);
+      }
+      {
+        PROFILE_ZONE("game_render");
+        GPU_PROFILE_ZONE("scene");
+        game_render();
+      }
+      {
+        PROFILE_ZONE("imgui_render");
+        GPU_PROFILE_ZONE("imgui");
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+      }
 
-        game_imgui_render();
+      if (pipelined)
+      {
+        PROFILE_ZONE("wait_simulation");
+        simulationThread.wait();
+        game_swap_render_snapshots();
+      }
+      {
+        PROFILE_ZONE("asset_registry");
+        engine::get_asset_registry().update();
       }
+    }
+    engine::frame_arena_reset();
+  }
+  simulationThread.stop();
+}
+
+// simulation only, every frame advances time by fixed dt, so runs are reproducible, returns exit code
+static int headless_loop(const LaunchOptions &options)
+{
+  using clock = std::chrono::high_resolution_clock;
+
+  engine::start_time();
+  game_init();
 
-      ImGui::Render();
-      ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+  int exitCode = 0;
+  if (game_run_headless_task(exitCode))
+    return exitCode;
+
+  // replay plays all its steps with recorded dt
+  const int frames = engine::is_replay_playing() ? std::max(1, int(engine::replay_step_count())) : options.frames;
+  std::vector<float> frameTimes(frames);
+  if (options.tracePath)
+    engine::profiler_start_capture();
+  for (int frame = 0; frame < frames; ++frame)
+  {
+    engine::profiler_new_frame();
+    clock::time_point start = clock::now();
+    {
+      PROFILE_ZONE("frame");
+      float deltaTime = options.deltaTime;
+      engine::replay_next_delta_time(deltaTime);
+      engine::advance_time(deltaTime);
+      engine::replay_begin_step(deltaTime);
+      {
+        PROFILE_ZONE("game_update");
+        game_update();
+        engine::input_end_step();
+      }
+      engine::replay_trigger_played_events();
+      {
+        PROFILE_ZONE("asset_registry");
+        engine::get_asset_registry().update();
+      }
+      engine::frame_arena_reset();
+    }
+    frameTimes[frame] = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+  }
+  engine::profiler_new_frame();
+  if (options.tracePath)
+    engine::profiler_stop_capture(options.tracePath);
+
+  if (options.timingsPath)
+  {
+    if (FILE *file = fopen(options.timingsPath, "w"))
+    {
+      fprintf(file, "frame,ms\n");
+      for (int frame = 0; frame < frames; ++frame)
+        fprintf(file, "%d,%.4f\n", frame, frameTimes[frame]);
+      fclose(file);
     }
+    else
+      engine::error("Can't write frame timings to \"%s\"", options.timingsPath);
   }
+
+  double total = 0.0;
+  for (float time : frameTimes)
+    total += time;
+  std::vector<float> sorted = frameTimes;
+  std::sort(sorted.begin(), sorted.end());
+  auto percentile = [&](float p) { return sorted[std::min(sorted.size() - 1, size_t(p * sorted.size()))]; };
+
+  engine::log("Headless run: %d frames, dt %.4f s, total %.2f ms", frames, options.deltaTime, total);
+  engine::log("Frame ms: avg %.4f, min %.4f, p50 %.4f, p95 %.4f, p99 %.4f, max %.4f",
+    total / frames, sorted.front(), percentile(0.5f), percentile(0.95f), percentile(0.99f), sorted.back());
+  // transient allocations per frame should stay bounded whatever the crowd size is
+  for (const FrameArenaStats &arena : engine::frame_arena_stats())
+    engine::log("Frame arena %s: high water %.1f KB, capacity %.1f KB, overflowed %zu frames",
+      arena.threadName, arena.highWaterBytes / 1024.f, arena.capacityBytes / 1024.f, arena.overflowFrames);
+  return 0;
 }
 
-int main(int, char **)
+int main(int argc, char **argv)
 {
+  engine::profiler_set_thread_name("main");
+  const LaunchOptions options = parse_launch_options(argc, argv);
+
+  // replay covers the session from game_init
+  if (options.replayPath && !engine::replay_start_playback(options.replayPath))
+    return 1;
+  if (options.recordPath && !options.replayPath)
+    engine::replay_start_recording(options.recordPath);
+
+  if (options.headless)
+  {
+    engine::set_headless(true);
+    const int exitCode = headless_loop(options);
+    engine::replay_stop();
+    close_application();
+    return exitCode;
+  }
+
   init_application();
 
   main_loop();
 
+  engine::replay_stop();
   close_application();
 
   return 0;
@@ -0,0 +1,247 @@
+#include "engine/profiler.h"
+#include "engine/api.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+// Ring buffer of finished zones with a single writer (owner thread) and a single reader (main thread).
+// Writer never waits: when reader falls behind by more than a ring, the oldest zones are dropped.
+// Every slot is a seqlock, its sequence is odd while the writer fills it and 2 * (index + 1) once event index is in it,
+// so the reader copies a slot without locks and drops it when the writer reused it meanwhile.
+struct ProfileSlot
+{
+  std::atomic<uint64_t> sequence = 0;
+  std::atomic<const char *> name = nullptr;
+  std::atomic<uint64_t> start = 0;
+  std::atomic<uint64_t> end = 0;
+  std::atomic<uint32_t> depth = 0;
+};
+
+struct ThreadProfile
+{
+  static constexpr uint64_t CAPACITY = 1 << 14;
+
+  ProfileSlot slots[CAPACITY];
+  std::atomic<uint64_t> writeIndex = 0;
+  uint64_t readIndex = 0; // reader only
+  uint32_t depth = 0;     // writer only
+  uint32_t threadId = 0;
+  std::atomic<const char *> name = "thread";
+};
+
+static const std::chrono::steady_clock::time_point profilerStart = std::chrono::steady_clock::now();
+
+// registration is the only locked part, it happens once per thread
+static std::mutex threadsMutex;
+static std::vector<std::unique_ptr<ThreadProfile>> threadProfiles;
+
+static thread_local ThreadProfile *currentThread = nullptr;
+
+// name is set before the ring is visible to the reader, nullptr keeps the default one
+static ThreadProfile &get_thread_profile(const char *name = nullptr)
+{
+  if (!currentThread)
+  {
+    auto profile = std::make_unique<ThreadProfile>();
+    if (name)
+      profile->name.store(name, std::memory_order_relaxed);
+    std::unique_lock lock(threadsMutex);
+    profile->threadId = threadProfiles.size();
+    currentThread = threadProfiles.emplace_back(std::move(profile)).get();
+  }
+  return *currentThread;
+}
+
+static void write_slot(ProfileSlot &slot, uint64_t index, const ProfileEvent &event)
+{
+  slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.name.store(event.name, std::memory_order_relaxed);
+  slot.start.store(event.start, std::memory_order_relaxed);
+  slot.end.store(event.end, std::memory_order_relaxed);
+  slot.depth.store(event.depth, std::memory_order_relaxed);
+  slot.sequence.store(2 * (index + 1), std::memory_order_release);
+}
+
+// false when the slot doesn't hold event index anymore or the writer was filling it during the copy
+static bool read_slot(const ProfileSlot &slot, uint64_t index, ProfileEvent &event)
+{
+  const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+  event.name = slot.name.load(std::memory_order_relaxed);
+  event.start = slot.start.load(std::memory_order_relaxed);
+  event.end = slot.end.load(std::memory_order_relaxed);
+  event.depth = slot.depth.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return sequence == 2 * (index + 1) && slot.sequence.load(std::memory_order_relaxed) == sequence;
+}
+
+// main thread state
+static ProfileFrame currentFrame, lastFrame;
+static std::vector<ProfileFrame> capturedFrames;
+static std::vector<ProfileThreadFrame> capturedExternal;
+static bool capturing = false;
+static bool paused = false;
+static uint64_t droppedEvents = 0;
+
+namespace engine
+{
+  uint64_t profiler_now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - profilerStart).count();
+  }
+
+  uint64_t profiler_begin_zone()
+  {
+    get_thread_profile().depth++;
+    return profiler_now();
+  }
+
+  void profiler_end_zone(const char *name, uint64_t start)
+  {
+    const uint64_t end = profiler_now();
+    ThreadProfile &thread = get_thread_profile();
+    thread.depth--;
+    const uint64_t index = thread.writeIndex.load(std::memory_order_relaxed);
+    write_slot(thread.slots[index % ThreadProfile::CAPACITY], index, ProfileEvent{name, start, end, thread.depth});
+    thread.writeIndex.store(index + 1, std::memory_order_release);
+  }
+
+  void profiler_set_thread_name(const char *name)
+  {
+    get_thread_profile(name).name.store(name, std::memory_order_relaxed);
+  }
+
+  const char *profiler_thread_name()
+  {
+    return get_thread_profile().name.load(std::memory_order_relaxed);
+  }
+
+  static void collect_thread(ThreadProfile &thread, ProfileThreadFrame &out)
+  {
+    const uint64_t write = thread.writeIndex.load(std::memory_order_acquire);
+    if (write - thread.readIndex > ThreadProfile::CAPACITY)
+    {
+      droppedEvents += write - thread.readIndex - ThreadProfile::CAPACITY;
+      thread.readIndex = write - ThreadProfile::CAPACITY;
+    }
+    // writer could lap the reader while copying, slots it reused hold newer zones now
+    for (; thread.readIndex < write; ++thread.readIndex)
+    {
+      ProfileEvent event;
+      if (read_slot(thread.slots[thread.readIndex % ThreadProfile::CAPACITY], thread.readIndex, event))
+        out.events.push_back(event);
+      else
+        droppedEvents++;
+    }
+  }
+
+  void profiler_new_frame()
+  {
+    const uint64_t now = profiler_now();
+    {
+      std::unique_lock lock(threadsMutex);
+      for (const std::unique_ptr<ThreadProfile> &thread : threadProfiles)
+      {
+        ProfileThreadFrame threadFrame{thread->threadId, thread->name.load(std::memory_order_relaxed), {}};
+        collect_thread(*thread, threadFrame);
+        if (!threadFrame.events.empty())
+          currentFrame.threads.push_back(std::move(threadFrame));
+      }
+    }
+    currentFrame.end = now;
+
+    if (capturing)
+      capturedFrames.push_back(currentFrame);
+    if (!paused)
+      lastFrame = std::move(currentFrame);
+
+    currentFrame = ProfileFrame{};
+    currentFrame.start = now;
+  }
+
+  const ProfileFrame &profiler_last_frame()
+  {
+    return lastFrame;
+  }
+
+  uint64_t profiler_dropped_events()
+  {
+    return droppedEvents;
+  }
+
+  void profiler_set_paused(bool pause)
+  {
+    paused = pause;
+  }
+
+  bool profiler_is_paused()
+  {
+    return paused;
+  }
+
+  void profiler_start_capture()
+  {
+    capturedFrames.clear();
+    capturedExternal.clear();
+    capturing = true;
+  }
+
+  void profiler_capture_events(const ProfileThreadFrame &thread)
+  {
+    if (capturing)
+      capturedExternal.push_back(thread);
+  }
+
+  bool profiler_is_capturing()
+  {
+    return capturing;
+  }
+
+  bool profiler_stop_capture(const char *path)
+  {
+    capturing = false;
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+      engine::error(LogCategory::Profiler, "Can't write profiler trace to \"%s\"", path);
+      capturedFrames.clear();
+      capturedExternal.clear();
+      return false;
+    }
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    auto separator = [&]() { const char *s = first ? "" : ",\n"; first = false; return s; };
+
+    std::vector<bool> namedThreads;
+    size_t eventCount = 0;
+    auto write_thread = [&](const ProfileThreadFrame &thread) {
+      if (thread.threadId >= namedThreads.size())
+        namedThreads.resize(thread.threadId + 1, false);
+      if (!namedThreads[thread.threadId])
+      {
+        namedThreads[thread.threadId] = true;
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+          separator(), thread.threadId, thread.threadName);
+      }
+      for (const ProfileEvent &event : thread.events)
+        fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+          separator(), event.name, thread.threadId, event.start * 1e-3, (event.end - event.start) * 1e-3);
+      eventCount += thread.events.size();
+    };
+    for (const ProfileFrame &frame : capturedFrames)
+      for (const ProfileThreadFrame &thread : frame.threads)
+        write_thread(thread);
+    for (const ProfileThreadFrame &thread : capturedExternal)
+      write_thread(thread);
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    engine::log(LogCategory::Profiler, "Profiler trace \"%s\" saved, %zu frames, %zu zones", path, capturedFrames.size(), eventCount);
+    capturedFrames.clear();
+    capturedExternal.clear();
+    return true;
+  }
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Hierarchical CPU profiler.
+// PROFILE_ZONE("name") measures the enclosing scope, zones nest and may be used from any thread.
+// Every thread writes finished zones into its own ring buffer without locks, engine::profiler_new_frame()
+// collects them once per frame for the "Profiler" window and Chrome trace capture.
+// Build with ENGINE_PROFILER=0 to compile all zones out.
+
+#ifndef ENGINE_PROFILER
+#define ENGINE_PROFILER 1
+#endif
+
+struct ProfileEvent
+{
+  const char *name; // must outlive profiler, zones take string literals
+  uint64_t start;   // nanoseconds since program start
+  uint64_t end;
+  uint32_t depth;   // number of enclosing zones on the same thread
+};
+
+struct ProfileThreadFrame
+{
+  uint32_t threadId;
+  const char *threadName;
+  std::vector<ProfileEvent> events; // in order of zone end
+};
+
+struct ProfileFrame
+{
+  uint64_t start = 0;
+  uint64_t end = 0;
+  std::vector<ProfileThreadFrame> threads;
+};
+
+namespace engine
+{
+  // nanoseconds since program start, same clock for all threads
+  uint64_t profiler_now();
+
+  // used by ProfileZone, returns zone start time
+  uint64_t profiler_begin_zone();
+  void profiler_end_zone(const char *name, uint64_t start);
+
+  // name shown for the calling thread in the UI and traces
+  void profiler_set_thread_name(const char *name);
+  const char *profiler_thread_name();
+
+  // closes current frame and collects zones of all threads, call once per frame from main thread
+  void profiler_new_frame();
+
+  // last collected frame, stays the same while profiler is paused
+  const ProfileFrame &profiler_last_frame();
+  void profiler_set_paused(bool pause);
+  bool profiler_is_paused();
+
+  // zones lost because a thread filled its ring before the frame was collected
+  uint64_t profiler_dropped_events();
+
+  // frames collected between start and stop are written to path in Chrome trace format (chrome://tracing, Perfetto)
+  void profiler_start_capture();
+  bool profiler_stop_capture(const char *path);
+  bool profiler_is_capturing();
+  // adds zones measured outside of CPU threads (GPU queries) to the running capture
+  void profiler_capture_events(const ProfileThreadFrame &thread);
+
+  void profiler_show_imgui();
+}
+
+class ProfileZone
+{
+  const char *name;
+  uint64_t start;
+
+public:
+  explicit ProfileZone(const char *name) : name(name), start(engine::profiler_begin_zone()) {}
+  ~ProfileZone() { engine::profiler_end_zone(name, start); }
+
+  ProfileZone(const ProfileZone &) = delete;
+  ProfileZone &operator=(const ProfileZone &) = delete;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+#if ENGINE_PROFILER
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#endif
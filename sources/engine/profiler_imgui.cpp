@@ -0,0 +1,161 @@
+#include "engine/profiler.h"
+#include "engine/gpu_profiler.h"
+#include "engine/frame_arena.h"
+#include "imgui/imgui.h"
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+static ImU32 zone_color(const char *name)
+{
+  // stable color per zone name, muted to keep labels readable
+  const size_t hash = std::hash<std::string_view>()(name);
+  const float hue = (hash % 360) / 360.f;
+  ImVec4 color;
+  ImGui::ColorConvertHSVtoRGB(hue, 0.45f, 0.75f, color.x, color.y, color.z);
+  color.w = 1.f;
+  return ImGui::ColorConvertFloat4ToU32(color);
+}
+
+// one row per zone depth, x axis is time from frame start to frame end
+static void show_flame(const ProfileFrame &frame, const ProfileThreadFrame &thread, float zoom)
+{
+  const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+  uint32_t maxDepth = 0;
+  for (const ProfileEvent &event : thread.events)
+    maxDepth = std::max(maxDepth, event.depth);
+
+  const float width = ImGui::GetContentRegionAvail().x * zoom;
+  const float height = (maxDepth + 1) * rowHeight;
+  const ImVec2 origin = ImGui::GetCursorScreenPos();
+  ImGui::InvisibleButton(thread.threadName, ImVec2(std::max(width, 1.f), height));
+  const bool hovered = ImGui::IsItemHovered();
+  const ImVec2 mouse = ImGui::GetMousePos();
+
+  ImDrawList *drawList = ImGui::GetWindowDrawList();
+  const double duration = double(std::max<uint64_t>(frame.end - frame.start, 1));
+  for (const ProfileEvent &event : thread.events)
+  {
+    // zones of threads that started in previous frame are clamped to frame start
+    const double start = event.start > frame.start ? double(event.start - frame.start) : 0.0;
+    const double end = event.end > frame.start ? double(event.end - frame.start) : 0.0;
+    const ImVec2 min(origin.x + float(start / duration) * width, origin.y + event.depth * rowHeight);
+    const ImVec2 max(std::max(origin.x + float(end / duration) * width, min.x + 1.f), min.y + rowHeight - 1.f);
+
+    drawList->AddRectFilled(min, max, zone_color(event.name));
+    if (max.x - min.x > ImGui::CalcTextSize(event.name).x + 4.f)
+      drawList->AddText(ImVec2(min.x + 2.f, min.y), IM_COL32(0, 0, 0, 255), event.name);
+
+    if (hovered && mouse.x >= min.x && mouse.x < max.x && mouse.y >= min.y && mouse.y < max.y)
+      ImGui::SetTooltip("%s\n%.3f ms", event.name, (event.end - event.start) * 1e-6);
+  }
+}
+
+static void show_zone_totals(const ProfileThreadFrame &thread)
+{
+  struct ZoneTotal
+  {
+    const char *name;
+    uint64_t time = 0;
+    uint32_t calls = 0;
+  };
+  std::unordered_map<std::string_view, ZoneTotal> totals;
+  for (const ProfileEvent &event : thread.events)
+  {
+    ZoneTotal &total = totals[event.name];
+    total.name = event.name;
+    total.time += event.end - event.start;
+    total.calls++;
+  }
+  std::vector<ZoneTotal> sorted;
+  sorted.reserve(totals.size());
+  for (const auto &[name, total] : totals)
+    sorted.push_back(total);
+  std::sort(sorted.begin(), sorted.end(), [](const ZoneTotal &a, const ZoneTotal &b) { return a.time > b.time; });
+
+  for (const ZoneTotal &total : sorted)
+    ImGui::Text("%8.3f ms %5u  %s", total.time * 1e-6, total.calls, total.name);
+}
+
+namespace engine
+{
+  void profiler_show_imgui()
+  {
+    if (ImGui::Begin("Profiler"))
+    {
+#if !ENGINE_PROFILER
+      ImGui::TextColored(ImVec4(1, 0.5f, 0.5f, 1), "Profiler zones are compiled out (ENGINE_PROFILER=0)");
+#endif
+      const ProfileFrame &frame = profiler_last_frame();
+      ImGui::Text("Frame %.3f ms, dropped zones %llu", (frame.end - frame.start) * 1e-6, (unsigned long long)profiler_dropped_events());
+
+      bool paused = profiler_is_paused();
+      if (ImGui::Checkbox("Pause", &paused))
+        profiler_set_paused(paused);
+
+      static char tracePath[256] = "profile_trace.json";
+      ImGui::SameLine();
+      if (!profiler_is_capturing())
+      {
+        if (ImGui::Button("Start capture"))
+          profiler_start_capture();
+      }
+      else if (ImGui::Button("Stop and save"))
+        profiler_stop_capture(tracePath);
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(200.f);
+      ImGui::InputText("Trace path", tracePath, sizeof(tracePath));
+
+      if (ImGui::TreeNode("Frame arenas"))
+      {
+        for (const FrameArenaStats &arena : engine::frame_arena_stats())
+          ImGui::Text("%-12s last %8.1f KB, high water %8.1f KB, capacity %8.1f KB, overflowed %zu frames", arena.threadName,
+            arena.lastFrameBytes / 1024.f, arena.highWaterBytes / 1024.f, arena.capacityBytes / 1024.f, arena.overflowFrames);
+        ImGui::TreePop();
+      }
+
+      static float zoom = 1.f;
+      ImGui::SliderFloat("Zoom", &zoom, 1.f, 32.f, "%.1f", ImGuiSliderFlags_Logarithmic);
+
+      if (ImGui::BeginChild("Flame", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar))
+      {
+        for (const ProfileThreadFrame &thread : frame.threads)
+        {
+          ImGui::PushID(thread.threadId);
+          ImGui::Text("%s", thread.threadName);
+          show_flame(frame, thread, zoom);
+          if (ImGui::TreeNode("Zones", "Zone totals"))
+          {
+            show_zone_totals(thread);
+            ImGui::TreePop();
+          }
+          ImGui::PopID();
+        }
+
+        // GPU zones are a few frames behind and drawn on their own time axis
+        ImGui::Separator();
+        if (!gpu_profiler_available())
+          ImGui::TextDisabled("GPU timer queries are not available");
+        else
+        {
+          const ProfileFrame &gpuFrame = gpu_profiler_last_frame();
+          ImGui::Text("GPU %.3f ms, dropped frames %llu", (gpuFrame.end - gpuFrame.start) * 1e-6, (unsigned long long)gpu_profiler_dropped_frames());
+          for (const ProfileThreadFrame &thread : gpuFrame.threads)
+          {
+            ImGui::PushID(thread.threadId);
+            show_flame(gpuFrame, thread, zoom);
+            if (ImGui::TreeNode("Zones", "Zone totals"))
+            {
+              show_zone_totals(thread);
+              ImGui::TreePop();
+            }
+            ImGui::PopID();
+          }
+        }
+      }
+      ImGui::EndChild();
+    }
+    ImGui::End();
+  }
+}
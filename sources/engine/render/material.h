@@ -42,6 +42,13 @@ public:
       }
     }
 
+    // headless shaders have no uniforms to match, property is kept but never bound
+    if (engine::is_headless())
+    {
+      properties.emplace_back(Property{std::string(name), -1, MaterialProperty{std::move(value)}});
+      return true;
+    }
+
     int i = 0;
     for (const ShaderUniform &sampler : shader->uniforms)
     {
@@ -52,7 +59,7 @@ public:
       }
       i++;
     }
-    engine::error("property %s in shader %s didn't found", name, shader->name.c_str());
+    engine::error(LogCategory::Render, "property %s in shader %s didn't found", name, shader->name.c_str());
     return false;
   }
 };
@@ -1,6 +1,7 @@
 #include "mesh.h"
 #include <vector>
 #include "glad/glad.h"
+#include "engine/api.h"
 
 static void create_indices(std::span<const uint32_t> indices)
 {
@@ -29,9 +30,19 @@ static void init_channel(int channel_index, std::span<const T> channel)
     glVertexAttribIPointer(channel_index, componentCount, GL_UNSIGNED_INT, 0, 0);
 }
 
+template <typename... Channel>
+static size_t buffers_size(std::span<const uint32_t> indices, Channel &&...channels)
+{
+  return indices.size_bytes() + (channels.size_bytes() + ...);
+}
+
 template <typename... Channel> // Channel is vector<vec3>, vector<vec2> etc
 static uint32_t create_vertex_array_buffer(std::span<const uint32_t> indices, Channel &&...channels)
 {
+  // no GL context, mesh keeps only its CPU data
+  if (engine::is_headless())
+    return 0;
+
   uint32_t vertexArrayBufferObject;
   glGenVertexArrays(1, &vertexArrayBufferObject);
   glBindVertexArray(vertexArrayBufferObject);
@@ -56,7 +67,9 @@ MeshPtr create_mesh(
     std::map<std::string, int> &&bonesMap)
 {
   uint32_t vertexArrayBufferObject = create_vertex_array_buffer(indices, vertices, normals, uv, weights, weightsIndex);
-  return std::make_shared<Mesh>(name, vertexArrayBufferObject, indices.size(), std::move(inversedBindPose), std::move(boneNames), std::move(bonesMap));
+  MeshPtr mesh = std::make_shared<Mesh>(name, vertexArrayBufferObject, indices.size(), std::move(inversedBindPose), std::move(boneNames), std::move(bonesMap));
+  mesh->gpuMemory = buffers_size(indices, vertices, normals, uv, weights, weightsIndex);
+  return mesh;
 }
 
 MeshPtr create_mesh(
@@ -69,7 +82,9 @@ MeshPtr create_mesh(
     std::span<const uvec4> weightsIndex)
 {
   uint32_t vertexArrayBufferObject = create_vertex_array_buffer(indices, vertices, normals, uv, weights, weightsIndex);
-  return std::make_shared<Mesh>(name, vertexArrayBufferObject, indices.size());
+  MeshPtr mesh = std::make_shared<Mesh>(name, vertexArrayBufferObject, indices.size());
+  mesh->gpuMemory = buffers_size(indices, vertices, normals, uv, weights, weightsIndex);
+  return mesh;
 }
 
 MeshPtr create_mesh(
@@ -80,7 +95,9 @@ MeshPtr create_mesh(
     std::span<const vec2> uv)
 {
   uint32_t vertexArrayBufferObject = create_vertex_array_buffer(indices, vertices, normals, uv);
-  return std::make_shared<Mesh>(name, vertexArrayBufferObject, indices.size());
+  MeshPtr mesh = std::make_shared<Mesh>(name, vertexArrayBufferObject, indices.size());
+  mesh->gpuMemory = buffers_size(indices, vertices, normals, uv);
+  return mesh;
 }
 
 
@@ -16,6 +16,7 @@ struct Mesh
   std::vector<mat4> inversedBindPose;
   std::vector<std::string> boneNames;
   std::map<std::string, int> bonesMap;
+  size_t gpuMemory = 0; // bytes of vertex and index buffers
 
   Mesh(const char *name, uint32_t vertexArrayBufferObject, int numIndices) :
     name(name),
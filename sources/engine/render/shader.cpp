@@ -54,7 +54,7 @@ static bool compile_shader(const char *shaderName, const std::vector<ShaderInfo>
     if(!success)
     {
       glGetShaderInfoLog(shaderProg, 512, NULL, infoLog);
-      engine::error("Shader (%s) compilation failed!\n Log: %s", shader.path.c_str(), infoLog);
+      engine::error(LogCategory::Render, "Shader (%s) compilation failed!\n Log: %s", shader.path.c_str(), infoLog);
       return false;
     };
     compiled_shaders.push_back(shaderProg);
@@ -71,7 +71,7 @@ static bool compile_shader(const char *shaderName, const std::vector<ShaderInfo>
   if (!success)
   {
     glGetProgramInfoLog(program, 1024, NULL, infoLog);
-    engine::error("Shader programm (%s) linking failed!\n Log: %s", shaderName, infoLog);
+    engine::error(LogCategory::Render, "Shader programm (%s) linking failed!\n Log: %s", shaderName, infoLog);
     return false;
   }
 
@@ -105,6 +105,10 @@ ShaderPtr compile_shader(const char *name, const char *vs_path, const char *ps_p
 {
   Shader::ShaderSources shaderSources{{GL_VERTEX_SHADER, vs_path}, {GL_FRAGMENT_SHADER, ps_path}};
 
+  // nothing to compile without GL context, materials still get a shader to hold properties
+  if (engine::is_headless())
+    return std::make_shared<Shader>(name, 0, shaderSources);
+
   GLuint program;
   if (compile_shader(name, shaderSources, program))
   {
@@ -119,6 +123,8 @@ ShaderPtr compile_shader(const char *name, const char *vs_path, const char *ps_p
 
 void recompile_all_shaders()
 {
+  if (engine::is_headless())
+    return;
   int shaderCount = 0;
   for (auto &shader : shaderList)
   {
@@ -131,5 +137,5 @@ void recompile_all_shaders()
       shaderCount++;
     }
   }
-  engine::log("Shaders recompiled (%d/%d)", shaderCount, shaderList.size());
+  engine::log(LogCategory::Render, "Shaders recompiled (%d/%d)", shaderCount, shaderList.size());
 }
\ No newline at end of file
@@ -1,11 +1,21 @@
 #include "texture2d.h"
+#include "texture_cook.h"
+#include "engine/api.h"
 #include "glad/glad.h"
 #include <cassert>
-#define STB_IMAGE_IMPLEMENTATION
+#include <chrono>
+#include <filesystem>
 #include <stb/stb_image.h>
 
 Texture2DPtr create_texture2d(const uint8_t *image, int w, int h, int ch)
 {
+  if (engine::is_headless())
+  {
+    auto texture = std::make_shared<Texture2D>(0);
+    texture->gpuMemory = size_t(w) * h * 4 * 4 / 3;
+    return texture;
+  }
+
   GLuint textureObject;
   glGenTextures(1, &textureObject);
   auto texture = std::make_shared<Texture2D>(textureObject);
@@ -19,8 +29,11 @@ Texture2DPtr create_texture2d(const uint8_t *image, int w, int h, int ch)
     glTexImage2D(textureType, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
 
   const bool generateMips = true;
+  // drivers usually pad RGB8 to 4 bytes per texel
+  texture->gpuMemory = size_t(w) * h * 4;
   if (generateMips)
   {
+    texture->gpuMemory = texture->gpuMemory * 4 / 3;
     glGenerateMipmap(textureType);
     GLenum mipmapMinPixelFormat = GL_LINEAR_MIPMAP_LINEAR;
     GLenum mipmapMagPixelFormat = GL_LINEAR;
@@ -39,8 +52,66 @@ Texture2DPtr create_texture2d(const uint8_t *image, int w, int h, int ch)
   return texture;
 }
 
+Texture2DPtr create_texture2d(const CompressedTexture &compressed)
+{
+  if (engine::is_headless())
+  {
+    auto texture = std::make_shared<Texture2D>(0);
+    for (const std::vector<uint8_t> &blocks : compressed.levels)
+      texture->gpuMemory += blocks.size();
+    return texture;
+  }
+
+  GLuint textureObject;
+  glGenTextures(1, &textureObject);
+  auto texture = std::make_shared<Texture2D>(textureObject);
+  GLuint textureType = GL_TEXTURE_2D;
+
+  glBindTexture(textureType, textureObject);
+  for (size_t level = 0; level < compressed.levels.size(); ++level)
+  {
+    const int w = std::max(1, compressed.width >> level);
+    const int h = std::max(1, compressed.height >> level);
+    const std::vector<uint8_t> &blocks = compressed.levels[level];
+    glCompressedTexImage2D(textureType, level, GL_COMPRESSED_RGBA_BPTC_UNORM, w, h, 0, blocks.size(), blocks.data());
+    texture->gpuMemory += blocks.size();
+  }
+  glTexParameteri(textureType, GL_TEXTURE_MAX_LEVEL, compressed.levels.size() - 1);
+  glTexParameteri(textureType, GL_TEXTURE_MIN_FILTER, compressed.levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(textureType, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(textureType, 0);
+
+  return texture;
+}
+
+using texture_clock = std::chrono::high_resolution_clock;
+
+static float elapsed_ms(texture_clock::time_point from)
+{
+  return std::chrono::duration<float, std::milli>(texture_clock::now() - from).count();
+}
+
 Texture2DPtr create_texture2d(const char *path)
 {
+  // upload time includes glFinish, otherwise drivers defer most of the work
+  const std::string cookedPath = cooked_texture_path(path);
+  if (std::filesystem::exists(cookedPath))
+  {
+    texture_clock::time_point start = texture_clock::now();
+    CompressedTexture compressed;
+    if (read_ktx2(cookedPath.c_str(), compressed))
+    {
+      const float readMs = elapsed_ms(start);
+      start = texture_clock::now();
+      Texture2DPtr result = create_texture2d(compressed);
+      if (!engine::is_headless())
+        glFinish();
+      engine::log(LogCategory::Render, "Texture \"%s\" loaded, read %.2f ms, upload %.2f ms, %zu KB", cookedPath.c_str(), readMs, elapsed_ms(start), result->gpuMemory / 1024);
+      return result;
+    }
+  }
+
+  texture_clock::time_point start = texture_clock::now();
   int w, h, ch;
   stbi_set_flip_vertically_on_load(true);
   auto stbiData = stbi_load(path, &w, &h, &ch, 0);
@@ -48,7 +119,12 @@ Texture2DPtr create_texture2d(const char *path)
   Texture2DPtr result;
   if (stbiData)
   {
+    const float decodeMs = elapsed_ms(start);
+    start = texture_clock::now();
     result = create_texture2d(stbiData, w, h, ch);
+    if (!engine::is_headless())
+      glFinish();
+    engine::log(LogCategory::Render, "Texture \"%s\" loaded, decode %.2f ms, upload and mips %.2f ms, %zu KB", path, decodeMs, elapsed_ms(start), result->gpuMemory / 1024);
     stbi_image_free(stbiData);
   }
   return result;
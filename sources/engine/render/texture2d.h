@@ -5,10 +5,16 @@
 struct Texture2D
 {
   const unsigned textureObject;
+  size_t gpuMemory = 0; // bytes of all mip levels
   Texture2D(unsigned textureObject) : textureObject(textureObject) {}
 };
 
 using Texture2DPtr = std::shared_ptr<Texture2D>;
 
+struct CompressedTexture;
+
 Texture2DPtr create_texture2d(const uint8_t *image, int w, int h, int ch);
+// uploads pre-built BC7 mips as is, nothing is decoded or generated on load
+Texture2DPtr create_texture2d(const CompressedTexture &texture);
+// loads cooked .ktx2 next to path when it exists, decodes path with stb_image otherwise
 Texture2DPtr create_texture2d(const char *path);
\ No newline at end of file
@@ -0,0 +1,422 @@
+#include "texture_cook.h"
+#include "engine/api.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+std::string cooked_texture_path(const char *path)
+{
+  std::string cooked = path;
+  const size_t dot = cooked.find_last_of('.');
+  const size_t slash = cooked.find_last_of("/\\");
+  if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+    cooked.resize(dot);
+  return cooked + ".ktx2";
+}
+
+// BC7 ENCODING //
+
+// mode 6: one subset, RGBA endpoints with 7 bits per channel plus one shared bit per endpoint, 4 bit indices
+static const int BC7_WEIGHTS4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct BitWriter
+{
+  uint8_t *data;
+  int position = 0;
+
+  void write(uint32_t value, int bits)
+  {
+    for (int i = 0; i < bits; ++i, ++position)
+      if ((value >> i) & 1)
+        data[position >> 3] |= 1 << (position & 7);
+  }
+};
+
+// picks shared bit that reconstructs endpoint with the smallest error,
+// opaque blocks need shared bit 1, the only way to get alpha 255 back
+static void quantize_endpoint(const float *endpoint, bool opaque, int *quantized, int &pbit)
+{
+  float bestError = INFINITY;
+  for (int p = opaque ? 1 : 0; p < 2; ++p)
+  {
+    int candidate[4];
+    float error = 0.f;
+    for (int c = 0; c < 4; ++c)
+    {
+      candidate[c] = std::clamp(int(std::lround((endpoint[c] - p) * 0.5f)), 0, 127);
+      const float d = float((candidate[c] << 1) | p) - endpoint[c];
+      error += d * d;
+    }
+    if (error < bestError)
+    {
+      bestError = error;
+      pbit = p;
+      std::copy(candidate, candidate + 4, quantized);
+    }
+  }
+}
+
+void encode_bc7_block(const uint8_t *rgba, uint8_t *block)
+{
+  float mean[4] = {0.f, 0.f, 0.f, 0.f};
+  for (int i = 0; i < 16; ++i)
+    for (int c = 0; c < 4; ++c)
+      mean[c] += rgba[i * 4 + c] * (1.f / 16.f);
+
+  float covariance[4][4] = {};
+  for (int i = 0; i < 16; ++i)
+    for (int a = 0; a < 4; ++a)
+      for (int b = 0; b < 4; ++b)
+        covariance[a][b] += (rgba[i * 4 + a] - mean[a]) * (rgba[i * 4 + b] - mean[b]);
+
+  // principal axis of block colors by power iteration
+  float axis[4] = {1.f, 1.f, 1.f, 1.f};
+  for (int iteration = 0; iteration < 8; ++iteration)
+  {
+    float next[4] = {};
+    for (int a = 0; a < 4; ++a)
+      for (int b = 0; b < 4; ++b)
+        next[a] += covariance[a][b] * axis[b];
+    const float scale = std::max({std::fabs(next[0]), std::fabs(next[1]), std::fabs(next[2]), std::fabs(next[3])});
+    if (scale < 1e-6f)
+      break;
+    for (int c = 0; c < 4; ++c)
+      axis[c] = next[c] / scale;
+  }
+  const float axisLengthSq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3];
+
+  float minT = 0.f, maxT = 0.f;
+  for (int i = 0; i < 16; ++i)
+  {
+    float t = 0.f;
+    for (int c = 0; c < 4; ++c)
+      t += (rgba[i * 4 + c] - mean[c]) * axis[c];
+    t /= axisLengthSq;
+    minT = std::min(minT, t);
+    maxT = std::max(maxT, t);
+  }
+
+  float endpoints[2][4];
+  for (int c = 0; c < 4; ++c)
+  {
+    endpoints[0][c] = std::clamp(mean[c] + minT * axis[c], 0.f, 255.f);
+    endpoints[1][c] = std::clamp(mean[c] + maxT * axis[c], 0.f, 255.f);
+  }
+
+  bool opaque = true;
+  for (int i = 0; i < 16; ++i)
+    opaque &= rgba[i * 4 + 3] == 255;
+
+  int quantized[2][4], pbits[2];
+  quantize_endpoint(endpoints[0], opaque, quantized[0], pbits[0]);
+  quantize_endpoint(endpoints[1], opaque, quantized[1], pbits[1]);
+
+  int palette[16][4];
+  for (int c = 0; c < 4; ++c)
+  {
+    const int e0 = (quantized[0][c] << 1) | pbits[0];
+    const int e1 = (quantized[1][c] << 1) | pbits[1];
+    for (int i = 0; i < 16; ++i)
+      palette[i][c] = ((64 - BC7_WEIGHTS4[i]) * e0 + BC7_WEIGHTS4[i] * e1 + 32) >> 6;
+  }
+
+  int indices[16];
+  for (int i = 0; i < 16; ++i)
+  {
+    int bestError = INT32_MAX;
+    for (int j = 0; j < 16; ++j)
+    {
+      int error = 0;
+      for (int c = 0; c < 4; ++c)
+      {
+        const int d = palette[j][c] - rgba[i * 4 + c];
+        error += d * d;
+      }
+      if (error < bestError)
+      {
+        bestError = error;
+        indices[i] = j;
+      }
+    }
+  }
+
+  // the first index is stored with 3 bits, its top bit must be zero
+  if (indices[0] & 8)
+  {
+    std::swap(quantized[0], quantized[1]);
+    std::swap(pbits[0], pbits[1]);
+    for (int &index : indices)
+      index = 15 - index;
+  }
+
+  memset(block, 0, 16);
+  BitWriter writer{block};
+  writer.write(1 << 6, 7);
+  for (int c = 0; c < 4; ++c)
+  {
+    writer.write(quantized[0][c], 7);
+    writer.write(quantized[1][c], 7);
+  }
+  writer.write(pbits[0], 1);
+  writer.write(pbits[1], 1);
+  writer.write(indices[0], 3);
+  for (int i = 1; i < 16; ++i)
+    writer.write(indices[i], 4);
+}
+
+// MIPS //
+
+static std::vector<uint8_t> downsample(const std::vector<uint8_t> &src, int w, int h, int dstW, int dstH)
+{
+  std::vector<uint8_t> dst(size_t(dstW) * dstH * 4);
+  for (int y = 0; y < dstH; ++y)
+    for (int x = 0; x < dstW; ++x)
+    {
+      const int x0 = std::min(x * 2, w - 1), x1 = std::min(x * 2 + 1, w - 1);
+      const int y0 = std::min(y * 2, h - 1), y1 = std::min(y * 2 + 1, h - 1);
+      for (int c = 0; c < 4; ++c)
+      {
+        const int sum =
+          src[(size_t(y0) * w + x0) * 4 + c] + src[(size_t(y0) * w + x1) * 4 + c] +
+          src[(size_t(y1) * w + x0) * 4 + c] + src[(size_t(y1) * w + x1) * 4 + c];
+        dst[(size_t(y) * dstW + x) * 4 + c] = uint8_t((sum + 2) / 4);
+      }
+    }
+  return dst;
+}
+
+static std::vector<uint8_t> encode_level(const std::vector<uint8_t> &pixels, int w, int h)
+{
+  const int blocksX = (w + 3) / 4, blocksY = (h + 3) / 4;
+  std::vector<uint8_t> blocks(size_t(blocksX) * blocksY * 16);
+  uint8_t texels[16 * 4];
+  for (int by = 0; by < blocksY; ++by)
+    for (int bx = 0; bx < blocksX; ++bx)
+    {
+      // edge blocks repeat the last row and column
+      for (int i = 0; i < 16; ++i)
+      {
+        const int x = std::min(bx * 4 + i % 4, w - 1);
+        const int y = std::min(by * 4 + i / 4, h - 1);
+        memcpy(texels + i * 4, &pixels[(size_t(y) * w + x) * 4], 4);
+      }
+      encode_bc7_block(texels, &blocks[(size_t(by) * blocksX + bx) * 16]);
+    }
+  return blocks;
+}
+
+CompressedTexture cook_texture(const uint8_t *image, int w, int h, int ch)
+{
+  std::vector<uint8_t> pixels(size_t(w) * h * 4);
+  for (size_t i = 0; i < size_t(w) * h; ++i)
+  {
+    for (int c = 0; c < 3; ++c)
+      pixels[i * 4 + c] = image[i * ch + c];
+    pixels[i * 4 + 3] = ch == 4 ? image[i * ch + 3] : 255;
+  }
+
+  CompressedTexture texture;
+  texture.width = w;
+  texture.height = h;
+  int levelW = w, levelH = h;
+  while (true)
+  {
+    texture.levels.push_back(encode_level(pixels, levelW, levelH));
+    if (levelW == 1 && levelH == 1)
+      break;
+    const int nextW = std::max(1, levelW / 2), nextH = std::max(1, levelH / 2);
+    pixels = downsample(pixels, levelW, levelH, nextW, nextH);
+    levelW = nextW;
+    levelH = nextH;
+  }
+  return texture;
+}
+
+bool cook_texture(const char *srcPath, const char *dstPath)
+{
+  int w, h, ch;
+  // same orientation as runtime decoding in create_texture2d
+  stbi_set_flip_vertically_on_load(true);
+  uint8_t *image = stbi_load(srcPath, &w, &h, &ch, 0);
+  if (!image)
+  {
+    engine::error(LogCategory::Render, "Failed to decode texture \"%s\"", srcPath);
+    return false;
+  }
+  if (ch != 3 && ch != 4)
+  {
+    engine::error(LogCategory::Render, "Texture \"%s\" has %d channels, only RGB and RGBA can be cooked", srcPath, ch);
+    stbi_image_free(image);
+    return false;
+  }
+  CompressedTexture texture = cook_texture(image, w, h, ch);
+  stbi_image_free(image);
+  return write_ktx2(dstPath, texture);
+}
+
+// KTX2 CONTAINER //
+
+static const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+static const uint32_t VK_FORMAT_BC7_UNORM_BLOCK = 145;
+// largest side GL 4 guarantees, bigger textures can't be uploaded anyway
+static const uint32_t KTX2_MAX_SIZE = 16384;
+
+struct Ktx2Header
+{
+  uint8_t identifier[12];
+  uint32_t vkFormat;
+  uint32_t typeSize;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t layerCount;
+  uint32_t faceCount;
+  uint32_t levelCount;
+  uint32_t supercompressionScheme;
+  uint32_t dfdByteOffset;
+  uint32_t dfdByteLength;
+  uint32_t kvdByteOffset;
+  uint32_t kvdByteLength;
+  uint64_t sgdByteOffset;
+  uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80);
+
+struct Ktx2Level
+{
+  uint64_t byteOffset;
+  uint64_t byteLength;
+  uint64_t uncompressedByteLength;
+};
+
+// basic data format descriptor of a BC7 block, required by the spec
+static std::vector<uint32_t> bc7_data_format_descriptor()
+{
+  const uint32_t blockSize = 24 + 16;
+  return {
+    4 + blockSize,        // dfdTotalSize
+    0,                    // vendorId = Khronos, descriptorType = basic
+    2 | (blockSize << 16),// versionNumber, descriptorBlockSize
+    134 | (1 << 8) | (1 << 16), // colorModel = BC7, primaries = BT709, transfer = linear
+    3 | (3 << 8),         // texel block is 4x4
+    16,                   // bytesPlane0
+    0,
+    // one sample covering the whole 128 bit block
+    (127 << 16),          // bitOffset 0, bitLength 127, channelType 0
+    0,                    // samplePosition
+    0,                    // sampleLower
+    0xFFFFFFFFu,          // sampleUpper
+  };
+}
+
+bool write_ktx2(const char *path, const CompressedTexture &texture)
+{
+  const std::vector<uint32_t> dfd = bc7_data_format_descriptor();
+  const uint32_t levelCount = texture.levels.size();
+
+  Ktx2Header header = {};
+  memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+  header.vkFormat = VK_FORMAT_BC7_UNORM_BLOCK;
+  header.typeSize = 1;
+  header.pixelWidth = texture.width;
+  header.pixelHeight = texture.height;
+  header.faceCount = 1;
+  header.levelCount = levelCount;
+  header.dfdByteOffset = sizeof(Ktx2Header) + levelCount * sizeof(Ktx2Level);
+  header.dfdByteLength = dfd.size() * sizeof(uint32_t);
+
+  // level data goes from the smallest mip to the largest, aligned to block size
+  std::vector<Ktx2Level> levels(levelCount);
+  uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+  for (int i = levelCount - 1; i >= 0; --i)
+  {
+    offset = (offset + 15) & ~uint64_t(15);
+    levels[i] = {offset, texture.levels[i].size(), texture.levels[i].size()};
+    offset += texture.levels[i].size();
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file)
+  {
+    engine::error(LogCategory::Render, "Failed to open \"%s\" for writing", path);
+    return false;
+  }
+  file.write((const char *)&header, sizeof(header));
+  file.write((const char *)levels.data(), levels.size() * sizeof(Ktx2Level));
+  file.write((const char *)dfd.data(), dfd.size() * sizeof(uint32_t));
+  for (int i = levelCount - 1; i >= 0; --i)
+  {
+    const std::streamoff padding = levels[i].byteOffset - file.tellp();
+    for (std::streamoff p = 0; p < padding; ++p)
+      file.put(0);
+    file.write((const char *)texture.levels[i].data(), texture.levels[i].size());
+  }
+  return bool(file);
+}
+
+bool read_ktx2(const char *path, CompressedTexture &texture)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+
+  Ktx2Header header;
+  if (!file.read((char *)&header, sizeof(header)) || memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+  {
+    engine::error(LogCategory::Render, "\"%s\" is not a KTX2 file", path);
+    return false;
+  }
+  if (header.vkFormat != VK_FORMAT_BC7_UNORM_BLOCK || header.supercompressionScheme != 0 || header.levelCount == 0)
+  {
+    engine::error(LogCategory::Render, "\"%s\" is not an uncompressed BC7 KTX2 texture", path);
+    return false;
+  }
+  // cooked files are checked as any other input, sizes below go to allocations and glCompressedTexImage2D
+  const uint32_t maxLevels = header.pixelWidth > 0 && header.pixelHeight > 0
+    ? uint32_t(std::floor(std::log2(std::max(header.pixelWidth, header.pixelHeight)))) + 1 : 0;
+  if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelWidth > KTX2_MAX_SIZE || header.pixelHeight > KTX2_MAX_SIZE ||
+    header.levelCount > maxLevels)
+  {
+    engine::error(LogCategory::Render, "\"%s\" has invalid size %ux%u with %u levels", path, header.pixelWidth, header.pixelHeight, header.levelCount);
+    return false;
+  }
+
+  file.seekg(0, std::ios::end);
+  const uint64_t fileSize = uint64_t(file.tellg());
+  file.seekg(sizeof(header));
+  std::vector<Ktx2Level> levels(header.levelCount);
+  file.read((char *)levels.data(), levels.size() * sizeof(Ktx2Level));
+  if (!file)
+  {
+    engine::error(LogCategory::Render, "\"%s\" is truncated", path);
+    return false;
+  }
+
+  texture.width = header.pixelWidth;
+  texture.height = header.pixelHeight;
+  texture.levels.resize(header.levelCount);
+  for (uint32_t i = 0; i < header.levelCount; ++i)
+  {
+    const uint64_t blocksX = (std::max(1u, header.pixelWidth >> i) + 3) / 4;
+    const uint64_t blocksY = (std::max(1u, header.pixelHeight >> i) + 3) / 4;
+    const Ktx2Level &level = levels[i];
+    if (level.byteLength != blocksX * blocksY * 16 || level.byteOffset > fileSize || level.byteLength > fileSize - level.byteOffset)
+    {
+      engine::error(LogCategory::Render, "\"%s\" level %u doesn't hold %llux%llu BC7 blocks within the file", path, i,
+        (unsigned long long)blocksX, (unsigned long long)blocksY);
+      return false;
+    }
+    texture.levels[i].resize(level.byteLength);
+    file.seekg(level.byteOffset);
+    file.read((char *)texture.levels[i].data(), level.byteLength);
+  }
+  if (!file)
+  {
+    engine::error(LogCategory::Render, "\"%s\" is truncated", path);
+    return false;
+  }
+  return true;
+}
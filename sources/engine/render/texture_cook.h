@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Texture with all mip levels encoded in BC7, as stored in cooked .ktx2 files.
+// Cooking runs offline (see tools/texture_cooker.cpp), runtime only uploads the blocks.
+struct CompressedTexture
+{
+  int width = 0;
+  int height = 0;
+  std::vector<std::vector<uint8_t>> levels; // level 0 is full resolution
+};
+
+// cooked texture for a source image is stored next to it with .ktx2 extension
+std::string cooked_texture_path(const char *path);
+
+// generates mips with box filter and encodes every level to BC7, ch is 3 (RGB) or 4 (RGBA)
+CompressedTexture cook_texture(const uint8_t *image, int w, int h, int ch);
+
+// decodes image at srcPath, cooks it and writes result to dstPath
+bool cook_texture(const char *srcPath, const char *dstPath);
+
+bool write_ktx2(const char *path, const CompressedTexture &texture);
+bool read_ktx2(const char *path, CompressedTexture &texture);
+
+// encodes 4x4 RGBA8 pixels (row by row) into one 16 byte BC7 mode 6 block
+void encode_bc7_block(const uint8_t *rgba, uint8_t *block);
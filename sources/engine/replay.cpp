@@ -0,0 +1,311 @@
+#include "engine/replay.h"
+#include "engine/api.h"
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// stream is a header followed by tagged records, every step is
+// Step, Event records dispatched before the step, Parameters records in sync order and PoseHash.
+// Key states, text and mouse deltas are rebuilt from recorded events within the step,
+// their input events are triggered later on main thread, see replay_trigger_played_events.
+enum class ReplayRecord : uint8_t
+{
+  Step,       // float delta time
+  Event,      // uint32 SDL event type, event struct of that type
+  Parameters, // uint32 count, floats
+  PoseHash,   // uint64 hash
+};
+
+static constexpr char REPLAY_MAGIC[4] = {'R', 'P', 'L', 'Y'};
+// 3: pose hashes are hash_bytes over matrix bytes, hashes recorded by older versions never match
+static constexpr uint32_t REPLAY_VERSION = 3;
+
+struct ReplayHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t stepCount;
+};
+
+enum class ReplayMode
+{
+  None,
+  Record,
+  Play,
+};
+
+// Steps run on simulation thread and events are recorded on main thread, main loop never runs them at the same time.
+struct ReplayState
+{
+  ReplayMode mode = ReplayMode::None;
+  std::string path;
+  std::vector<uint8_t> stream;
+  size_t readOffset = 0;
+  uint32_t stepCount = 0;
+  uint32_t step = 0;
+
+  // recording: events dispatched since the previous step
+  std::vector<SDL_Event> pendingEvents;
+
+  uint32_t mismatches = 0;
+  uint32_t firstMismatch = 0;
+};
+
+static ReplayState replay;
+
+// played events wait here for main thread, simulation thread adds them while main thread renders
+static std::mutex playedEventsMutex;
+static std::vector<SDL_Event> playedEvents;
+
+static size_t event_size(uint32_t type)
+{
+  switch (type)
+  {
+  case SDL_KEYDOWN:
+  case SDL_KEYUP: return sizeof(SDL_KeyboardEvent);
+  case SDL_MOUSEBUTTONDOWN:
+  case SDL_MOUSEBUTTONUP: return sizeof(SDL_MouseButtonEvent);
+  case SDL_MOUSEMOTION: return sizeof(SDL_MouseMotionEvent);
+  case SDL_MOUSEWHEEL: return sizeof(SDL_MouseWheelEvent);
+  case SDL_TEXTINPUT: return sizeof(SDL_TextInputEvent);
+  default: return 0;
+  }
+}
+
+static void write_bytes(const void *data, size_t size)
+{
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  replay.stream.insert(replay.stream.end(), bytes, bytes + size);
+}
+
+template<typename T>
+static void write(const T &value)
+{
+  write_bytes(&value, sizeof(T));
+}
+
+static bool read_bytes(void *data, size_t size)
+{
+  if (replay.readOffset + size > replay.stream.size())
+    return false;
+  memcpy(data, replay.stream.data() + replay.readOffset, size);
+  replay.readOffset += size;
+  return true;
+}
+
+template<typename T>
+static bool read(T &value)
+{
+  return read_bytes(&value, sizeof(T));
+}
+
+static bool next_record_is(ReplayRecord record)
+{
+  return replay.readOffset < replay.stream.size() && replay.stream[replay.readOffset] == uint8_t(record);
+}
+
+// playback can't continue once stream and game disagree on what comes next
+static void stop_diverged(const char *expected)
+{
+  engine::error("Replay \"%s\" diverged at step %u: expected %s record, game code or scene differs from the recorded one",
+    replay.path.c_str(), replay.step, expected);
+  engine::replay_stop();
+}
+
+static void record_step(float deltaTime)
+{
+  write(ReplayRecord::Step);
+  write(deltaTime);
+
+  for (const SDL_Event &event : replay.pendingEvents)
+  {
+    write(ReplayRecord::Event);
+    write(uint32_t(event.type));
+    write_bytes(&event, event_size(event.type));
+  }
+  replay.pendingEvents.clear();
+  replay.stepCount++;
+}
+
+static void play_step()
+{
+  float deltaTime;
+  uint8_t record;
+  if (!read(record) || !read(deltaTime))
+    return stop_diverged("step");
+
+  while (next_record_is(ReplayRecord::Event))
+  {
+    uint32_t type;
+    SDL_Event event;
+    memset(&event, 0, sizeof(event));
+    if (!read(record) || !read(type) || event_size(type) == 0 || !read_bytes(&event, event_size(type)))
+      return stop_diverged("event");
+    engine::update_input_state(event);
+    std::unique_lock lock(playedEventsMutex);
+    playedEvents.push_back(event);
+  }
+}
+
+namespace engine
+{
+  bool replay_start_recording(const char *path)
+  {
+    replay = ReplayState{};
+    replay.mode = ReplayMode::Record;
+    replay.path = path;
+    write(ReplayHeader{});
+    return true;
+  }
+
+  bool replay_start_playback(const char *path)
+  {
+    replay = ReplayState{};
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+      engine::error("Can't open replay \"%s\"", path);
+      return false;
+    }
+    fseek(file, 0, SEEK_END);
+    replay.stream.resize(ftell(file));
+    fseek(file, 0, SEEK_SET);
+    const bool readAll = fread(replay.stream.data(), 1, replay.stream.size(), file) == replay.stream.size();
+    fclose(file);
+
+    ReplayHeader header;
+    if (!readAll || !read(header) || memcmp(header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0 || header.version != REPLAY_VERSION)
+    {
+      engine::error("\"%s\" is not a replay of version %u", path, REPLAY_VERSION);
+      replay = ReplayState{};
+      return false;
+    }
+    replay.mode = ReplayMode::Play;
+    replay.path = path;
+    replay.stepCount = header.stepCount;
+    engine::log("Replay \"%s\" loaded, %u steps", path, header.stepCount);
+    return true;
+  }
+
+  void replay_stop()
+  {
+    if (replay.mode == ReplayMode::Record)
+    {
+      ReplayHeader header;
+      memcpy(header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+      header.version = REPLAY_VERSION;
+      header.stepCount = replay.stepCount;
+      memcpy(replay.stream.data(), &header, sizeof(header));
+
+      FILE *file = fopen(replay.path.c_str(), "wb");
+      if (file && fwrite(replay.stream.data(), 1, replay.stream.size(), file) == replay.stream.size())
+        engine::log("Replay \"%s\" recorded, %u steps, %zu KB", replay.path.c_str(), replay.stepCount, replay.stream.size() / 1024);
+      else
+        engine::error("Can't write replay to \"%s\"", replay.path.c_str());
+      if (file)
+        fclose(file);
+    }
+    else if (replay.mode == ReplayMode::Play)
+    {
+      if (replay.mismatches == 0)
+        engine::log("Replay \"%s\" played %u/%u steps, all poses match", replay.path.c_str(), replay.step, replay.stepCount);
+      else
+        engine::error("Replay \"%s\" played %u/%u steps, %u pose mismatches, first at step %u",
+          replay.path.c_str(), replay.step, replay.stepCount, replay.mismatches, replay.firstMismatch);
+    }
+    replay = ReplayState{};
+  }
+
+  bool is_replay_recording()
+  {
+    return replay.mode == ReplayMode::Record;
+  }
+
+  bool is_replay_playing()
+  {
+    return replay.mode == ReplayMode::Play;
+  }
+
+  uint32_t replay_step_count()
+  {
+    return replay.stepCount;
+  }
+
+  void replay_record_event(const SDL_Event &event)
+  {
+    if (replay.mode == ReplayMode::Record && event_size(event.type) != 0)
+      replay.pendingEvents.push_back(event);
+  }
+
+  bool replay_next_delta_time(float &deltaTime)
+  {
+    if (replay.mode != ReplayMode::Play || replay.step >= replay.stepCount || !next_record_is(ReplayRecord::Step))
+      return false;
+    memcpy(&deltaTime, replay.stream.data() + replay.readOffset + 1, sizeof(float));
+    return true;
+  }
+
+  void replay_begin_step(float deltaTime)
+  {
+    if (replay.mode == ReplayMode::Record)
+      record_step(deltaTime);
+    else if (replay.mode == ReplayMode::Play)
+      play_step();
+  }
+
+  void replay_trigger_played_events()
+  {
+    std::vector<SDL_Event> events;
+    {
+      std::unique_lock lock(playedEventsMutex);
+      events.swap(playedEvents);
+    }
+    for (const SDL_Event &event : events)
+      engine::trigger_input_events(event);
+  }
+
+  void replay_sync_parameters(float *values, uint32_t count)
+  {
+    if (replay.mode == ReplayMode::Record)
+    {
+      write(ReplayRecord::Parameters);
+      write(count);
+      write_bytes(values, count * sizeof(float));
+    }
+    else if (replay.mode == ReplayMode::Play)
+    {
+      uint8_t record;
+      uint32_t recordedCount;
+      if (!next_record_is(ReplayRecord::Parameters) || !read(record) || !read(recordedCount) || recordedCount != count)
+        return stop_diverged("parameters");
+      if (!read_bytes(values, count * sizeof(float)))
+        return stop_diverged("parameters");
+    }
+  }
+
+  void replay_check_pose_hash(uint64_t hash)
+  {
+    if (replay.mode == ReplayMode::Record)
+    {
+      write(ReplayRecord::PoseHash);
+      write(hash);
+    }
+    else if (replay.mode == ReplayMode::Play)
+    {
+      uint8_t record;
+      uint64_t recordedHash;
+      if (!next_record_is(ReplayRecord::PoseHash) || !read(record) || !read(recordedHash))
+        return stop_diverged("pose hash");
+      if (hash != recordedHash)
+      {
+        if (replay.mismatches++ == 0)
+        {
+          replay.firstMismatch = replay.step;
+          engine::error("Replay \"%s\" pose mismatch at step %u", replay.path.c_str(), replay.step);
+        }
+      }
+      replay.step++;
+    }
+  }
+}
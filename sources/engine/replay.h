@@ -0,0 +1,43 @@
+#pragma once
+#include <SDL2/SDL_events.h>
+#include <cstdint>
+
+// Deterministic replay of a session.
+// Recording stores everything that drives one game_update step into a compact binary stream:
+// step delta time, dispatched input events and parameters the game syncs
+// through replay_sync_parameters (character blend parameters). Playback feeds the same data back
+// step by step, windowed or headless. The game reports a pose hash after every step, recording stores it
+// and playback compares, so any divergence is reported with the first mismatching step.
+// Recording must start before game_init, replays are only valid for the same build and scene.
+
+namespace engine
+{
+  // stream is written to path by replay_stop
+  bool replay_start_recording(const char *path);
+  bool replay_start_playback(const char *path);
+  // saves recording or reports playback result
+  void replay_stop();
+
+  bool is_replay_recording();
+  bool is_replay_playing();
+  // number of steps in played stream
+  uint32_t replay_step_count();
+
+  // recording: input event dispatched to the game since the last step
+  void replay_record_event(const SDL_Event &event);
+
+  // playback: delta time of the next recorded step, false when all steps were played
+  bool replay_next_delta_time(float &deltaTime);
+
+  // call before every game_update, records the step or updates input state with events of the recorded one
+  void replay_begin_step(float deltaTime);
+  // main thread: triggers input events of steps played since the last call, steps may run on simulation thread
+  void replay_trigger_played_events();
+
+  // recording stores values, playback overwrites them with recorded ones.
+  // Must be called in the same order with the same counts every step, does nothing without replay.
+  void replay_sync_parameters(float *values, uint32_t count);
+
+  // call after every game_update with hash of resulting poses
+  void replay_check_pose_hash(uint64_t hash);
+}
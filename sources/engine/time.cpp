@@ -1,3 +1,4 @@
+#include "engine/api.h"
 #include <chrono>
 
 namespace engine
@@ -23,6 +24,37 @@ void update_time()
   savedTime = d.count();
 }
 
+// headless simulation steps with fixed delta time instead of wall clock
+void advance_time(float dt)
+{
+  deltaTime = dt;
+  savedTime += dt;
+  curTime = std::chrono::high_resolution_clock::now();
+}
+
+void set_delta_time(float dt)
+{
+  deltaTime = dt;
+}
+
+static FrameSettings frameSettings;
+static float interpolationAlpha = 1.f;
+
+FrameSettings &get_frame_settings()
+{
+  return frameSettings;
+}
+
+void set_interpolation_alpha(float alpha)
+{
+  interpolationAlpha = alpha;
+}
+
+float get_interpolation_alpha()
+{
+  return interpolationAlpha;
+}
+
 float get_time()
 {
   return savedTime;
@@ -0,0 +1,58 @@
+#include "application/state_machine.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+// Offline state machine cooking: state_machine_cooker machine.json [machine2.json ...]
+// writes binary machine.smb next to every description, it loads without json parsing and triangulation.
+
+using cook_clock = std::chrono::high_resolution_clock;
+
+static double elapsed_ms(cook_clock::time_point from)
+{
+  return std::chrono::duration<double, std::milli>(cook_clock::now() - from).count();
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    printf("usage: %s description.json [description.json ...]\n", argv[0]);
+    return 1;
+  }
+
+  int failed = 0;
+  for (int i = 1; i < argc; ++i)
+  {
+    const char *srcPath = argv[i];
+    const std::string dstPath = std::filesystem::path(srcPath).replace_extension(".smb").string();
+
+    cook_clock::time_point start = cook_clock::now();
+    StateMachineDesc desc;
+    if (!parse_state_machine(srcPath, desc))
+    {
+      failed++;
+      continue;
+    }
+    const double parseMs = elapsed_ms(start);
+    if (!save_state_machine(dstPath.c_str(), desc))
+    {
+      printf("Can't write \"%s\"\n", dstPath.c_str());
+      failed++;
+      continue;
+    }
+
+    start = cook_clock::now();
+    StateMachineDesc cooked;
+    parse_state_machine(dstPath.c_str(), cooked);
+    const double readMs = elapsed_ms(start);
+
+    printf("%s -> %s\n", srcPath, dstPath.c_str());
+    printf("  %zu states, %zu transitions, %zu clips, %zu parameters\n",
+      desc.states.size(), desc.transitions.size(), desc.clipNames.size(), desc.parameterNames.size());
+    printf("  load: json %.3f ms, binary %.3f ms\n", parseMs, readMs);
+    printf("  size: json %zu bytes, binary %zu bytes\n",
+      size_t(std::filesystem::file_size(srcPath)), size_t(std::filesystem::file_size(dstPath)));
+  }
+  return failed ? 1 : 0;
+}